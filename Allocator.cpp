@@ -0,0 +1,95 @@
+#include "Allocator.h"
+
+constexpr u64 arena_block_header_size = (sizeof(Arena_Block) + 15) & ~15ull; // Keeps block data aligned by 16
+
+inline u8 * get_block_data(Arena_Block *block) {
+  return reinterpret_cast <u8 *>(block) + arena_block_header_size;
+}
+
+void * Arena::allocate(u64 size, u64 alignment) {
+  allocation_count++;
+  allocated_bytes += size;
+
+  // Blocks after the current one are empty, they are left from before the last reset
+  for (auto block = current; block; block = block->next) {
+    u64 offset = (block->used + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= block->size) {
+      block->used = offset + size;
+      current = block;
+      return get_block_data(block) + offset;
+    }
+  }
+
+  u64 new_block_size = (size + alignment > block_size) ? size + alignment : block_size;
+
+  auto block = static_cast <Arena_Block *>(malloc(arena_block_header_size + new_block_size));
+  block->size = new_block_size;
+  block->used = size;
+
+  if (current) {
+    block->next = current->next;
+    current->next = block;
+  } else {
+    block->next = nullptr;
+    first = block;
+  }
+  current = block;
+
+  return get_block_data(block);
+}
+
+// The last allocation grows in place, as arrays usually grow one at a time
+void * Arena::reallocate(void *memory, u64 old_size, u64 size) {
+  auto bytes = static_cast <u8 *>(memory);
+
+  if (bytes && current && bytes + old_size == get_block_data(current) + current->used &&
+      bytes + size <= get_block_data(current) + current->size) {
+    current->used = bytes + size - get_block_data(current);
+    if (size > old_size)  allocated_bytes += size - old_size;
+    return memory;
+  }
+
+  auto result = allocate(size);
+  if (bytes)  memcpy(result, bytes, old_size < size ? old_size : size);
+  return result;
+}
+
+void Arena::reset() {
+  for (auto block = first; block; block = block->next)  block->used = 0;
+  current = first;
+
+  allocation_count = 0;
+  allocated_bytes = 0;
+}
+
+void Arena::deinit() {
+  auto block = first;
+  while (block) {
+    auto next = block->next;
+    free(block);
+    block = next;
+  }
+
+  first = nullptr;
+  current = nullptr;
+  allocation_count = 0;
+  allocated_bytes = 0;
+}
+
+u64 Arena::get_reserved_size() {
+  u64 size = 0;
+  for (auto block = first; block; block = block->next)  size += block->size;
+  return size;
+}
+
+void * arena_allocator_proc(Allocation_Mode mode, void *allocator_data, void *old_memory, u64 old_size, u64 size) {
+  auto arena = static_cast <Arena *>(allocator_data);
+
+  switch (mode) {
+  case Allocation_Mode::ALLOCATE:    return arena->allocate(size);
+  case Allocation_Mode::REALLOCATE:  return arena->reallocate(old_memory, old_size, size);
+  case Allocation_Mode::FREE:        return nullptr; // Freed all at once by reset
+  }
+
+  return nullptr;
+}
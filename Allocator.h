@@ -0,0 +1,107 @@
+#pragma once
+
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Allocator is passed by value. The default one with null proc is the heap (malloc, realloc and free).
+// Memory of an arena allocator is freed all at once, when the arena is reset.
+
+enum class Allocation_Mode : u8 {
+  ALLOCATE,
+  REALLOCATE,
+  FREE
+};
+
+typedef void * (*Allocator_Proc)(Allocation_Mode mode, void *allocator_data, void *old_memory, u64 old_size, u64 size);
+
+struct Allocator {
+  Allocator_Proc proc = nullptr;
+  void *data = nullptr;
+
+  inline bool is_heap() const { return proc == nullptr; }
+};
+
+// Heap allocations made through allocators on this thread, see allocate_memory
+struct Allocation_Counter {
+  u64 count = 0;
+  u64 bytes = 0;
+};
+
+inline thread_local Allocation_Counter heap_allocations;
+
+inline void * allocate_memory(Allocator allocator, u64 size) {
+  if (allocator.is_heap()) {
+    heap_allocations.count++;
+    heap_allocations.bytes += size;
+    return malloc(size);
+  }
+  return allocator.proc(Allocation_Mode::ALLOCATE, allocator.data, nullptr, 0, size);
+}
+
+inline void * reallocate_memory(Allocator allocator, void *memory, u64 old_size, u64 size) {
+  if (allocator.is_heap()) {
+    heap_allocations.count++;
+    heap_allocations.bytes += size;
+    return realloc(memory, size);
+  }
+  return allocator.proc(Allocation_Mode::REALLOCATE, allocator.data, memory, old_size, size);
+}
+
+inline void free_memory(Allocator allocator, void *memory) {
+  if (allocator.is_heap()) {
+    free(memory);
+    return;
+  }
+  allocator.proc(Allocation_Mode::FREE, allocator.data, memory, 0, 0);
+}
+
+inline char * copy_string(Allocator allocator, const char *string) {
+  auto length = strlen(string);
+  auto copy = static_cast <char *>(allocate_memory(allocator, length + 1));
+  memcpy(copy, string, length + 1);
+  return copy;
+}
+
+
+///////////////////////////////////////
+//
+//    Arena
+//
+// Memory is taken from big blocks one after another. Reset makes all the blocks free again
+// without returning them, so an arena reset on every stop stops allocating after the first stops.
+//
+
+struct Arena_Block {
+  Arena_Block *next;
+  u64 size;
+  u64 used;
+};
+
+struct Arena {
+  Arena_Block *first = nullptr;
+  Arena_Block *current = nullptr;
+
+  // Since the last reset
+  u64 allocation_count = 0;
+  u64 allocated_bytes = 0;
+
+  constexpr static const u64 block_size = 64 * 1024;
+
+  void * allocate(u64 size, u64 alignment = 16);
+  void * reallocate(void *memory, u64 old_size, u64 size);
+
+  void reset();
+  void deinit();
+
+  u64 get_reserved_size(); // Sum of the block sizes
+};
+
+void * arena_allocator_proc(Allocation_Mode mode, void *allocator_data, void *old_memory, u64 old_size, u64 size);
+
+inline Allocator get_allocator(Arena *arena) {
+  Allocator allocator;
+  allocator.proc = arena_allocator_proc;
+  allocator.data = arena;
+  return allocator;
+}
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <stdlib.h>
+#include <type_traits>
 
-// TODO:
-// * Fix wrong deinit behavior when one array assigned to another (cycling reference, I guess?) (if deinit implemented with free() in it)
-// * Add unordered remove
+#include "Allocator.h"
 
+// Elements are moved around with memcpy and realloc, so they have to be trivially copyable.
+// Assigning one array to another shares the data: only one of them should be deinitialized.
+// take() moves the data to another array and copy() duplicates it.
+
+// Element past the last one isn't read
 #define For(arr) \
   int __unique_i(__i_, __LINE__) = 0; \
   if((arr).count > 0) \
-    for (auto it = (arr).data[__unique_i(__i_, __LINE__)]; __unique_i(__i_, __LINE__) < (arr).count; __unique_i(__i_, __LINE__)++, it = (arr).data[__unique_i(__i_, __LINE__)])
+    for (auto it = (arr).data[__unique_i(__i_, __LINE__)]; __unique_i(__i_, __LINE__) < (arr).count; \
+         ++__unique_i(__i_, __LINE__) < (arr).count ? (it = (arr).data[__unique_i(__i_, __LINE__)]) : it)
 
 #define For_Pointer(arr) \
   int __unique_i(__i_, __LINE__) = 0; \
@@ -20,7 +25,8 @@
 #define For_it(arr, x) \
   int __unique_i(__i_, __LINE__) = 0; \
   if((arr).count > 0) \
-    for (auto (x) = (arr).data[__unique_i(__i_, __LINE__)]; __unique_i(__i_, __LINE__) < (arr).count; __unique_i(__i_, __LINE__)++, (x) = (arr).data[__unique_i(__i_, __LINE__)])
+    for (auto (x) = (arr).data[__unique_i(__i_, __LINE__)]; __unique_i(__i_, __LINE__) < (arr).count; \
+         ++__unique_i(__i_, __LINE__) < (arr).count ? ((x) = (arr).data[__unique_i(__i_, __LINE__)]) : (x))
 
 #define For_it_Pointer(arr, x) \
   int __unique_i(__i_, __LINE__) = 0; \
@@ -44,19 +50,22 @@ struct Array {
   int count = -1;
   T * data = nullptr;
 
+  Allocator allocator; // Heap by default, set before the first allocation
+
   void init(int count = 0);
   void init(T array[], int count);
   void deinit(); // @Note: WARNING! Frees only data allocated by Array unrecursively!
 
   void reset();
+  void reserve(int size);
 
   void add(const T & value);
-  Array<T> join(Array<T> array); // @Unimplemented
+  void join(Array<T> array); // Appends all elements of another array
 
   inline T & get(int index);
   inline void set(int index, T value);
 
-  T remove(int index); // @Unimplemented
+  T remove(int index); // Keeps the order of elements
   T remove_unordered(int index);
 
   inline T & operator [](int index) { return get(index); }
@@ -68,11 +77,18 @@ struct Array {
   T * find(const T & value); // TODO: Add custom predicate
   int find_index(const T & value); // TODO: Add custom predicate
 
+  Array<T> take(); // This array is left uninitialized, the returned one owns the data
+  Array<T> copy(Allocator allocator = {});
+
   int get_allocated_size() { return allocated_size; } // Meh...
 
   int grow_factor = 2;
   int minimal_size = 8;
 
+protected:
+  T * inline_data = nullptr; // Storage of Small_Array
+  int inline_size = 0;
+
 private:
   inline T * allocate(int size);
   inline T * reallocate(int new_size);
@@ -80,6 +96,21 @@ private:
   int allocated_size = -1;
 };
 
+// Keeps up to N elements inside itself, so short-lived small arrays don't allocate at all.
+// Data could point into the array itself, so it isn't copyable: pass it on as Array<T> *.
+template <typename T, int N>
+struct Small_Array : Array<T> {
+  T inline_storage[N];
+
+  Small_Array() {
+    this->inline_data = inline_storage;
+    this->inline_size = N;
+  }
+
+  Small_Array(const Small_Array &) = delete;
+  Small_Array & operator =(const Small_Array &) = delete;
+};
+
 #include <string.h>
 #include <assert.h>
 
@@ -87,7 +118,7 @@ template<typename T>
 void Array<T>::init(int count) {
   this->data = allocate(count);
   this->count = count;
-  memset(data, 0, count);
+  memset(data, 0, sizeof(T)*count);
 }
 
 template<typename T>
@@ -101,7 +132,7 @@ void Array<T>::init(T * array, int count) {
 template<typename T>
 void Array<T>::deinit() {
   if (data) {
-    free(data);
+    if (data != inline_data)  free_memory(allocator, data);
     allocated_size = -1;
     count = -1;
     data = nullptr;
@@ -111,29 +142,55 @@ void Array<T>::deinit() {
 template<typename T>
 void Array<T>::reset() {
   if (data) {
-    memset(data, 0, count);
+    memset(data, 0, sizeof(T)*count);
     count = 0;
   } else {
     this->init();
   }
 }
 
+template<typename T>
+void Array<T>::reserve(int size) {
+  if (data == nullptr) {
+    data = allocate(size);
+    count = 0;
+  } else {
+    data = reallocate(size);
+  }
+}
+
 template<typename T>
 inline T * Array<T>::allocate(int requested_size) {
+  static_assert(std::is_trivially_copyable<T>::value, "Array elements are moved with memcpy");
+
+  if (inline_data && requested_size <= inline_size) {
+    allocated_size = inline_size;
+    return inline_data;
+  }
+
   if (requested_size <= minimal_size)
     allocated_size = minimal_size;
   else
     allocated_size = requested_size;
 
-  return static_cast <T *>(malloc(sizeof(T)*allocated_size));
+  return static_cast <T *>(allocate_memory(allocator, sizeof(T)*allocated_size));
 }
 
 template<typename T>
 inline T * Array<T>::reallocate(int new_size) {
   if (new_size <= allocated_size) return data;
-    
+
+  auto old_size = allocated_size;
   allocated_size = new_size;
-  return static_cast <T *>(realloc(data, sizeof(T)*allocated_size));
+
+  // Inline storage is left for good, until the array is deinitialized
+  if (data == inline_data) {
+    auto new_data = static_cast <T *>(allocate_memory(allocator, sizeof(T)*allocated_size));
+    memcpy(new_data, data, sizeof(T)*count);
+    return new_data;
+  }
+
+  return static_cast <T *>(reallocate_memory(allocator, data, sizeof(T)*old_size, sizeof(T)*allocated_size));
 }
 
 template<typename T>
@@ -157,7 +214,14 @@ T & Array<T>::pop() {
 
 template<typename T>
 T Array<T>::remove(int index) {
-  assert(0 && "Unimplemented");
+  assert(0 <= index && index < count && "Attempt to remove element out of array bounds");
+
+  T removed_value = data[index];
+  memmove(data + index, data + index + 1, sizeof(T)*(count - index - 1));
+
+  count -= 1;
+
+  return removed_value;
 }
 
 template<typename T>
@@ -172,8 +236,54 @@ T Array<T>::remove_unordered(int index) {
 }
 
 template<typename T>
-Array<T> Array<T>::join(Array<T> array) {
-  assert(0 && "Unimplemented");
+void Array<T>::join(Array<T> array) {
+  if (data == nullptr)  init();
+  if (array.count <= 0)  return;
+
+  bool is_joined_to_itself = (array.data == data);
+
+  auto new_count = count + array.count;
+  if (new_count > allocated_size) {
+    auto grown_size = allocated_size * grow_factor;
+    data = reallocate(new_count > grown_size ? new_count : grown_size);
+  }
+
+  memcpy(data + count, is_joined_to_itself ? data : array.data, sizeof(T)*array.count);
+  count = new_count;
+}
+
+template<typename T>
+Array<T> Array<T>::take() {
+  Array<T> result;
+  result.allocator = allocator;
+  result.grow_factor = grow_factor;
+  result.minimal_size = minimal_size;
+
+  if (data && data == inline_data) {
+    result.init(data, count); // Inline storage can't be given away
+  } else {
+    result.data = data;
+    result.count = count;
+    result.allocated_size = allocated_size;
+  }
+
+  data = nullptr;
+  count = -1;
+  allocated_size = -1;
+
+  return result;
+}
+
+template<typename T>
+Array<T> Array<T>::copy(Allocator allocator) {
+  Array<T> result;
+  result.allocator = allocator;
+  result.grow_factor = grow_factor;
+  result.minimal_size = minimal_size;
+
+  if (data)  result.init(data, count);
+
+  return result;
 }
 
 template <typename T>
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string.h>
+
+#include "common.h"
+
+// Little-endian reader over a byte range. Used for hand-parsing of ELF and DWARF
+// sections, which libelfin doesn't expose (.eh_frame, location lists, etc.).
+// Reading past the end doesn't crash: cursor sticks to the end and returns zeroes.
+
+struct Data_Cursor {
+  const u8 *start = nullptr;
+  const u8 *pointer = nullptr;
+  const u8 *end = nullptr;
+
+  void init(const void *data, u64 size) {
+    start = pointer = static_cast <const u8 *>(data);
+    end = start + size;
+  }
+
+  inline bool at_end()  { return pointer >= end; }
+  inline u64 offset()   { return pointer - start; }
+  inline u64 left()     { return pointer < end ? end - pointer : 0; }
+
+  inline void skip(u64 size) {
+    pointer = (size > left()) ? end : pointer + size;
+  }
+
+  inline void seek(u64 new_offset) {
+    pointer = (new_offset > (u64)(end - start)) ? end : start + new_offset;
+  }
+
+  template <typename T>
+  inline T read() {
+    T result = 0;
+    if (left() < sizeof(T)) {
+      pointer = end;
+      return result;
+    }
+    memcpy(&result, pointer, sizeof(T));
+    pointer += sizeof(T);
+    return result;
+  }
+
+  inline u8  read_u8()  { return read<u8>();  }
+  inline u16 read_u16() { return read<u16>(); }
+  inline u32 read_u32() { return read<u32>(); }
+  inline u64 read_u64() { return read<u64>(); }
+  inline s8  read_s8()  { return read<s8>();  }
+  inline s16 read_s16() { return read<s16>(); }
+  inline s32 read_s32() { return read<s32>(); }
+  inline s64 read_s64() { return read<s64>(); }
+
+  u64 read_uleb128() {
+    u64 result = 0;
+    u32 shift = 0;
+    while (pointer < end) {
+      u8 byte = *pointer++;
+      if (shift < 64)  result |= (u64)(byte & 0x7f) << shift;
+      shift += 7;
+      if ((byte & 0x80) == 0)  break;
+    }
+    return result;
+  }
+
+  s64 read_sleb128() {
+    s64 result = 0;
+    u32 shift = 0;
+    u8 byte = 0;
+    while (pointer < end) {
+      byte = *pointer++;
+      if (shift < 64)  result |= (s64)(byte & 0x7f) << shift;
+      shift += 7;
+      if ((byte & 0x80) == 0)  break;
+    }
+    if (shift < 64 && (byte & 0x40))  result |= -((s64)1 << shift);
+    return result;
+  }
+
+  const char * read_cstring() {
+    auto string_start = reinterpret_cast <const char *>(pointer);
+    while (pointer < end && *pointer != '\0')  pointer++;
+    if (pointer < end)  pointer++; // Skip terminating zero
+    return string_start;
+  }
+};
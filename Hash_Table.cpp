@@ -1,16 +1,19 @@
 #include "Hash_Table.h"
 
+// String keys are owned by the table
 template <>
-u32 get_hash(char *key, u32 key_length, u32 num_buckets) {
-  return MurmurHash2(key, key_length, HASH_SEED) % num_buckets;
-}
+char * hash_table_copy_key(char *key) { return strdup(key); }
 
 template <>
-s32 get_key_length(char *key) { return strlen(key); }
+void hash_table_free_key(char *key) { free(key); }
 
+template <>
+bool keys_equal(char *first, char *second) { return strcmp(first, second) == 0; }
 
 template <>
-bool keys_equal(char *first, char *second, s32 key_length) { return key_length != -1 ? strncmp(first, second, key_length) == 0 : false; }
+u32 get_hash(char *key) {
+  return MurmurHash2(key, strlen(key), HASH_SEED);
+}
 
 
 unsigned int MurmurHash2(const void * key, int len, unsigned int seed) {
@@ -61,29 +64,3 @@ unsigned int MurmurHash2(const void * key, int len, unsigned int seed) {
 	return h;
 } 
 
-
-///////////////////////////////////////
-//
-//    Prime number finding
-//
-
-s32 is_prime(s32 number) {
-  if (number % 2 == 0)  return 0;
-  if (number == 2)  return 1;
-  if (number < 2)   return -1;
-
-  auto root = floor(sqrt(number));
-  for (s32 i = 3; i <= root; i += 2) {
-    if (number % i == 0)  return 0;
-  }
-
-  return 1;
-}
-
-s32 next_prime(s32 number) {
-  s32 next_number = number;
-  while (is_prime(next_number) != 1) {
-    next_number++;
-  }
-  return next_number;
-}
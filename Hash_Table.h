@@ -3,15 +3,25 @@
 #include "common.h"
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 
 #include <stdio.h>
+#include <emmintrin.h>
 
-#include "Array.h"
+// Open addressing table with power of two capacity. Every slot has a control byte: the empty
+// marker or 7 bits of the key hash. Lookup compares control bytes of 16 slots at once with SSE2,
+// keys are compared only for the slots with the same hash bits.
+//
+// Probing is linear, so removal shifts following items back instead of leaving tombstones,
+// and the table never degrades after many inserts and removes (breakpoints of step_over).
+// Table grows at 7/8 load and shrinks at 1/8 load, so the same count never flips the size.
+//
+// char * keys are copied on insert and compared as strings.
 
 // TODO:
 // * Implement subscription operator overload for inserting
-// * Refactor to minimize template and malloc usage
+
+constexpr s32 hash_table_group_size = 16;
+constexpr s8 hash_table_empty = -128; // Only control byte with the high bit set
 
 template <typename K, typename T>
 struct Hash_Table_Item {
@@ -19,50 +29,29 @@ struct Hash_Table_Item {
   T value;
 };
 
-template <typename K, typename T>
-static Hash_Table_Item<K, T> hash_table_item_init(K key, T value) {
-  return (Hash_Table_Item<K, T>){key, value};
-}
-
-template <typename T>
-static Hash_Table_Item<char *, T> hash_table_item_init(char *key, T value) {
-  Hash_Table_Item<char *, T> new_item;
-
-  new_item.key = strdup(key);
-  if (new_item.key == nullptr)  return Hash_Table_Item<char *, T>{nullptr, (T)NULL}; 
-
-  new_item.value = value;
-
-  return new_item;
-}
-
-
-template <typename K, typename T>
-static void hash_table_item_delete(Hash_Table_Item<K, T> hash_table_item) { }
+template <typename K>
+inline K hash_table_copy_key(K key) { return key; }
 
-template <char *, typename T>
-static void hash_table_item_delete(Hash_Table_Item<char *, T> hash_table_item) {
-  if (hash_table_item.key)  free(hash_table_item.key);
-}
+template <typename K>
+inline void hash_table_free_key(K) { }
 
 template <typename K>
-s32 get_key_length(K key) { return 1; }
+inline bool keys_equal(K first, K second) { return first == second; }
 
 template <typename K>
-bool keys_equal(K first, K second, s32 key_length) { return first == second; }
+u32 get_hash(K key);
 
 
 template <typename K, typename T>
 struct Hash_Table {
-  s32 allocated_size = -1;
   s32 count = -1;
-  s32 base_size = -1;
-
-  Array<Hash_Table_Item<K, T>> * buckets = nullptr;
+  s32 capacity = -1;     // Power of two
+  s32 min_capacity = -1; // Capacity requested by init, table doesn't shrink below it
 
-  bool verbose = true;
+  s8 * control = nullptr; // capacity + group size - 1 bytes, first bytes are mirrored at the end for unaligned group loads
+  Hash_Table_Item<K, T> * items = nullptr;
 
-  constexpr static const s32 min_base_size = 50;
+  constexpr static const s32 default_capacity = 64;
 
   void init(s32 base_size = 0);
   void deinit();
@@ -76,155 +65,172 @@ struct Hash_Table {
   T * search(K key);
 
 private:
-  void resize(s32 new_base_size);
-
-  inline void resize_up() {
-    s32 new_base_size = allocated_size * 2;
-    resize(new_base_size);
-  }
+  s32 find_slot(K key, u32 hash, s32 *empty_slot = nullptr);
+  s32 find_empty_slot(u32 hash);
+  void set_control(s32 slot, s8 value);
+  void resize(s32 new_capacity);
 
-  // @Speed: It discouraged to use this function. Better preallocate the right amount of memory.
-  inline void resize_down() {
-    s32 new_base_size = allocated_size / 2;
-    resize(new_base_size);
-  }
+  inline s32 get_mask() { return capacity - 1; }
+  inline static s8 get_control_hash(u32 hash) { return hash >> 25; }
 };
 
 
-#define SWAP(a, b) ({auto __tmp = (a); (a) = (b); (b) = (__tmp);})
-
-template <typename K>
-u32 get_hash(K key, u32 key_length, u32 num_buckets);
-
-s32 next_prime(s32 number);
-
 template <typename K, typename T>
 void Hash_Table<K, T>::init(s32 base_size) {
-  base_size = base_size > min_base_size ? base_size : min_base_size;
-  allocated_size = next_prime(base_size); // Use next prime to avoid clustering, hence get better distribution
-  buckets = static_cast <Array<Hash_Table_Item<K, T>> *>(calloc((size_t)allocated_size, sizeof(Array<Hash_Table_Item<K, T>>)));
-
-  For_Count (allocated_size, i) {
-    buckets[i].minimal_size = 1;
-    buckets[i].grow_factor = 2;
-    buckets[i].init();
-  }
+  s32 new_capacity = hash_table_group_size;
+  while (new_capacity < default_capacity || new_capacity < base_size)  new_capacity *= 2;
 
   count = 0;
+  capacity = new_capacity;
+  min_capacity = new_capacity;
+
+  control = static_cast <s8 *>(malloc(capacity + hash_table_group_size - 1));
+  memset(control, hash_table_empty, capacity + hash_table_group_size - 1);
+  items = static_cast <Hash_Table_Item<K, T> *>(malloc(sizeof(Hash_Table_Item<K, T>) * capacity));
 }
 
 template <typename K, typename T>
 void Hash_Table<K, T>::deinit() {
-  For_Count (allocated_size, i) {
-    For_Pointer (buckets[i]) {
-      hash_table_item_delete(*it);
-    }
-    buckets[i].deinit();
+  For_Count (capacity, i) {
+    if (control[i] != hash_table_empty)  hash_table_free_key(items[i].key);
   }
 
-  if (buckets)  free(buckets);
+  if (control)  free(control);
+  if (items)  free(items);
 
-  base_size = -1;
-  allocated_size = -1;
-  buckets = nullptr;
   count = -1;
+  capacity = -1;
+  min_capacity = -1;
+  control = nullptr;
+  items = nullptr;
 }
 
 template <typename K, typename T>
-void Hash_Table<K, T>::insert(K key, T value) {
-  if (buckets == nullptr || allocated_size == -1) {
-    init();
-  }
+void Hash_Table<K, T>::set_control(s32 slot, s8 value) {
+  control[slot] = value;
+  if (slot < hash_table_group_size - 1)  control[capacity + slot] = value;
+}
 
-  u32 load = count * 100 / allocated_size;
-  if (load >= 100) {
-    if (verbose) {
-      printf("WARNING! Hash_Table has to increase in size. Consider preallocating bigger size.");
+// Returns slot of the key or -1 and the empty slot, where the key would be inserted
+template <typename K, typename T>
+s32 Hash_Table<K, T>::find_slot(K key, u32 hash, s32 *empty_slot) {
+  auto mask = get_mask();
+  auto hash_bits = _mm_set1_epi8(get_control_hash(hash));
+
+  for (s32 position = hash & mask; ; position = (position + hash_table_group_size) & mask) {
+    auto group = _mm_loadu_si128(reinterpret_cast <const __m128i *>(control + position));
+
+    u32 matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, hash_bits));
+    while (matches) {
+      s32 slot = (position + __builtin_ctz(matches)) & mask;
+      if (keys_equal(items[slot].key, key))  return slot;
+      matches &= matches - 1;
     }
-    resize_up();
-  }
 
-  auto item = hash_table_item_init(key, value);
-  auto key_length = get_key_length<K>(key);
-  auto index = get_hash<K>(key, key_length, allocated_size);
-
-  bool item_exists = false;
-  if (buckets[index].count > 0) {
-    For_Pointer (buckets[index]) {
-      if (keys_equal(it->key, key, key_length)) {
-        buckets[index].remove_unordered(it - buckets[index].data);
-        hash_table_item_delete(*it);
-
-        buckets[index].add(item);
-        item_exists = true;
-        break;
-      }
+    // Items are never placed after an empty slot of their probe sequence
+    u32 empties = _mm_movemask_epi8(group);
+    if (empties) {
+      if (empty_slot)  *empty_slot = (position + __builtin_ctz(empties)) & mask;
+      return -1;
     }
   }
-
-  if (!item_exists) {
-    buckets[index].add(item);
-    count++;
-  }
 }
 
 template <typename K, typename T>
-void Hash_Table<K, T>::remove(K key) {
-  // @Speed: Avoid reallocating especially in case of preallocation in fast buffer
-  u32 load = count * 100 / allocated_size;
-  if (load < 50) {
-    resize_down();
-  }
+s32 Hash_Table<K, T>::find_empty_slot(u32 hash) {
+  auto mask = get_mask();
 
-  auto key_length = get_key_length<K>(key);
-  auto index = get_hash<K>(key, key_length, allocated_size);
+  for (s32 position = hash & mask; ; position = (position + hash_table_group_size) & mask) {
+    auto group = _mm_loadu_si128(reinterpret_cast <const __m128i *>(control + position));
 
-  For_Pointer (buckets[index]) {
-    if (keys_equal(it->key, key, key_length)) {
-      buckets[index].remove_unordered(it - buckets[index].data);
-      hash_table_item_delete(*it);
-      count--;
-
-      return;
-    }
+    u32 empties = _mm_movemask_epi8(group);
+    if (empties)  return (position + __builtin_ctz(empties)) & mask;
   }
 }
 
 template <typename K, typename T>
 T * Hash_Table<K, T>::search(K key) {
-  auto key_length = get_key_length<K>(key);
-  auto index = get_hash<K>(key, key_length, allocated_size);
+  if (count <= 0)  return nullptr;
 
-  For_Pointer (buckets[index]) {
-    if (keys_equal(it->key, key, key_length)) {
-      return &(it->value);
-    }
+  auto slot = find_slot(key, get_hash(key));
+  return slot != -1 ? &items[slot].value : nullptr;
+}
+
+template <typename K, typename T>
+void Hash_Table<K, T>::insert(K key, T value) {
+  if (control == nullptr)  init();
+
+  auto hash = get_hash(key);
+
+  s32 empty_slot;
+  auto slot = find_slot(key, hash, &empty_slot);
+  if (slot != -1) {
+    items[slot].value = value;
+    return;
   }
-  
-  return nullptr;
+
+  if ((count + 1) * 8 > capacity * 7) {
+    resize(capacity * 2);
+    empty_slot = find_empty_slot(hash);
+  }
+
+  slot = empty_slot;
+  items[slot] = (Hash_Table_Item<K, T>){hash_table_copy_key(key), value};
+  set_control(slot, get_control_hash(hash));
+  count++;
 }
 
 template <typename K, typename T>
-void Hash_Table<K, T>::resize(s32 new_base_size) {
-  if (new_base_size < min_base_size)  return;
-
-  Hash_Table<K, T> new_ht;
-  new_ht.init(new_base_size);
-  
-  For_Count (this->allocated_size, i) {
-    For (this->buckets[i]) {
-      new_ht.insert(it.key, it.value);
-    }
+void Hash_Table<K, T>::remove(K key) {
+  if (count <= 0)  return;
+
+  auto slot = find_slot(key, get_hash(key));
+  if (slot == -1)  return;
+
+  hash_table_free_key(items[slot].key);
+  count--;
+
+  // Items after the hole, which could be placed at it, are moved back to keep probe sequences unbroken
+  auto mask = get_mask();
+  auto hole = slot;
+  for (s32 next = (hole + 1) & mask; control[next] != hash_table_empty; next = (next + 1) & mask) {
+    s32 home = get_hash(items[next].key) & mask;
+
+    // Item stays if its home is cyclically in (hole, next]
+    if (((next - home) & mask) < ((next - hole) & mask))  continue;
+
+    items[hole] = items[next];
+    set_control(hole, control[next]);
+    hole = next;
   }
+  set_control(hole, hash_table_empty);
 
-  this->base_size = new_ht.base_size;
-  this->count = new_ht.count;
+  if (count * 8 < capacity && capacity > min_capacity)  resize(capacity / 2);
+}
 
-  // TODO: Make swaps hardware-atomic
-  SWAP(this->allocated_size, new_ht.allocated_size);
-  SWAP(this->buckets, new_ht.buckets);
+template <typename K, typename T>
+void Hash_Table<K, T>::resize(s32 new_capacity) {
+  auto old_control = control;
+  auto old_items = items;
+  auto old_capacity = capacity;
+
+  capacity = new_capacity;
+  control = static_cast <s8 *>(malloc(capacity + hash_table_group_size - 1));
+  memset(control, hash_table_empty, capacity + hash_table_group_size - 1);
+  items = static_cast <Hash_Table_Item<K, T> *>(malloc(sizeof(Hash_Table_Item<K, T>) * capacity));
+
+  // Keys are moved without copying
+  For_Count (old_capacity, i) {
+    if (old_control[i] == hash_table_empty)  continue;
+
+    auto hash = get_hash(old_items[i].key);
+    auto slot = find_empty_slot(hash);
+    items[slot] = old_items[i];
+    set_control(slot, get_control_hash(hash));
+  }
 
-  new_ht.deinit();
+  free(old_control);
+  free(old_items);
 }
 
 ///////////////////////////////////////
@@ -237,10 +243,14 @@ unsigned int MurmurHash2(const void * key, int len, unsigned int seed);
 
 #define HASH_SEED 41
 
+// Whole key is hashed, so integer keys differing only in high bytes don't collide
 template <typename K>
-u32 get_hash(K key, u32 key_length, u32 num_buckets) {
-  return MurmurHash2(&key, key_length, HASH_SEED) % num_buckets;
+u32 get_hash(K key) {
+  return MurmurHash2(&key, sizeof(K), HASH_SEED);
 }
 
-s32 is_prime(s32 number);
-s32 next_prime(s32 number);
+// Addresses are the most common keys. Multiplicative hashing mixes every byte into the high half of the product.
+template <>
+inline u32 get_hash(u64 key) {
+  return (key * 0x9e3779b97f4a7c15ull) >> 32;
+}
@@ -0,0 +1,74 @@
+#include "String_Pool.h"
+
+void String_Pool::init() {
+  blocks.init();
+  current_block = nullptr;
+  block_used = 0;
+  strings.init(1024);
+}
+
+void String_Pool::deinit() {
+  For (blocks)  free(it);
+  blocks.deinit();
+  current_block = nullptr;
+  block_used = 0;
+
+  strings.deinit();
+}
+
+char * String_Pool::allocate(u64 size) {
+  size = (size + alignof(String_Header) - 1) & ~(alignof(String_Header) - 1);
+
+  // Long strings get their own block, the current one is kept for the following strings
+  if (size > default_block_size / 4) {
+    auto memory = static_cast <char *>(malloc(size));
+    blocks.add(memory);
+    return memory;
+  }
+
+  if (!current_block || block_used + size > default_block_size) {
+    current_block = static_cast <char *>(malloc(default_block_size));
+    blocks.add(current_block);
+    block_used = 0;
+  }
+
+  auto memory = current_block + block_used;
+  block_used += size;
+  return memory;
+}
+
+char * String_Pool::intern(const char *string, u64 length) {
+  if (blocks.count < 0)  init();
+
+  String_Key key = {string, (u32)length, MurmurHash2(string, length, HASH_SEED)};
+
+  auto existing = strings.search(key);
+  if (existing)  return *existing;
+
+  auto header = reinterpret_cast <String_Header *>(allocate(sizeof(String_Header) + length + 1));
+  header->length = key.length;
+  header->hash = key.hash;
+
+  auto interned = reinterpret_cast <char *>(header + 1);
+  memcpy(interned, string, length);
+  interned[length] = '\0';
+
+  key.data = interned;
+  strings.insert(key, interned);
+
+  return interned;
+}
+
+char * String_Pool::intern(const char *string) {
+  return intern(string, strlen(string));
+}
+
+char * String_Pool::find(const char *string) {
+  if (blocks.count < 0)  return nullptr;
+
+  u64 length = strlen(string);
+  String_Key key = {string, (u32)length, MurmurHash2(string, length, HASH_SEED)};
+
+  auto existing = strings.search(key);
+  return existing ? *existing : nullptr;
+}
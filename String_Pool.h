@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common.h"
+#include "Array.h"
+#include "Hash_Table.h"
+
+// Interned strings are stored once, in big blocks of the pool, preceded by their length and hash.
+// Equal strings get the same handle, so interned strings are compared by pointer.
+// Handles are zero terminated, usable as plain C strings, and stay valid until the pool is deinitialized.
+
+struct String_Header {
+  u32 length;
+  u32 hash;
+};
+
+inline String_Header * get_string_header(const char *interned) {
+  return reinterpret_cast <String_Header *>(const_cast <char *>(interned)) - 1;
+}
+
+inline u32 get_interned_length(const char *interned) { return get_string_header(interned)->length; }
+inline u32 get_interned_hash(const char *interned)   { return get_string_header(interned)->hash; }
+
+// Key of Hash_Table for interned strings: hash is read from the header, keys are compared by pointer
+struct Interned_String {
+  char *data;
+
+  inline bool operator ==(Interned_String other) const { return data == other.data; }
+};
+
+template <>
+inline u32 get_hash(Interned_String key) { return get_interned_hash(key.data); }
+
+// String, which isn't interned yet, compared by content
+struct String_Key {
+  const char *data;
+  u32 length;
+  u32 hash;
+
+  inline bool operator ==(String_Key other) const {
+    return hash == other.hash && length == other.length && memcmp(data, other.data, length) == 0;
+  }
+};
+
+template <>
+inline u32 get_hash(String_Key key) { return key.hash; }
+
+
+struct String_Pool {
+  Array<char *> blocks;
+  char *current_block = nullptr;
+  u64 block_used = 0;
+
+  Hash_Table<String_Key, char *> strings; // Keys point to the interned strings
+
+  constexpr static const u64 default_block_size = 64 * 1024;
+
+  void init();
+  void deinit();
+
+  char * intern(const char *string);
+  char * intern(const char *string, u64 length);
+
+  char * find(const char *string); // Returns null when the string isn't interned, pool isn't changed
+
+private:
+  char * allocate(u64 size);
+};
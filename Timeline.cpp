@@ -0,0 +1,82 @@
+#include "Timeline.h"
+#include "Array.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// Buffers are kept after their threads exit, so their zones could still be exported
+Timeline_Buffer * create_timeline_buffer() {
+  auto buffer = (Timeline_Buffer *)calloc(1, sizeof(Timeline_Buffer));
+  buffer->thread_id = (s32)syscall(SYS_gettid);
+  buffer->thread_name = timeline_thread_name;
+
+  // Lock-free push to the front of the list, nothing is ever removed from it
+  auto head = timeline_buffers.load(std::memory_order_relaxed);
+  do {
+    buffer->next = head;
+  } while (!timeline_buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+
+  timeline_thread_buffer = buffer;
+  return buffer;
+}
+
+void set_timeline_enabled(bool enabled) {
+  if (enabled && !timeline_enabled)  timeline_start_time = get_timeline_time();
+  timeline_enabled = enabled;
+}
+
+static void write_timeline_zones(FILE *f, Timeline_Buffer *buffer, Array<Timeline_Zone_Event> *events, bool *is_first_event) {
+  // Owner thread keeps writing while the buffer is copied. Zones, which could be overwritten during the copy,
+  // are dropped after it, by the count written by then. The slot of the zone being written is dropped as well.
+  auto written_count = buffer->written_count.load(std::memory_order_acquire);
+  auto first_index = written_count > timeline_buffer_size ? written_count - timeline_buffer_size : 0;
+
+  events->reset();
+  for (auto i = first_index; i < written_count; i++) {
+    events->add(buffer->events[i % timeline_buffer_size]);
+  }
+
+  auto written_after_copy = buffer->written_count.load(std::memory_order_acquire);
+  auto first_valid_index = written_after_copy >= timeline_buffer_size ? written_after_copy - timeline_buffer_size + 1 : 0;
+
+  auto start_time = timeline_start_time.load();
+  For_Count (events->count, i) {
+    if (first_index + i < first_valid_index)  continue;
+
+    auto event = &(*events)[i];
+    if (event->start_time < start_time)  continue;
+
+    fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", *is_first_event ? "" : ",",
+            event->name, getpid(), buffer->thread_id, (event->start_time - start_time) / 1000.0,
+            (event->end_time - event->start_time) / 1000.0);
+    *is_first_event = false;
+  }
+}
+
+void export_timeline(const char *file_path) {
+  auto f = fopen(file_path, "w");
+  if (!f) {
+    printf("Error: couldn't open file %s for writing\n", file_path);
+    return;
+  }
+  defer { fclose(f); };
+
+  Array<Timeline_Zone_Event> events;
+  events.init();
+  defer { events.deinit(); };
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  bool is_first_event = true;
+  for (auto buffer = timeline_buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+    if (buffer->thread_name) {
+      fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+              is_first_event ? "" : ",", getpid(), buffer->thread_id, buffer->thread_name);
+      is_first_event = false;
+    }
+
+    write_timeline_zones(f, buffer, &events, &is_first_event);
+  }
+
+  fprintf(f, "\n]}\n");
+}
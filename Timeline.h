@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common.h"
+#include "defer.h"
+#include <atomic>
+#include <time.h>
+
+// Timeline of zones: scopes timed with timeline_zone("name"). Every thread writes finished zones into its own
+// ring buffer without locks, export_timeline writes buffers of all threads as Chrome trace JSON, which is opened
+// in chrome://tracing or ui.perfetto.dev. Recording is off until set_timeline_enabled(true), then a zone costs
+// two clock reads; when it's off, a zone costs a load of the flag.
+
+constexpr u32 timeline_buffer_size = 65536; // Zones kept per thread, older ones are overwritten
+
+struct Timeline_Zone_Event {
+  const char *name;
+  u64 start_time;
+  u64 end_time;
+};
+
+struct Timeline_Buffer {
+  Timeline_Zone_Event events[timeline_buffer_size];
+  std::atomic<u64> written_count; // Zones ever written, only the owner thread increments it
+
+  s32 thread_id;
+  const char *thread_name;
+  Timeline_Buffer *next;
+};
+
+inline std::atomic<bool> timeline_enabled;
+inline std::atomic<u64> timeline_start_time;           // Zones started before the last enabling aren't exported
+inline std::atomic<Timeline_Buffer *> timeline_buffers; // Buffers of all threads, which recorded anything
+
+inline thread_local Timeline_Buffer *timeline_thread_buffer;
+inline thread_local const char *timeline_thread_name;
+
+inline u64 get_timeline_time() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (u64)time.tv_sec * 1000000000ull + (u64)time.tv_nsec;
+}
+
+Timeline_Buffer * create_timeline_buffer();
+
+struct Timeline_Zone {
+  const char *name;
+  u64 start_time; // Zero if recording was off, when the zone was started
+};
+
+inline Timeline_Zone begin_timeline_zone(const char *name) {
+  if (!timeline_enabled.load(std::memory_order_relaxed))  return (Timeline_Zone){name, 0};
+  return (Timeline_Zone){name, get_timeline_time()};
+}
+
+inline void end_timeline_zone(Timeline_Zone *zone) {
+  if (zone->start_time == 0)  return;
+
+  auto buffer = timeline_thread_buffer;
+  if (!buffer)  buffer = create_timeline_buffer();
+
+  // Single writer: the event is stored first, then published for the exporting thread
+  auto index = buffer->written_count.load(std::memory_order_relaxed);
+  buffer->events[index % timeline_buffer_size] = (Timeline_Zone_Event){zone->name, zone->start_time, get_timeline_time()};
+  buffer->written_count.store(index + 1, std::memory_order_release);
+}
+
+// Zone lasts until the end of the scope. Name has to be a string literal, or outlive the export
+#define timeline_zone(name) \
+  auto CONCAT(__timeline_zone, __LINE__) = begin_timeline_zone(name); \
+  defer { end_timeline_zone(&CONCAT(__timeline_zone, __LINE__)); }
+
+// Name of the calling thread in the exported timeline
+inline void set_timeline_thread_name(const char *name) {
+  timeline_thread_name = name;
+  if (timeline_thread_buffer)  timeline_thread_buffer->thread_name = name;
+}
+
+void set_timeline_enabled(bool enabled);
+void export_timeline(const char *file_path);
@@ -12,7 +12,50 @@ inline u8 inject_int_instruction(Debugger *dbg, u64 address) {
   return saved_instruction;
 }
 
+// Batched version for many addresses at once. Addresses should be sorted and unique.
+// Every 8-byte word of memory is read and written only once, however many int3s it gets.
+void inject_int_instructions(Debugger *dbg, Array<u64> *addresses, Array<u8> *saved_instructions) {
+  timeline_zone("inject int3");
+
+  saved_instructions->reset();
+
+  s32 i = 0;
+  while (i < addresses->count) {
+    auto word_address = addresses->data[i] & ~(u64)7;
+    auto word = read_memory(dbg, word_address);
+
+    while (i < addresses->count && addresses->data[i] < word_address + 8) {
+      auto shift = (addresses->data[i] - word_address) * 8;
+      saved_instructions->add(static_cast<u8> ((word >> shift) & 0xff));
+      word = (word & ~((u64)0xff << shift)) | ((u64)0xcc << shift);
+      i++;
+    }
+
+    write_memory(dbg, word_address, word);
+  }
+}
+
+void remove_injected_int_instructions(Debugger *dbg, Array<u64> *addresses, Array<u8> *saved_instructions) {
+  timeline_zone("remove int3");
+
+  s32 i = 0;
+  while (i < addresses->count) {
+    auto word_address = addresses->data[i] & ~(u64)7;
+    auto word = read_memory(dbg, word_address);
+
+    while (i < addresses->count && addresses->data[i] < word_address + 8) {
+      auto shift = (addresses->data[i] - word_address) * 8;
+      word = (word & ~((u64)0xff << shift)) | ((u64)saved_instructions->data[i] << shift);
+      i++;
+    }
+
+    write_memory(dbg, word_address, word);
+  }
+}
+
 void enable_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
+  timeline_zone("enable breakpoint");
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return;
@@ -38,6 +81,8 @@ inline void remove_injected_int_instruction(Debugger *dbg, u64 address, u8 saved
 }
 
 void disable_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
+  timeline_zone("disable breakpoint");
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return;
@@ -54,18 +99,61 @@ void disable_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
   dbg_success();
 }
 
+// Disables all enabled breakpoints for the time of uninterrupted execution (profiling, tracing)
+void lift_breakpoints(Debugger *dbg, Array<Breakpoint *> *lifted_breakpoints) {
+  timeline_zone("lift breakpoints");
+
+  For (dbg->breakpoints) {
+    if (it->enabled) {
+      disable_breakpoint(dbg, it);
+      lifted_breakpoints->add(it);
+    }
+  }
+
+  // Modes don't handle the dynamic linker's hook, modules are refreshed on lookup misses instead
+  auto rendezvous_breakpoint = dbg->modules.rendezvous_breakpoint;
+  if (rendezvous_breakpoint && rendezvous_breakpoint->enabled) {
+    disable_breakpoint(dbg, rendezvous_breakpoint);
+    lifted_breakpoints->add(rendezvous_breakpoint);
+  }
+}
+
+void restore_lifted_breakpoints(Debugger *dbg, Array<Breakpoint *> *lifted_breakpoints) {
+  timeline_zone("restore lifted breakpoints");
+
+  if (dbg->state == Debugger_State::NOT_LOADED)  return;
+
+  For (*lifted_breakpoints) {
+    enable_breakpoint(dbg, it);
+  }
+}
+
 /////////////////////////////////////
 //
 //  Breakpoint at address
 //
 
+// Breakpoints are kept in the session arena and the removed ones are reused,
+// so temporary breakpoints of step_over don't allocate after the first steps
+Breakpoint *allocate_breakpoint(Debugger *dbg) {
+  if (dbg->free_breakpoints.count > 0)  return dbg->free_breakpoints.pop();
+  return static_cast <Breakpoint *>(dbg->session_arena.allocate(sizeof(Breakpoint), alignof(Breakpoint)));
+}
+
+inline void release_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
+  dbg->free_breakpoints.add(breakpoint);
+}
+
 Breakpoint *set_breakpoint(Debugger *dbg, u64 address) {
+  time_command(Stats_Command::SET_BREAKPOINT);
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return nullptr;
   }
 
-  Breakpoint *breakpoint = static_cast<Breakpoint *> (malloc(sizeof(Breakpoint))); 
+  Breakpoint *breakpoint = allocate_breakpoint(dbg);
+  *breakpoint = Breakpoint();
   breakpoint->enabled = false;
   breakpoint->address = address;
 
@@ -79,6 +167,8 @@ Breakpoint *set_breakpoint(Debugger *dbg, u64 address) {
 }
 
 void remove_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
+  time_command(Stats_Command::REMOVE_BREAKPOINT);
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return;
@@ -103,12 +193,14 @@ void remove_breakpoint(Debugger *dbg, Breakpoint *breakpoint) {
 
   dbg->breakpoints.remove_unordered(breakpoint_index);
 
-  free(breakpoint);
+  release_breakpoint(dbg, breakpoint);
   dbg_success();
 }
 
 
 void remove_breakpoint(Debugger *dbg, u64 address) {
+  time_command(Stats_Command::REMOVE_BREAKPOINT);
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return;
@@ -133,7 +225,7 @@ void remove_breakpoint(Debugger *dbg, u64 address) {
   assert(breakpoint_index != -1);
   dbg->breakpoints.remove_unordered(breakpoint_index);
 
-  free(breakpoint);
+  release_breakpoint(dbg, breakpoint);
   dbg_success();
 }
 
@@ -196,13 +288,14 @@ bool match_parameter_type(dwarf::die type_die, Function_Argument *parameter, u32
 bool match_function_declaration(dwarf::die function_die, Function_Declaration *declaration) {
   if (function_die.tag != dwarf::DW_TAG::subprogram)  return false;
 
-  std::string die_function_name;
+  // Names point into the string section, nothing is copied
+  const char *die_function_name = nullptr;
   if (function_die.has(dwarf::DW_AT::name)) {
-    function_die[dwarf::DW_AT::name].as_string(die_function_name);
+    die_function_name = function_die[dwarf::DW_AT::name].as_cstr();
   } else if (function_die.has(dwarf::DW_AT::specification)) {
     auto member_function_die = at_specification(function_die);
     if (member_function_die.has(dwarf::DW_AT::name)) {
-      member_function_die[dwarf::DW_AT::name].as_string(die_function_name);
+      die_function_name = member_function_die[dwarf::DW_AT::name].as_cstr();
     } else {
       return false;
     }
@@ -210,7 +303,7 @@ bool match_function_declaration(dwarf::die function_die, Function_Declaration *d
     return false;
   }
 
-  if (strncmp(die_function_name.c_str(), declaration->function_name, declaration->name_length) == 0) {
+  if (strncmp(die_function_name, declaration->function_name, declaration->name_length) == 0) {
     if (declaration->arguments.count <= 0) {
       u32 parameter_count = 0;
       for (const auto &child : function_die) {
@@ -246,7 +339,45 @@ bool match_function_declaration(dwarf::die function_die, Function_Declaration *d
   return false;
 }
 
+// Returns DWARF address of the first line after prologue of the matched function, or zero
+u64 find_function_body(const dwarf::compilation_unit &cu, Function_Declaration *declaration, Source_Location *location) {
+  for (const auto &die : cu.root()) {
+    if (die.tag == dwarf::DW_TAG::subprogram) {
+      if (match_function_declaration(die, declaration)) {
+        if (die.has(dwarf::DW_AT::low_pc)) {
+          const auto &lt = cu.get_line_table();
+          auto line_entry = lt.find_address(at_low_pc(die));
+          if (line_entry == lt.end())  continue;
+          ++line_entry; // skip function prologue
+
+          auto file = lt.get_file(line_entry->file_index);
+          location->file_path = const_cast <char *>(file->path.c_str());
+          location->file_name = extract_file_name_from_path(location->file_path);
+          location->line = line_entry->line;
+
+          return line_entry->address;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+u64 find_function_body(const dwarf::dwarf &dwarf, Function_Declaration *declaration, Source_Location *location) {
+  timeline_zone("find function body");
+
+  for (const auto &cu : dwarf.compilation_units()) {
+    auto address = find_function_body(cu, declaration, location);
+    if (address)  return address;
+  }
+
+  return 0;
+}
+
 Breakpoint *set_breakpoint(Debugger *dbg, const char *c_function_declaration_string) {
+  time_command(Stats_Command::SET_BREAKPOINT);
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return nullptr;
@@ -264,32 +395,65 @@ Breakpoint *set_breakpoint(Debugger *dbg, const char *c_function_declaration_str
     return nullptr;
   }
 
-  for (const auto &cu : dbg->dwarf.compilation_units()) {
-    for (const auto &die : cu.root()) {
-      if (die.tag == dwarf::DW_TAG::subprogram) {
-        if (match_function_declaration(die, &declaration)) {
-          if (die.has(dwarf::DW_AT::low_pc)) {
-            auto low_pc = at_low_pc(die);
-            auto line_entry = get_line_entry_from_pc(dbg, low_pc);
-            ++line_entry; // skip function prologue
-            auto bp = set_breakpoint(dbg, offset_dwarf_address(dbg, line_entry->address));
-
-            const auto &lt = cu.get_line_table();
-            auto file = lt.get_file(line_entry->file_index);
-            bp->location.file_path = const_cast <char *>(file->path.c_str());
-            bp->location.file_name = extract_file_name_from_path(bp->location.file_path);
-            bp->location.line = line_entry->line;
-
-            dbg_success();
-            return bp;
-          }
+  Source_Location location;
+  u64 address = 0;
+
+  dbg->stats.dwarf_lookups++;
+  bool is_indexing_in_progress = is_indexing(dbg);
+
+  // Index knows units with the exact name, all units are searched only when it doesn't help,
+  // as declarations are matched by the name prefix
+  Small_Array<u32, 8> unit_indices;
+  unit_indices.init();
+  defer { unit_indices.deinit(); };
+
+  find_indexed_units(dbg, declaration.function_name, declaration.name_length, &unit_indices);
+  auto &units = dbg->dwarf.compilation_units();
+  For (unit_indices) {
+    if (it >= units.size())  continue;
+    address = find_function_body(units[it], &declaration, &location);
+    if (address)  break;
+  }
+
+  // Function could be in a unit, which isn't indexed yet
+  if (!address && is_indexing_in_progress) {
+    add_pending_breakpoint(dbg, c_function_declaration_string, nullptr, 0);
+    return nullptr;
+  }
+
+  if (!address)  address = find_function_body(dbg->dwarf, &declaration, &location);
+
+  if (address) {
+    address = offset_dwarf_address(dbg, address);
+  } else {
+    // Libraries loaded so far are searched after the executable, their debug info is loaded on demand
+    auto modules = get_modules(dbg);
+    if (modules) {
+      For_Pointer (*modules) {
+        if (it->is_main)  continue;
+
+        auto module_dwarf = get_module_dwarf(dbg, it);
+        if (!module_dwarf)  continue;
+
+        address = find_function_body(*module_dwarf, &declaration, &location);
+        if (address) {
+          address += it->load_bias;
+          break;
         }
       }
     }
   }
 
-  dbg_fail("couldn't find specified function");
-  return nullptr;
+  if (!address) {
+    dbg_fail("couldn't find specified function");
+    return nullptr;
+  }
+
+  auto bp = set_breakpoint(dbg, address);
+  bp->location = location;
+
+  dbg_success();
+  return bp;
 }
 
 
@@ -310,6 +474,8 @@ bool is_suffix(const char *str, char *suffix) {
 }
 
 Breakpoint *set_breakpoint(Debugger *dbg, const char *c_file_name, u32 line) {
+  time_command(Stats_Command::SET_BREAKPOINT);
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return nullptr;
@@ -317,8 +483,15 @@ Breakpoint *set_breakpoint(Debugger *dbg, const char *c_file_name, u32 line) {
 
   auto file_name = const_cast <char *>(c_file_name);
 
-  for (const auto &cu : dbg->dwarf.compilation_units()) {
-    const auto &lt = cu.get_line_table();
+  dbg->stats.dwarf_lookups++;
+  bool is_indexing_in_progress = is_indexing(dbg);
+
+  auto &units = dbg->dwarf.compilation_units();
+  For_Count (units.size(), unit_index) {
+    // Line tables of units not indexed yet are being parsed by the indexing threads
+    if (is_indexing_in_progress && !is_unit_indexed(dbg, unit_index))  continue;
+
+    const auto &lt = units[unit_index].get_line_table();
 
     for (const auto &line_entry : lt) {
       auto file = lt.get_file(line_entry.file_index);
@@ -336,10 +509,65 @@ Breakpoint *set_breakpoint(Debugger *dbg, const char *c_file_name, u32 line) {
     }
   }
 
+  if (is_indexing_in_progress) {
+    add_pending_breakpoint(dbg, nullptr, c_file_name, line);
+    return nullptr;
+  }
+
   dbg_fail("couldn't find specified source line");
   return nullptr;
 }
 
+/////////////////////////////////////
+//
+//  Pending breakpoints
+//
+
+void add_pending_breakpoint(Debugger *dbg, const char *function_declaration, const char *file_name, u32 line) {
+  Pending_Breakpoint pending;
+  if (function_declaration)  pending.function_declaration = strdup(function_declaration);
+  if (file_name)  pending.file_name = strdup(file_name);
+  pending.line = line;
+  dbg->pending_breakpoints.add(pending);
+
+  dbg_success();
+}
+
+// Every pending breakpoint is requested again, the ones still not found are queued back while indexing goes on
+bool resolve_pending_breakpoints(Debugger *dbg) {
+  timeline_zone("resolve pending breakpoints");
+
+  if (dbg->pending_breakpoints.count <= 0)  return false;
+
+  auto pending_breakpoints = dbg->pending_breakpoints;
+  dbg->pending_breakpoints = Array<Pending_Breakpoint>();
+
+  bool is_any_set = false;
+  For (pending_breakpoints) {
+    Breakpoint *bp;
+    if (it.function_declaration) {
+      bp = set_breakpoint(dbg, it.function_declaration);
+    } else {
+      bp = set_breakpoint(dbg, it.file_name, it.line);
+    }
+    if (bp)  is_any_set = true;
+
+    if (it.function_declaration)  free(it.function_declaration);
+    if (it.file_name)  free(it.file_name);
+  }
+  pending_breakpoints.deinit();
+
+  return is_any_set;
+}
+
+void free_pending_breakpoints(Debugger *dbg) {
+  For (dbg->pending_breakpoints) {
+    if (it.function_declaration)  free(it.function_declaration);
+    if (it.file_name)  free(it.file_name);
+  }
+  dbg->pending_breakpoints.deinit();
+}
+
 void print_breakpoints(Debugger * dbg) {
   u32 count = 0;
   For (dbg->breakpoints) {
@@ -350,10 +578,21 @@ void print_breakpoints(Debugger * dbg) {
     }
   }
 
+  For (dbg->pending_breakpoints) {
+    if (it.function_declaration) {
+      printf("Pending breakpoint at %s, waiting for debug info indexing\n", it.function_declaration);
+    } else {
+      printf("Pending breakpoint at %s:%u, waiting for debug info indexing\n", it.file_name, it.line);
+    }
+  }
+
   dbg_success();
 }
 
 void update_breakpoints(Debugger *dbg) {
+  timeline_zone("update breakpoints");
+
+  finish_indexing(dbg); // Line tables of all units are searched
   // Resetting breakpoint map, as breakpoint adresses as keys should be reinitialized
   Hash_Table<u64, Breakpoint *> updated_breakpoint_map;
   updated_breakpoint_map.init();
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-LIB_ARGS="-I/usr/local/include/libelfin -L/usr/local/lib -ldwarf++ -lelf++"
+LIB_ARGS="-I/usr/local/include/libelfin -L/usr/local/lib -ldwarf++ -lelf++ -lpthread"
 
 # Build target
 g++ -g targets/debugee.cpp -o debugee
@@ -29,10 +29,34 @@ if [ "$#" -ge 1 ] ; then
             g++ -g tests/test.cpp $LIB_ARGS -o test
             ;;
 
+        -index)
+            echo "Building debug index"
+            # Mode 4: Pre-generating debug index, so the first debugging session starts fast as well
+            g++ -g index_builder.cpp $LIB_ARGS -o index_builder
+            ./index_builder "${2:-debugee}"
+            ;;
+
+        -bench-structures)
+            echo "Building benchmarks"
+            # Mode 5: Benchmarking data structures against their previous versions
+            g++ -O2 tests/hash_table_benchmark.cpp -o hash_table_benchmark
+            ./hash_table_benchmark
+            g++ -O2 tests/array_benchmark.cpp -o array_benchmark
+            ./array_benchmark
+            ;;
+
+        -benchmark)
+            echo "Building debugger benchmark"
+            # Mode 6: Timing library operations on a synthetic program, results are also written to benchmark.csv
+            g++ -g targets/benchmark_debugee.cpp -o benchmark_debugee
+            g++ -O2 -g tests/benchmark.cpp $LIB_ARGS -o benchmark
+            ./benchmark benchmark_debugee benchmark.csv
+            ;;
+
         *)
             echo "ERROR: Unknown argument. Building nothing"
             ;;
         esac
 else
-    echo "ERROR: Specify version to build: -lib, -gui, -test"
+    echo "ERROR: Specify version to build: -lib, -gui, -test, -index [executable], -bench-structures, -benchmark"
 fi
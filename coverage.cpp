@@ -0,0 +1,357 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Line coverage
+//
+// Every statement address from the line table gets a one-shot int3. First hit
+// restores the original instruction for good, so the process runs at full speed
+// once all the code it executes is covered. No single stepping is required.
+//
+
+struct Coverage_Probe {
+  u64 address; // Address in the running process
+  u32 file_index;
+  u32 line;
+};
+
+struct Coverage_Probes {
+  Array<Coverage_Probe> probes; // Sorted by address, several lines could share one address
+
+  // Unique probe addresses for int3 injection
+  Array<u64> addresses;
+  Array<u8> saved_instructions;
+  Array<s32> first_probes; // Index of the first probe with the address
+  Array<bool> armed;
+};
+
+s32 compare_coverage_probes(const void *a, const void *b) {
+  auto first  = static_cast <const Coverage_Probe *>(a);
+  auto second = static_cast <const Coverage_Probe *>(b);
+  if (first->address < second->address)  return -1;
+  if (first->address > second->address)  return 1;
+  return 0;
+}
+
+struct Text_Range {
+  u64 low_pc;
+  u64 high_pc;
+};
+
+// DWARF addresses of executable sections of the program
+void collect_text_ranges(Debugger *dbg, Array<Text_Range> *ranges) {
+  for (auto &section : dbg->elf.sections()) {
+    auto &header = section.get_hdr();
+    if (((u64)header.flags & (u64)elf::shf::execinstr) == 0 || header.size == 0)  continue;
+
+    ranges->add((Text_Range){header.addr, header.addr + header.size});
+  }
+}
+
+inline bool is_in_text_ranges(Array<Text_Range> *ranges, u64 address) {
+  For (*ranges) {
+    if (address >= it.low_pc && address < it.high_pc)  return true;
+  }
+  return false;
+}
+
+void collect_coverage_probes(Debugger *dbg, Coverage *coverage, Coverage_Probes *result) {
+  Hash_Table<Interned_String, s32> file_indices;
+  file_indices.init();
+  defer { file_indices.deinit(); };
+
+  // Line table keeps sequences of functions dropped by the linker (discarded COMDAT copies, collected
+  // sections) at address 0, their probes would be written over the ELF header
+  Array<Text_Range> text_ranges;
+  text_ranges.init();
+  defer { text_ranges.deinit(); };
+  collect_text_ranges(dbg, &text_ranges);
+
+  finish_indexing(dbg); // Line tables of all units are read
+
+  for (const auto &cu : dbg->dwarf.compilation_units()) {
+    const auto &lt = cu.get_line_table();
+
+    // Neighbouring entries are mostly from the same file, so the path is interned only when the file changes
+    const dwarf::line_table::file *last_file = nullptr;
+    s32 file_index = -1;
+
+    for (const auto &line_entry : lt) {
+      if (!line_entry.is_stmt || line_entry.end_sequence || line_entry.line == 0)  continue;
+      if (!is_in_text_ranges(&text_ranges, line_entry.address))  continue;
+
+      if (line_entry.file != last_file) {
+        last_file = line_entry.file;
+
+        auto file_path = dbg->strings.intern(line_entry.file->path.c_str());
+
+        auto existing_index = file_indices[{file_path}];
+        if (existing_index) {
+          file_index = *existing_index;
+        } else {
+          Coverage_File file;
+          file.file_path = strdup(file_path);
+          file.lines.init();
+          coverage->files.add(file);
+
+          file_index = coverage->files.count - 1;
+          file_indices.insert({file_path}, file_index);
+        }
+      }
+
+      auto file = &coverage->files[file_index];
+      while (file->lines.count <= (s32)line_entry.line)  file->lines.add(Coverage_Line_State::NO_CODE);
+
+      if (file->lines[line_entry.line] == Coverage_Line_State::NO_CODE) {
+        file->lines[line_entry.line] = Coverage_Line_State::NOT_COVERED;
+        file->lines_found++;
+      }
+
+      result->probes.add((Coverage_Probe){offset_dwarf_address(dbg, line_entry.address), (u32)file_index, line_entry.line});
+    }
+  }
+
+  qsort(result->probes.data, result->probes.count, sizeof(Coverage_Probe), compare_coverage_probes);
+
+  For_Count (result->probes.count, i) {
+    auto address = result->probes[i].address;
+    if (result->addresses.count > 0 && result->addresses.back() == address)  continue;
+
+    result->addresses.add(address);
+    result->first_probes.add(i);
+    result->armed.add(true);
+  }
+}
+
+void mark_covered_lines(Coverage *coverage, Coverage_Probes *probes, s32 address_index) {
+  auto address = probes->addresses[address_index];
+
+  for (s32 i = probes->first_probes[address_index]; i < probes->probes.count && probes->probes[i].address == address; i++) {
+    auto probe = &probes->probes[i];
+    auto file = &coverage->files[probe->file_index];
+
+    if (file->lines[probe->line] != Coverage_Line_State::COVERED) {
+      file->lines[probe->line] = Coverage_Line_State::COVERED;
+      file->lines_hit++;
+    }
+  }
+}
+
+s32 find_probe_address(Coverage_Probes *probes, u64 address) {
+  s32 low = 0;
+  s32 high = probes->addresses.count - 1;
+
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    auto middle_address = probes->addresses.data[middle];
+
+    if (middle_address == address)  return middle;
+    if (middle_address < address) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+void collect_coverage(Debugger *dbg, float64 duration, Coverage *result) {
+  if (!result) {
+    dbg_fail("pointer to output coverage is null");
+    return;
+  }
+
+  deinit(result);
+  result->files.init();
+
+  if (dbg->state != Debugger_State::RUNNING) {
+    dbg_fail("debugged program isn't running");
+    return;
+  }
+
+  // Debugger is busy until the collection ends, so it's always limited in time
+  if (duration <= 0) {
+    dbg_fail("coverage collection duration should be positive");
+    return;
+  }
+
+  Coverage_Probes probes;
+  probes.probes.init();
+  probes.addresses.init();
+  probes.saved_instructions.init();
+  probes.first_probes.init();
+  probes.armed.init();
+  defer {
+    probes.probes.deinit();
+    probes.addresses.deinit();
+    probes.saved_instructions.deinit();
+    probes.first_probes.deinit();
+    probes.armed.deinit();
+  };
+
+  collect_coverage_probes(dbg, result, &probes);
+
+  if (probes.addresses.count <= 0) {
+    dbg_fail("line table has no statements to cover");
+    return;
+  }
+
+  // User breakpoints lifted, so probes could save original instructions
+  Small_Array<Breakpoint *, 16> lifted_breakpoints;
+  lifted_breakpoints.init();
+  defer { lifted_breakpoints.deinit(); };
+
+  lift_breakpoints(dbg, &lifted_breakpoints);
+
+  inject_int_instructions(dbg, &probes.addresses, &probes.saved_instructions);
+
+  result->probe_count = probes.addresses.count;
+
+  u64 start_time = get_monotonic_time_ns();
+  u64 end_time = start_time + (u64)(duration * 1000000000.0);
+
+  bool process_exited = false;
+  bool stop_requested = false;
+
+  end_stop(dbg);
+  debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+
+  while (true) {
+    s32 wait_status;
+    auto wait_result = debugee_waitpid(dbg, &wait_status, stop_requested ? 0 : WNOHANG);
+
+    if (wait_result == 0) {
+      if (get_monotonic_time_ns() >= end_time) {
+        kill(dbg->debugee_pid, SIGSTOP);
+        stop_requested = true;
+      } else {
+        timespec poll_interval = { 0, 1000000 }; // Hits become rare quickly, so polling could be slow
+        nanosleep(&poll_interval, nullptr);
+      }
+      continue;
+    }
+
+    if (wait_result == -1 || WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+      process_exited = true;
+      break;
+    }
+
+    if (!WIFSTOPPED(wait_status))  continue;
+
+    auto signal = WSTOPSIG(wait_status);
+    if (signal == SIGSTOP && stop_requested)  break;
+
+    if (signal == SIGTRAP) {
+      auto address = read_register(dbg, Register::rip) - 1;
+      auto address_index = find_probe_address(&probes, address);
+
+      if (address_index != -1 && probes.armed[address_index]) {
+        remove_injected_int_instruction(dbg, address, probes.saved_instructions[address_index]);
+        write_register(dbg, Register::rip, address);
+
+        probes.armed[address_index] = false;
+        result->probes_hit++;
+
+        mark_covered_lines(result, &probes, address_index);
+      }
+      signal = 0;
+    }
+
+    debugee_ptrace(dbg, PTRACE_CONT, nullptr, signal == SIGSTOP ? 0 : signal);
+  }
+
+  result->duration = (get_monotonic_time_ns() - start_time) / 1000000000.0;
+
+  if (process_exited) {
+    printf("Process exited during coverage collection\n");
+
+    if (dbg->autorestart_enabled) {
+      restart_or_finish_debug(dbg);
+    } else {
+      dbg->state = Debugger_State::LOADED;
+    }
+  } else {
+    // Removing probes which weren't hit, all at once
+    Array<u64> armed_addresses;
+    Array<u8> armed_saved_instructions;
+    armed_addresses.init();
+    armed_saved_instructions.init();
+    defer {
+      armed_addresses.deinit();
+      armed_saved_instructions.deinit();
+    };
+
+    For_Count (probes.addresses.count, i) {
+      if (!probes.armed[i])  continue;
+      armed_addresses.add(probes.addresses[i]);
+      armed_saved_instructions.add(probes.saved_instructions[i]);
+    }
+
+    remove_injected_int_instructions(dbg, &armed_addresses, &armed_saved_instructions);
+  }
+
+  restore_lifted_breakpoints(dbg, &lifted_breakpoints);
+  start_new_stop(dbg);
+
+  dbg_success();
+}
+
+void deinit(Coverage *coverage) {
+  For_Pointer (coverage->files) {
+    if (it->file_path)  free(it->file_path);
+    it->lines.deinit();
+  }
+  coverage->files.deinit();
+
+  coverage->duration = 0;
+  coverage->probe_count = 0;
+  coverage->probes_hit = 0;
+}
+
+Coverage_File *find_coverage_file(Coverage *coverage, const char *file_path) {
+  For_Pointer (coverage->files) {
+    if (strcmp(it->file_path, file_path) == 0)  return it;
+  }
+  return nullptr;
+}
+
+void print_coverage(Coverage *coverage) {
+  u64 lines_found = 0;
+  u64 lines_hit = 0;
+
+  For_Pointer (coverage->files) {
+    printf("%6.1f%% %6u/%-6u %s\n", it->lines_found ? 100.0 * it->lines_hit / it->lines_found : 0.0,
+           it->lines_hit, it->lines_found, it->file_path);
+    lines_found += it->lines_found;
+    lines_hit += it->lines_hit;
+  }
+
+  printf("Coverage: %lu of %lu lines (%.1f%%), %lu of %lu probes hit in %.3f s\n", lines_hit, lines_found,
+         lines_found ? 100.0 * lines_hit / lines_found : 0.0, coverage->probes_hit, coverage->probe_count, coverage->duration);
+}
+
+void export_lcov(Coverage *coverage, const char *file_path) {
+  auto f = fopen(file_path, "w");
+  if (!f) {
+    printf("Error: couldn't open file %s for writing\n", file_path);
+    return;
+  }
+  defer { fclose(f); };
+
+  // @Note: Probes are one-shot, so hit count is at most one for every line
+  fprintf(f, "TN:\n");
+  For_Pointer (coverage->files) {
+    fprintf(f, "SF:%s\n", it->file_path);
+
+    For_Count (it->lines.count, line) {
+      auto state = it->lines[line];
+      if (state == Coverage_Line_State::NO_CODE)  continue;
+      fprintf(f, "DA:%d,%d\n", line, state == Coverage_Line_State::COVERED ? 1 : 0);
+    }
+
+    fprintf(f, "LF:%u\nLH:%u\nend_of_record\n", it->lines_found, it->lines_hit);
+  }
+}
+
+DBG_NAMESPACE_END
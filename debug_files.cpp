@@ -0,0 +1,236 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Separate debug files
+//
+// Stripped binaries keep DWARF in a separate file, found by the build-id note
+// (<dir>/.build-id/ab/cdef...debug) or by the name in .gnu_debuglink section.
+// Files found by debuglink are linked into the local directory by build-id,
+// so the next session finds them with a single stat.
+//
+
+constexpr const char *system_debug_directory = "/usr/lib/debug";
+constexpr u32 build_id_note_type = 3; // NT_GNU_BUILD_ID
+
+inline bool has_section(const elf::elf &elf, const char *name) {
+  auto &section = elf.get_section(name);
+  return section.valid() && section.get_hdr().type != elf::sht::nobits;
+}
+
+// Returns lowercase hex string of the build-id, should be freed after the use
+char * get_build_id(const elf::elf &elf) {
+  for (auto &section : elf.sections()) {
+    if (section.get_hdr().type != elf::sht::note)  continue;
+
+    Data_Cursor cursor;
+    cursor.init(section.data(), section.size());
+
+    while (cursor.offset() + 12 <= section.size()) {
+      u32 name_size = cursor.read_u32();
+      u32 description_size = cursor.read_u32();
+      u32 type = cursor.read_u32();
+
+      auto name = reinterpret_cast <const char *>(cursor.pointer);
+      cursor.skip((name_size + 3) & ~3u);
+      auto description = cursor.pointer;
+      cursor.skip((description_size + 3) & ~3u);
+
+      if (type != build_id_note_type || name_size != 4 || strcmp(name, "GNU") != 0)  continue;
+
+      auto result = static_cast <char *>(malloc(description_size * 2 + 1));
+      For_Count (description_size, i)  sprintf(result + i * 2, "%02x", description[i]);
+      result[description_size * 2] = '\0';
+      return result;
+    }
+  }
+
+  return nullptr;
+}
+
+inline u32 update_crc32(u32 crc, const u8 *data, u64 size) {
+  static u32 table[256];
+  if (table[1] == 0) {
+    For_Count (256, i) {
+      u32 value = i;
+      For_Count (8, bit)  value = (value & 1) ? (0xedb88320 ^ (value >> 1)) : (value >> 1);
+      table[i] = value;
+    }
+  }
+
+  crc = ~crc;
+  for (u64 i = 0; i < size; i++)  crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// @Speed: Reads the whole file, only done when there is no build-id to compare
+bool check_file_crc32(const char *path, u32 expected_crc) {
+  auto fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)  return false;
+  defer { close(fd); };
+
+  u8 buffer[64 * 1024];
+  u32 crc = 0;
+  while (true) {
+    auto bytes_read = read(fd, buffer, sizeof(buffer));
+    if (bytes_read < 0)  return false;
+    if (bytes_read == 0)  break;
+    crc = update_crc32(crc, buffer, bytes_read);
+  }
+
+  return crc == expected_crc;
+}
+
+bool open_elf(const char *path, elf::elf *result) {
+  auto fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)  return false;
+
+  try {
+    *result = elf::elf(elf::create_mmap_loader(fd));
+  } catch (std::runtime_error ex) {
+    return false;
+  }
+
+  return true;
+}
+
+// Candidate is accepted when it has DWARF and belongs to the same build
+bool open_debug_file_candidate(const char *path, const char *build_id, const u32 *debuglink_crc, elf::elf *result) {
+  struct stat file_stat;
+  if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))  return false;
+
+  elf::elf candidate;
+  if (!open_elf(path, &candidate) || !has_section(candidate, ".debug_info"))  return false;
+
+  if (build_id) {
+    auto candidate_build_id = get_build_id(candidate);
+    defer { if (candidate_build_id)  free(candidate_build_id); };
+
+    if (!candidate_build_id || strcmp(candidate_build_id, build_id) != 0)  return false;
+  } else if (debuglink_crc && !check_file_crc32(path, *debuglink_crc)) {
+    return false;
+  }
+
+  *result = candidate;
+  return true;
+}
+
+inline void get_build_id_path(const char *directory, const char *build_id, char *path, u64 path_size) {
+  snprintf(path, path_size, "%s/.build-id/%.2s/%s.debug", directory, build_id, build_id + 2);
+}
+
+void make_directories(char *path) {
+  for (auto c = path + 1; *c; c++) {
+    if (*c != '/')  continue;
+
+    *c = '\0';
+    mkdir(path, 0755);
+    *c = '/';
+  }
+}
+
+void cache_debug_file(Debugger *dbg, const char *build_id, const char *debug_file_path) {
+  if (!dbg->debug_file_directory)  return;
+
+  char cache_path[PATH_MAX];
+  get_build_id_path(dbg->debug_file_directory, build_id, cache_path, sizeof(cache_path));
+  make_directories(cache_path);
+
+  unlink(cache_path); // Stale link to a file of an older build
+  if (symlink(debug_file_path, cache_path) != 0 && dbg->verbose) {
+    printf("Warning: couldn't cache debug file in %s\n", cache_path);
+  }
+}
+
+// Returns path of the file with DWARF, which is the file itself when it isn't stripped.
+// Path should be freed after the use, null is returned when nothing is found.
+char * find_debug_file(Debugger *dbg, const elf::elf &elf, const char *path, elf::elf *debug_elf) {
+  if (has_section(elf, ".debug_info")) {
+    *debug_elf = elf;
+    return strdup(path);
+  }
+
+  auto build_id = get_build_id(elf);
+  defer { if (build_id)  free(build_id); };
+
+  char candidate[PATH_MAX];
+
+  if (build_id && strlen(build_id) > 2) {
+    const char *directories[] = { dbg->debug_file_directory, system_debug_directory };
+    For_Count (2, i) {
+      if (!directories[i])  continue;
+
+      get_build_id_path(directories[i], build_id, candidate, sizeof(candidate));
+      if (open_debug_file_candidate(candidate, build_id, nullptr, debug_elf))  return realpath(candidate, nullptr);
+    }
+  }
+
+  auto &debuglink = elf.get_section(".gnu_debuglink");
+  if (!debuglink.valid())  return nullptr;
+
+  // Section holds the file name, padded to 4 bytes, and CRC32 of the file
+  auto debuglink_name = static_cast <const char *>(debuglink.data());
+  auto crc_offset = (strnlen(debuglink_name, debuglink.size()) + 4) & ~(u64)3;
+  if (crc_offset + sizeof(u32) > debuglink.size())  return nullptr;
+
+  u32 debuglink_crc;
+  memcpy(&debuglink_crc, debuglink_name + crc_offset, sizeof(u32));
+
+  char directory[PATH_MAX];
+  snprintf(directory, sizeof(directory), "%s", path);
+  auto slash = strrchr(directory, '/');
+  if (slash)  *slash = '\0';
+
+  auto try_candidate = [&]() -> char * {
+    if (strcmp(candidate, path) == 0)  return nullptr; // Debuglink could name the stripped file itself
+    if (!open_debug_file_candidate(candidate, build_id, &debuglink_crc, debug_elf))  return nullptr;
+
+    auto result = realpath(candidate, nullptr);
+    if (build_id && result)  cache_debug_file(dbg, build_id, result);
+    return result;
+  };
+
+  // Same places as gdb looks in, then the local directory
+  char *result;
+  snprintf(candidate, sizeof(candidate), "%s/%s", directory, debuglink_name);
+  if ((result = try_candidate()))  return result;
+
+  snprintf(candidate, sizeof(candidate), "%s/.debug/%s", directory, debuglink_name);
+  if ((result = try_candidate()))  return result;
+
+  snprintf(candidate, sizeof(candidate), "%s%s/%s", system_debug_directory, directory, debuglink_name);
+  if ((result = try_candidate()))  return result;
+
+  if (dbg->debug_file_directory) {
+    snprintf(candidate, sizeof(candidate), "%s/%s", dbg->debug_file_directory, debuglink_name);
+    if ((result = try_candidate()))  return result;
+  }
+
+  return nullptr;
+}
+
+void set_debug_file_directory(Debugger *dbg, const char *path) {
+  if (dbg->debug_file_directory)  free(dbg->debug_file_directory);
+  dbg->debug_file_directory = path ? strdup(path) : nullptr;
+  dbg_success();
+}
+
+// SIMPDB_DEBUG_DIR or ~/.cache/simpdb/debug
+void set_default_debug_file_directory(Debugger *dbg) {
+  if (dbg->debug_file_directory)  return;
+
+  auto environment_directory = getenv("SIMPDB_DEBUG_DIR");
+  if (environment_directory) {
+    dbg->debug_file_directory = strdup(environment_directory);
+    return;
+  }
+
+  auto home = getenv("HOME");
+  if (!home)  return;
+
+  char directory[PATH_MAX];
+  snprintf(directory, sizeof(directory), "%s/.cache/simpdb/debug", home);
+  dbg->debug_file_directory = strdup(directory);
+}
+
+DBG_NAMESPACE_END
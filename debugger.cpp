@@ -1,10 +1,27 @@
 #include "debugger_internal.h"
 
+#include "Allocator.cpp"
 #include "Hash_Table.cpp"
+#include "String_Pool.cpp"
+#include "Timeline.cpp"
+#include "stats.cpp"
 #include "declaration_parser.cpp"
 #include "breakpoint.cpp"
+#include "unwind.cpp"
+#include "profiler.cpp"
+#include "tracer.cpp"
+#include "coverage.cpp"
+#include "types.cpp"
+#include "location.cpp"
+#include "watch.cpp"
+#include "memory_map.cpp"
+#include "debug_files.cpp"
+#include "index.cpp"
+#include "indexer.cpp"
+#include "modules.cpp"
+#include "launch.cpp"
+#include "fork_server.cpp"
 
-#include <system_error>
 
 // Plan: Write out debugging lib, which can be used in ImGui graphical program
 // * Rename debugee to traced_process or something
@@ -23,6 +40,10 @@ void init(Debugger * dbg) {
   if (dbg) {
     dbg->breakpoints.init();
     dbg->breakpoint_map.init();
+    dbg->strings.init();
+    reset_stats(dbg);
+
+    set_default_debug_file_directory(dbg);
 
     dbg->mode = Debug_Mode::NONE;
     dbg->state = Debugger_State::NOT_LOADED;
@@ -35,11 +56,36 @@ void deinit(Debugger * dbg) {
   //        initialization functions. They excluded from the state machine.
   if (dbg) {
     if (dbg->executable_path)  free(dbg->executable_path);
-    if (dbg->argument_string)  free(dbg->argument_string);
+    stop_fork_server(dbg);
+    free_launch_options(&dbg->launch_options);
+    close_pty(dbg);
+    if (dbg->debug_file_path)  free(dbg->debug_file_path);
+    if (dbg->debug_file_directory)  free(dbg->debug_file_directory);
+
+    free_indexing(dbg);
+    free_pending_breakpoints(dbg);
 
     dbg->breakpoints.deinit();
     dbg->breakpoint_map.deinit();
 
+    free_unwind_table(dbg);
+    free_type_table(dbg);
+    free_locals_cache(dbg);
+    free_memory_cache(dbg);
+    free_modules(dbg);
+    deinit(&dbg->memory_map);
+    dbg->function_index.deinit();
+    dbg->function_names.deinit();
+    free_debug_index(dbg);
+
+    dbg->strings.deinit();
+    dbg->free_breakpoints.deinit();
+    dbg->session_arena.deinit();
+    dbg->stop_arena.deinit();
+    if (dbg->demangle_buffer)  free(dbg->demangle_buffer);
+    dbg->demangle_buffer = nullptr;
+    dbg->demangle_buffer_size = 0;
+
     dbg->state = Debugger_State::NOT_LOADED;
     dbg->last_command_status = dbg::Command_Status::NO_STATUS;
   }
@@ -89,56 +135,46 @@ const Register_Descriptor global_register_descriptors[registers_count] = {
   { Register::gs,       55, (char *)"gs"       },
 };
 
-u64 read_register(pid_t pid, Register r) {
+u64 read_register(Debugger *dbg, Register r) {
+  if (dbg->state == Debugger_State::NOT_LOADED) {
+    dbg_fail("debugged program isn't loaded");
+    return 0;
+  }
+
   if (r == Register::UNKNOWN)  assert(false && "Attempt to read from UNKNOWN register");
 
   user_regs_struct regs;
   // @Hack: We're get to kernel reading each register. Maybe it needs some caching or
   //        an option to read batch of registers with one ptrace call
-  ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+  debugee_ptrace(dbg, PTRACE_GETREGS, nullptr, &regs);
 
+  dbg_success();
   return *(reinterpret_cast<u64 *> (&regs) + (u64)r);
 }
 
-u64 pid_read_register(pid_t pid, Register r) {
-  return read_register(pid, r);
-}
-
-u64 read_register(Debugger *dbg, Register r) {
+void write_register(Debugger *dbg, Register r, u64 value) {
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
-    return 0;
+    return;
   }
 
-  dbg_success();
-  return read_register(dbg->debugee_pid, r);
-}
-
-void write_register(pid_t pid, Register r, u64 value) {
   if (r == Register::UNKNOWN)  assert(false && "Attempt to write to UNKNOWN register");
 
   user_regs_struct regs;
   // @Hack: We're get to kernel reading each register. Maybe it needs some caching or
   //        an option to read batch of registers with one ptrace call
-  ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+  debugee_ptrace(dbg, PTRACE_GETREGS, nullptr, &regs);
 
   *(reinterpret_cast<u64 *> (&regs) + (u64)r) = value;
 
-  ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
-}
-
-void write_register(Debugger *dbg, Register r, u64 value) {
-  if (dbg->state == Debugger_State::NOT_LOADED) {
-    dbg_fail("debugged program isn't loaded");
-    return;
-  }
-
-  write_register(dbg->debugee_pid, r, value);
+  debugee_ptrace(dbg, PTRACE_SETREGS, nullptr, &regs);
 
   dbg_success();
 }
 
 void get_registers(Debugger * dbg, Array<u64> * register_values_pointer) {
+  timeline_zone("get registers");
+
   if (!register_values_pointer) {
     dbg_fail("pointer to output array is null");
     return;
@@ -149,7 +185,7 @@ void get_registers(Debugger * dbg, Array<u64> * register_values_pointer) {
   register_values.reset();
 
   user_regs_struct regs;
-  ptrace(PTRACE_GETREGS, dbg->debugee_pid, nullptr, &regs);
+  debugee_ptrace(dbg, PTRACE_GETREGS, nullptr, &regs);
 
   For_Count ((s32)Register::UNKNOWN, r) {
     auto value = *(reinterpret_cast<u64 *> (&regs) + (u64)r);
@@ -165,7 +201,7 @@ inline void set_pc(Debugger *dbg, u64 pc) {
   write_register(dbg, Register::rip, pc);
 }
 
-u64 read_dwarf_register(pid_t pid, u32 register_number) {
+u64 read_dwarf_register(Debugger *dbg, u32 register_number) {
   const Register_Descriptor *match = nullptr;
   For_Count (registers_count, i) {
     if (global_register_descriptors[i].dwarf_r == register_number)  match = &(global_register_descriptors[i]);
@@ -175,17 +211,40 @@ u64 read_dwarf_register(pid_t pid, u32 register_number) {
     fprintf(stderr, "ERROR: Unknown dwarf register\n");
   }
 
-  return pid_read_register(pid, match->r);
+  return read_register(dbg, match->r);
 }
 
-u64 read_dwarf_register(Debugger *dbg, u32 register_number) {
-  return read_dwarf_register(dbg->debugee_pid, register_number);
+bool dwarf_register_to_register(u32 dwarf_register, Register *result) {
+  For_Count (registers_count, i) {
+    if (global_register_descriptors[i].dwarf_r == (s32)dwarf_register) {
+      *result = global_register_descriptors[i].r;
+      return true;
+    }
+  }
+  return false;
 }
 
 inline char * register_to_string(Register reg) {
   return global_register_descriptors[(u32)reg].name;
 }
 
+void get_unwind_registers(Debugger *dbg, Unwind_Registers *registers) {
+  user_regs_struct regs;
+  debugee_ptrace(dbg, PTRACE_GETREGS, nullptr, &regs);
+
+  *registers = {};
+  For_Count (registers_count, i) {
+    auto &descriptor = global_register_descriptors[i];
+    if (descriptor.dwarf_r >= 0 && descriptor.dwarf_r < (s32)unwind_registers_count) {
+      registers->values[descriptor.dwarf_r] = *(reinterpret_cast<u64 *> (&regs) + (u64)descriptor.r);
+      registers->valid_mask |= (1 << descriptor.dwarf_r);
+    }
+  }
+
+  registers->values[unwind_return_address_register] = regs.rip;
+  registers->valid_mask |= (1 << unwind_return_address_register);
+}
+
 
 //
 //  Registers
@@ -197,7 +256,8 @@ inline char * register_to_string(Register reg) {
 //          OR use /proc/<pid>/mem instead ptrace (compare options' performance and portability to other systems)
 u64 read_memory(Debugger *dbg, u64 address) {
   if (dbg->state != Debugger_State::NOT_LOADED) {
-    return ptrace(PTRACE_PEEKDATA, dbg->debugee_pid, address, nullptr);
+    dbg->stats.bytes_read += sizeof(u64);
+    return debugee_ptrace(dbg, PTRACE_PEEKDATA, address, nullptr);
   } else {
     dbg_fail("debugged program isn't loaded");
     return 0;
@@ -206,15 +266,187 @@ u64 read_memory(Debugger *dbg, u64 address) {
 
 void write_memory(Debugger *dbg, u64 address, u64 value) {
   if (dbg->state != Debugger_State::NOT_LOADED) {
-    ptrace(PTRACE_POKEDATA, dbg->debugee_pid, address, value);
+    debugee_ptrace(dbg, PTRACE_POKEDATA, address, value);
+    dbg->stats.bytes_written += sizeof(u64);
+    invalidate_memory_cache(dbg);
   } else {
     dbg_fail("debugged program isn't loaded");
   }
 }
 
+bool read_memory(Debugger *dbg, u64 address, void *buffer, u64 size) {
+  timeline_zone("read memory");
+
+  if (dbg->state == Debugger_State::NOT_LOADED) {
+    dbg_fail("debugged program isn't loaded");
+    return false;
+  }
+
+  iovec local_buffer = { buffer, size };
+  iovec remote_buffer = { reinterpret_cast <void *>(address), size };
+
+  auto bytes_read = debugee_read_memory(dbg, &local_buffer, &remote_buffer, 1);
+  if (bytes_read == (ssize_t)size)  return true;
+
+  // process_vm_readv reads nothing across an unmapped page and could be forbidden
+  // by security policy, so falling back to reading word by word
+  u64 offset = bytes_read > 0 ? bytes_read : 0;
+  auto destination = static_cast <u8 *>(buffer);
+
+  while (offset < size) {
+    errno = 0;
+    u64 word = debugee_ptrace(dbg, PTRACE_PEEKDATA, address + offset, nullptr);
+    if (errno != 0) {
+      memset(destination + offset, 0, size - offset);
+      return false;
+    }
+
+    auto chunk_size = (size - offset < sizeof(u64)) ? size - offset : sizeof(u64);
+    memcpy(destination + offset, &word, chunk_size);
+    offset += chunk_size;
+    dbg->stats.bytes_read += chunk_size;
+  }
+
+  return true;
+}
+
+// Pages of the stopped process are read once per stop, so many small reads of
+// neighbouring values (watches, struct members) cost one syscall per page.
+// Cache is direct-mapped, and is invalidated in O(1) by bumping its generation.
+constexpr u64 memory_cache_page_size = 4096;
+constexpr u32 memory_cache_page_count = 64;
+
+struct Memory_Cache_Page {
+  u64 address;
+  u64 generation; // Contents are valid only if equal to the cache generation
+  bool is_readable;
+  u8 data[memory_cache_page_size];
+};
+
+struct Memory_Cache {
+  u64 generation;
+  Memory_Cache_Page pages[memory_cache_page_count]; // Indexed by page number modulo page count
+};
+
+void invalidate_memory_cache(Debugger *dbg) {
+  if (dbg->memory_cache)  dbg->memory_cache->generation++;
+}
+
+void free_memory_cache(Debugger *dbg) {
+  if (dbg->memory_cache)  free(dbg->memory_cache);
+  dbg->memory_cache = nullptr;
+}
+
+bool read_cached_memory(Debugger *dbg, u64 address, void *buffer, u64 size) {
+  if (dbg->state == Debugger_State::NOT_LOADED) {
+    dbg_fail("debugged program isn't loaded");
+    return false;
+  }
+
+  if (!dbg->memory_cache) {
+    dbg->memory_cache = static_cast <Memory_Cache *>(calloc(1, sizeof(Memory_Cache)));
+    dbg->memory_cache->generation = 1;
+  }
+
+  auto cache = dbg->memory_cache;
+  auto destination = static_cast <u8 *>(buffer);
+  bool result = true;
+
+  while (size > 0) {
+    auto page_address = address & ~(memory_cache_page_size - 1);
+    auto page = &cache->pages[(page_address / memory_cache_page_size) % memory_cache_page_count];
+
+    bool is_cached = (page->generation == cache->generation && page->address == page_address);
+    count_cache_access(dbg, Stats_Cache::MEMORY, is_cached);
+
+    if (!is_cached) {
+      page->address = page_address;
+      page->generation = cache->generation;
+      page->is_readable = is_address_readable(dbg, page_address, memory_cache_page_size) &&
+                          read_memory(dbg, page_address, page->data, memory_cache_page_size);
+    }
+
+    auto offset = address - page_address;
+    auto chunk_size = (size < memory_cache_page_size - offset) ? size : memory_cache_page_size - offset;
+
+    if (page->is_readable) {
+      memcpy(destination, page->data + offset, chunk_size);
+    } else {
+      memset(destination, 0, chunk_size);
+      result = false;
+    }
+
+    destination += chunk_size;
+    address += chunk_size;
+    size -= chunk_size;
+  }
+
+  return result;
+}
+
+// Called whenever the process stops after running, as all the state read before is stale
+void start_new_stop(Debugger *dbg) {
+  dbg->stop_count++;
+  invalidate_memory_cache(dbg);
+
+  dbg->stop_heap_allocations = heap_allocations;
+}
+
+// Called before the process resumes. Results of queries allocated by the stop arena are released.
+void end_stop(Debugger *dbg) {
+  auto stats = &dbg->last_stop_allocations;
+  stats->heap_count = heap_allocations.count - dbg->stop_heap_allocations.count;
+  stats->heap_bytes = heap_allocations.bytes - dbg->stop_heap_allocations.bytes;
+  stats->arena_count = dbg->stop_arena.allocation_count;
+  stats->arena_bytes = dbg->stop_arena.allocated_bytes;
+
+  dbg->stop_arena.reset();
+  dbg->stop_heap_allocations = heap_allocations;
+}
+
+Allocator get_stop_allocator(Debugger *dbg) {
+  return get_allocator(&dbg->stop_arena);
+}
+
+void print_allocation_stats(Debugger *dbg) {
+  auto last = &dbg->last_stop_allocations;
+  printf("Allocations of the last stop: %lu heap (%lu bytes), %lu stop arena (%lu bytes)\n",
+         last->heap_count, last->heap_bytes, last->arena_count, last->arena_bytes);
+
+  printf("Allocations of the current stop: %lu heap (%lu bytes), %lu stop arena (%lu bytes)\n",
+         heap_allocations.count - dbg->stop_heap_allocations.count, heap_allocations.bytes - dbg->stop_heap_allocations.bytes,
+         dbg->stop_arena.allocation_count, dbg->stop_arena.allocated_bytes);
+
+  printf("Session arena: %lu allocations (%lu bytes), %lu bytes reserved\n",
+         dbg->session_arena.allocation_count, dbg->session_arena.allocated_bytes, dbg->session_arena.get_reserved_size());
+}
+
+// Output arrays of queries are reused, unless they are given an allocator. Arrays of an arena
+// aren't touched, as the arena could have been reset since they were filled: deinit doesn't free them.
+template <typename T>
+void reset_output_array(Array<T> *array, Allocator allocator) {
+  if (allocator.is_heap() && array->allocator.is_heap()) {
+    array->reset();
+    return;
+  }
+
+  array->deinit();
+  array->allocator = allocator;
+  array->init();
+}
+
+// Contents of variables allocated by an arena are freed with it
+void free_variables_data(Array<Variable> *variables) {
+  if (!variables->allocator.is_heap())  return;
+
+  For (*variables) {
+    if (it.data)  free(it.data);
+  }
+}
+
 siginfo_t get_signal_info(Debugger *dbg) {
   siginfo_t info;
-  ptrace(PTRACE_GETSIGINFO, dbg->debugee_pid, nullptr, &info);
+  debugee_ptrace(dbg, PTRACE_GETSIGINFO, nullptr, &info);
   return info;
 }
 
@@ -231,11 +463,20 @@ u64 get_offset_pc(Debugger *dbg) {
 }
 
 void handle_sigtrap(Debugger *dbg, siginfo_t info) {
+  timeline_zone("handle sigtrap");
+
   switch (info.si_code) {
   case SI_KERNEL:
   case TRAP_BRKPT: {
     set_pc(dbg, get_pc(dbg) - 1);
     auto current_pc = get_pc(dbg);
+
+    // Dynamic linker reports changes of the library list, not a user's stop
+    if (current_pc == dbg->modules.rendezvous_address) {
+      handle_rendezvous(dbg);
+      return;
+    }
+
     printf("Hit breakpoint at adress 0x%lx\n", current_pc);
     if (dbg->verbose) {
       try {
@@ -258,46 +499,28 @@ void handle_sigtrap(Debugger *dbg, siginfo_t info) {
 }
 
 s32 initialize_load_address(Debugger * dbg) {
+  timeline_zone("initialize load address");
+
   // If dynamic library was loaded
   if (dbg->elf.get_hdr().type == elf::et::dyn) {
-    char proc_map_path[64];
-    sprintf(proc_map_path, "/proc/%d/maps", dbg->debugee_pid);
+    refresh_memory_map(dbg);
 
-    FILE * fp = fopen(proc_map_path, "r");
-    FILE * fp_get_size = fopen(proc_map_path, "r");
-    defer { fclose(fp); fclose(fp_get_size); };
-
-    if (!fp || !fp_get_size) {
-      if (dbg->verbose)  printf("Error: cannot open /proc/%d/maps\n", dbg->debugee_pid);
+    if (dbg->memory_map.regions.count <= 0) {
+      if (dbg->verbose)  printf("Error: cannot read /proc/%d/maps\n", dbg->debugee_pid);
       return 1;
     }
 
-    u64 start_addr, end_addr;
-    auto executable_path_len = strlen(dbg->executable_path);
-    char *file_path = nullptr;
-    while (!feof(fp)) {
-      u32 path_length = 0;
-      fscanf(fp_get_size, "%*s %*s %*s %*s %*s %*s%n\n", &path_length);
-
-      file_path = static_cast <char *>(malloc(path_length + 1)); // @Speed: Meh... write something better without mallocing within a loop
-      fscanf(fp, "%lx-%lx %*s %*s %*s %*s %s\n", &start_addr, &end_addr, file_path);
-
-      if (strncmp(file_path, dbg->executable_path, executable_path_len) == 0)  break;
-
-      free(file_path);
-      file_path = nullptr;
-    }
-
-    if (!file_path) {
-      printf("Error: Couldn't find load address of file: %s\n", dbg->executable_path);
-      assert(false);
-    } else {
-      free(file_path);
+    // Load address is the start of the file mapping at offset zero
+    For_Pointer (dbg->memory_map.regions) {
+      if (it->offset == 0 && it->path && strcmp(it->path, dbg->executable_path) == 0) {
+        dbg->load_address = it->start;
+        return 0;
+      }
     }
 
-    dbg->load_address = start_addr;
-
-    return 0;
+    printf("Error: Couldn't find load address of file: %s\n", dbg->executable_path);
+    assert(false);
+    return 1;
   } else {
     if (dbg->verbose)  printf("Error: Expected executable loaded as dynamical library\n");
     return 2;
@@ -310,6 +533,14 @@ s32 initialize_load_address(Debugger * dbg) {
 //
 
 s32 load_debug_info(Debugger *dbg) {
+  timeline_zone("load debug info");
+
+  free_indexing(dbg); // Threads of an earlier load read the DWARF being replaced
+
+  dbg->load_timings = {};
+  auto timings = &dbg->load_timings;
+  u64 phase_start = get_monotonic_time_ns();
+
   auto fd = open(dbg->executable_path, O_RDONLY);
 
   if (fd == -1) {
@@ -327,8 +558,23 @@ s32 load_debug_info(Debugger *dbg) {
     return 2;
   }
 
+  timings->elf = end_load_phase(&phase_start);
+
+  // Stripped executables have DWARF in a separate file
+  dbg->debug_file_path = find_debug_file(dbg, dbg->elf, dbg->executable_path, &dbg->debug_elf);
+  if (!dbg->debug_file_path) {
+    if (dbg->verbose)  printf("Error: Couldn't find debug info of %s\n", dbg->executable_path);
+    return 3;
+  }
+
+  if (dbg->verbose && strcmp(dbg->debug_file_path, dbg->executable_path) != 0) {
+    printf("Reading debug info from %s\n", dbg->debug_file_path);
+  }
+
+  timings->debug_file = end_load_phase(&phase_start);
+
   try {
-    dbg->dwarf = dwarf::dwarf(dwarf::elf::create_loader(dbg->elf));
+    dbg->dwarf = dwarf::dwarf(dwarf::elf::create_loader(dbg->debug_elf));
   } catch (elf::format_error ex) {
     if (dbg->verbose)  printf("Error: Couldn't load debug info from file: %s\n", ex.what());
     return 3;
@@ -337,10 +583,22 @@ s32 load_debug_info(Debugger *dbg) {
     return 3;
   }
 
+  timings->dwarf = end_load_phase(&phase_start);
+
+  load_debug_index(dbg);
+
+  timings->debug_index = end_load_phase(&phase_start);
+
+  if (!dbg->debug_index)  start_indexing(dbg);
+
   return 0;
 }
 
 dwarf::die get_function_from_pc(Debugger *dbg, u64 pc) {
+  timeline_zone("find function by pc");
+
+  dbg->stats.dwarf_lookups++;
+
   for (auto &cu : dbg->dwarf.compilation_units()) {
     if (dwarf::die_pc_range(cu.root()).contains(pc)) {
       for (const auto &die : cu.root()) {
@@ -358,9 +616,43 @@ dwarf::die get_function_from_pc(Debugger *dbg, u64 pc) {
   return dwarf::die();
 }
 
+s32 compare_function_ranges(const void *a, const void *b) {
+  auto first  = static_cast <const Function_Range *>(a);
+  auto second = static_cast <const Function_Range *>(b);
+  if (first->low_pc < second->low_pc)  return -1;
+  if (first->low_pc > second->low_pc)  return 1;
+  return 0;
+}
+
+// Without the debug index functions are taken from the background indexing, see finish_indexing
+void build_function_index(Debugger *dbg) {
+  timeline_zone("build function index");
+
+  dbg->function_index.reset();
+  if (dbg->debug_index)  load_function_index_from_index(dbg);
+}
+
+// Binary search over sorted function ranges. Much cheaper than walking DIEs
+// with get_function_from_pc, when only function name and bounds are needed.
+Function_Range * find_function_range(Debugger *dbg, u64 pc) {
+  dbg->stats.dwarf_lookups++;
+
+  if (is_indexing(dbg))  return find_unit_function_range(dbg, pc);
+
+  if (dbg->function_index.count < 0)  build_function_index(dbg);
+  return search_function_ranges(&dbg->function_index, pc);
+}
+
 dwarf::line_table::iterator get_line_entry_from_pc(Debugger *dbg, u64 pc) {
+  timeline_zone("find line by pc");
+
+  dbg->stats.dwarf_lookups++;
+
+  u32 unit_index = 0;
   for (auto &cu : dbg->dwarf.compilation_units()) {
     if (dwarf::die_pc_range(cu.root()).contains(pc)) {
+      wait_for_unit(dbg, unit_index);
+
       auto &lt = cu.get_line_table();
       auto it = lt.find_address(pc); // @Bug: libelfin unable to find end line of template function for some reason
       if (it == lt.end()) {
@@ -371,6 +663,7 @@ dwarf::line_table::iterator get_line_entry_from_pc(Debugger *dbg, u64 pc) {
         return it;
       }
     }
+    unit_index++;
   }
 
   dbg->last_command_status = Command_Status::FAIL;
@@ -380,9 +673,12 @@ dwarf::line_table::iterator get_line_entry_from_pc(Debugger *dbg, u64 pc) {
 void restart_or_finish_debug(Debugger *dbg);
 
 void wait_for_signal(Debugger * dbg) {
+  timeline_zone("wait for signal");
+
   s32 wait_status;
   s32 options = 0;
-  waitpid(dbg->debugee_pid, &wait_status, options);
+  debugee_waitpid(dbg, &wait_status, options);
+  start_new_stop(dbg);
 
   auto siginfo = get_signal_info(dbg);
 
@@ -402,6 +698,7 @@ void wait_for_signal(Debugger * dbg) {
 
     // If process terminated, halt the debugging session
     if (dbg->autorestart_enabled) {
+      if (WIFSTOPPED(wait_status))  kill_child_debugee(dbg);
       restart_or_finish_debug(dbg);
     } else {
       dbg->state == Debugger_State::LOADED;
@@ -413,63 +710,66 @@ void wait_for_signal(Debugger * dbg) {
 void load_sources(Debugger * dbg);
 void unload_sources(Debugger * dbg);
 
-// TODO: Handle arguments
 void debug(Debugger * dbg, const char * executable_path, const char * arguments) {
+  Launch_Options options;
+  options.arguments = arguments;
+  debug(dbg, executable_path, options);
+}
+
+void debug(Debugger * dbg, const char * executable_path, Launch_Options options) {
+  time_command(Stats_Command::DEBUG);
+
   if (dbg->state != Debugger_State::NOT_LOADED) {
     dbg_fail("could start debugging session only of NOT_LOADED process");
     return;
   }
 
-  auto pid = fork();
-
-  if (pid == 0) {
-    personality(ADDR_NO_RANDOMIZE);
-
-    ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
-    execl(executable_path, executable_path, nullptr);
-  } else if (pid >= 1) {
-    dbg->debugee_pid = pid;
+  // @Note: The program is executed by the full path, as it could be started in another working directory
+  if (dbg->executable_path)  free(dbg->executable_path);
+  dbg->executable_path = realpath(executable_path, nullptr);
+  if (!dbg->executable_path) {
+    dbg_fail("executable file isn't found");
+    return;
+  }
 
-    // @Note: realpath here resolves to the parent process aka tracer
-    // char exe_link[64];
-    // sprintf(exe_link, "/proc/%d/exe", dbg->debugee_pid);
-    // dbg->executable_path = realpath(exe_link, nullptr);
+  set_launch_options(dbg, &options);
+  close_pty(dbg); // New session gets a new terminal
 
-    // @Note: but this one pointing to the original file
-    dbg->executable_path = realpath(executable_path, nullptr);
+  auto pid = launch_program(dbg);
+  if (!pid)  return;
 
-    if (arguments) {
-      dbg->argument_string = strdup(arguments);
-    }
+  dbg->debugee_pid = pid;
 
-    s32 fail = load_debug_info(dbg);
-    if (fail) {
-      dbg->last_command_status = Command_Status::FAIL;
-      return;
-    }
+  s32 fail = load_debug_info(dbg);
+  if (fail) {
+    dbg->last_command_status = Command_Status::FAIL;
+    return;
+  }
 
-    wait_for_signal(dbg);
+  wait_for_signal(dbg);
 
-    fail = initialize_load_address(dbg);
+  fail = initialize_load_address(dbg);
 
-    load_sources(dbg);
+  load_sources(dbg);
 
-    if (!fail) {
-      dbg->mode = Debug_Mode::DEBUG_CHILD;
-      dbg->state = Debugger_State::LOADED;
-      dbg_success();
-    }
+  if (!fail) {
+    dbg->mode = Debug_Mode::DEBUG_CHILD;
+    dbg->state = Debugger_State::LOADED;
+    initialize_modules(dbg);
+    dbg_success();
   }
 }
 
 void attach(Debugger * dbg, u32 pid) {
+  time_command(Stats_Command::ATTACH);
+
   if (dbg->state != Debugger_State::NOT_LOADED) {
     dbg_fail("could start debugging session only of NOT_LOADED process");
     return;
   }
 
   dbg->debugee_pid = pid;
-  ptrace(PTRACE_ATTACH, pid, nullptr, nullptr);
+  debugee_ptrace(dbg, PTRACE_ATTACH, nullptr, nullptr);
 
   char exe_link[64];
   sprintf(exe_link, "/proc/%d/exe", pid);
@@ -491,13 +791,18 @@ void attach(Debugger * dbg, u32 pid) {
   if (!fail) {
     dbg->mode = Debug_Mode::ATTACH;
     dbg->state = Debugger_State::LOADED;
+    initialize_modules(dbg);
     dbg_success();
   }
 }
 
 void detach(Debugger * dbg) {
   if (dbg->state == Debugger_State::RUNNING && dbg->mode == Debug_Mode::ATTACH) {
-    ptrace(PTRACE_DETACH, dbg->debugee_pid, nullptr, nullptr);
+    auto rendezvous_breakpoint = dbg->modules.rendezvous_breakpoint;
+    if (rendezvous_breakpoint && rendezvous_breakpoint->enabled)  disable_breakpoint(dbg, rendezvous_breakpoint);
+
+    end_stop(dbg);
+    debugee_ptrace(dbg, PTRACE_DETACH, nullptr, nullptr);
 
     dbg->state = Debugger_State::LOADED;
     dbg_success();
@@ -507,17 +812,40 @@ void detach(Debugger * dbg) {
 }
 
 void unload(Debugger * dbg) {
+  timeline_zone("unload");
+
   if (dbg->state == Debugger_State::LOADED) {
+    stop_fork_server(dbg);
+    free_indexing(dbg);
     unload_sources(dbg);
 
+    free_unwind_table(dbg);
+    free_type_table(dbg);
+    free_locals_cache(dbg);
+    free_memory_cache(dbg);
+    free_modules(dbg);
+    deinit(&dbg->memory_map);
+    dbg->function_index.deinit();
+    dbg->function_names.deinit();
+    free_debug_index(dbg);
+
     dbg->dwarf.~dwarf();
+    dbg->debug_elf.~elf();
     dbg->elf.~elf();
 
+    if (dbg->debug_file_path)  free(dbg->debug_file_path);
+    dbg->debug_file_path = nullptr;
+
     For (dbg->breakpoints) {
       remove_breakpoint(dbg, it);
     }
     dbg->breakpoint_map.deinit();
     dbg->breakpoints.deinit();
+    free_pending_breakpoints(dbg);
+
+    // Types, local variables and breakpoints of the executable
+    dbg->free_breakpoints.reset();
+    dbg->session_arena.reset();
 
     dbg->state = Debugger_State::NOT_LOADED;
     dbg_success();
@@ -527,6 +855,8 @@ void unload(Debugger * dbg) {
 }
 
 void start(Debugger *dbg) {
+  timeline_zone("start");
+
   if (dbg->state == Debugger_State::LOADED) {
     dbg->state = Debugger_State::RUNNING;
 
@@ -540,30 +870,33 @@ void start(Debugger *dbg) {
 }
 
 void restart_or_finish_debug(Debugger *dbg) {
+  timeline_zone("restart or finish");
+
   switch (dbg->mode) {
   case Debug_Mode::DEBUG_CHILD: {
-    auto pid = fork();
+    // Falling back to executing the program again, when the fork server fails
+    if (dbg->fork_server_enabled && restart_from_fork_server(dbg))  break;
 
-    if (pid == 0) {
-      personality(ADDR_NO_RANDOMIZE);
+    auto pid = launch_program(dbg);
+    if (!pid) {
+      dbg->state = Debugger_State::NOT_LOADED;
+      return;
+    }
 
-      ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
-      execl(dbg->executable_path, dbg->executable_path, nullptr);
-    } else if (pid >= 1) {
-      dbg->debugee_pid = pid;
+    dbg->debugee_pid = pid;
 
-      wait_for_signal(dbg);
+    wait_for_signal(dbg);
 
-      s32 fail = initialize_load_address(dbg);
+    s32 fail = initialize_load_address(dbg);
 
-      if (!fail) {
-        dbg->state = Debugger_State::LOADED;
+    if (!fail) {
+      dbg->state = Debugger_State::LOADED;
 
-        update_breakpoints(dbg);
-      } else {
-        dbg->state = Debugger_State::NOT_LOADED;
-        dbg_fail("couldn't restart debug session");
-      }
+      update_breakpoints(dbg);
+      initialize_modules(dbg);
+    } else {
+      dbg->state = Debugger_State::NOT_LOADED;
+      dbg_fail("couldn't restart debug session");
     }
     break;
   }
@@ -584,10 +917,23 @@ void restart_or_finish_debug(Debugger *dbg) {
   dbg->state = Debugger_State::LOADED;
 }
 
+// Only for a child, which isn't reaped yet, otherwise its pid could already belong to another process
+void kill_child_debugee(Debugger *dbg) {
+  if (dbg->mode != Debug_Mode::DEBUG_CHILD)  return;
+
+  kill(dbg->debugee_pid, SIGKILL);
+  s32 wait_status;
+  debugee_waitpid(dbg, &wait_status, __WALL);
+}
+
 void stop(Debugger *dbg) {
+  timeline_zone("stop");
+
   if (dbg->state == Debugger_State::RUNNING) {
 
     if (dbg->autorestart_enabled) {
+      // Program is alive, it isn't replaced by the restart
+      kill_child_debugee(dbg);
       restart_or_finish_debug(dbg);
     } else {
       dbg->state == Debugger_State::LOADED;
@@ -605,78 +951,197 @@ inline char * extract_file_name_from_path(char *file_path) {
   return file_name;
 }
 
+inline u64 get_modification_time(struct stat *file_stat) {
+  return file_stat->st_mtim.tv_sec * 1000000000ull + file_stat->st_mtim.tv_nsec;
+}
+
+// Only paths are collected on load, files are mapped on the first access,
+// so sessions with thousands of sources (mostly system headers) start fast
 void load_sources(Debugger * dbg) {
-  Array<Source_File> result;
-  Hash_Table<char *, bool> added_file_paths;
-  added_file_paths.init();
-  defer { added_file_paths.deinit(); };
+  timeline_zone("load sources");
 
-  u32 file_index = 0;
-  while (true) {
-    bool found_file_in_compilation_unit = false;
-    for (auto &cu : dbg->dwarf.compilation_units()) {
-      found_file_in_compilation_unit = false;
-      auto &lt = cu.get_line_table();
+  // Without the debug index, paths are added by the background indexing, see add_indexed_sources
+  if (dbg->debug_index) {
+    u64 start_time = get_monotonic_time_ns();
 
-      const dwarf::line_table::file *file;
-      try {
-        file = lt.get_file(file_index);
-        found_file_in_compilation_unit = true;
-      } catch (std::out_of_range ex) { continue; }
+    dbg->source_files.reset();
+    load_sources_from_index(dbg, &dbg->source_files);
 
-      auto file_path = const_cast <char *>(file->path.c_str());
-      auto file_name = extract_file_name_from_path(file_path);
+    dbg->load_timings.sources = get_monotonic_time_ns() - start_time;
+  }
 
-      // There could be duplicates of file path
-      if (added_file_paths.exists(file_path)) {
-        file_index++;
-        break;
-      }
+  // Executable modification time stands for the build time, as ELF doesn't record one
+  struct stat executable_stat;
+  dbg->executable_modification_time = 0;
+  if (dbg->executable_path && stat(dbg->executable_path, &executable_stat) == 0) {
+    dbg->executable_modification_time = get_modification_time(&executable_stat);
+  }
+}
 
-      auto f = fopen(file_path, "rb");
-      defer { fclose(f); };
+// Only loaded files are watched, which are the ones opened in the GUI or printed
+void watch_source_file(Debugger *dbg, Source_File *file) {
+  if (dbg->source_watch_fd == -1) {
+    dbg->source_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (dbg->source_watch_fd == -1)  return;
+  }
 
-      fseek(f, 0, SEEK_END);
-      u64 file_length = ftell(f);
-      fseek(f, 0, SEEK_SET);
+  auto mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+  file->watch_descriptor = inotify_add_watch(dbg->source_watch_fd, file->file_path, mask);
+}
 
-      auto content_buffer = static_cast <char *>(malloc(file_length + 1));
+void unmap_source_file(Source_File *file) {
+  file->lines.deinit();
+  if (file->content)  munmap(file->content, file->mapped_size);
 
-      fread(content_buffer, 1, file_length, f);
+  file->content = nullptr;
+  file->length = 0;
+  file->mapped_size = 0;
+  file->is_loaded = false;
+}
 
-      content_buffer[file_length] = '\0';
+bool load_source_file(Debugger *dbg, Source_File *file) {
+  if (file->is_loaded)  return true;
+  if (file->is_missing)  return false;
 
-      Array<char *> line_marks;
-      line_marks.add(content_buffer);
+  file->is_missing = true;
 
-      char c = 0;
-      char * buffer_pointer = content_buffer;
-      while ((c = *buffer_pointer) != '\0') {
-        if (c == '\n') {
-          line_marks.add(buffer_pointer + 1);
-        }
+  auto fd = open(file->file_path, O_RDONLY);
+  if (fd == -1)  return false;
+  defer { close(fd); };
 
-        buffer_pointer++;
-      }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1)  return false;
 
-      result.add((Source_File){file_path, file_name, file_length, line_marks, content_buffer});
-      added_file_paths.insert(file_path, true);
-      file_index++;
-      break;
+  // File is mapped over a reserved region one page bigger, so the content is always
+  // followed by zeroes, even when the file length is a multiple of the page size
+  u64 page_size = sysconf(_SC_PAGESIZE);
+  u64 length = file_stat.st_size;
+  u64 mapped_size = (length / page_size + 1) * page_size;
+
+  auto region = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)  return false;
+
+  if (length > 0 && mmap(region, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(region, mapped_size);
+    return false;
+  }
+
+  file->content = static_cast <char *>(region);
+  file->length = length;
+  file->mapped_size = mapped_size;
+
+  file->inode = file_stat.st_ino;
+  file->modification_time = get_modification_time(&file_stat);
+  file->is_newer_than_executable = (dbg->executable_modification_time != 0 && file->modification_time > dbg->executable_modification_time);
+
+  if (file->watch_descriptor == -1)  watch_source_file(dbg, file);
+
+  // @Speed: memchr is vectorized by glibc (SSE2/AVX2), which is way faster than checking byte by byte
+  file->lines.init();
+  file->lines.add(file->content);
+
+  auto end = file->content + length;
+  for (auto c = file->content; c < end; c++) {
+    c = static_cast <char *>(memchr(c, '\n', end - c));
+    if (!c)  break;
+    file->lines.add(c + 1);
+  }
+
+  file->is_missing = false;
+  file->is_loaded = true;
+  return true;
+}
+
+// Paths of sources are interned, so the path is looked up in the string pool once and compared by pointer
+Source_File * find_source_file(Debugger * dbg, const char * file_path) {
+  auto interned_path = dbg->strings.find(file_path);
+  if (interned_path) {
+    For_Pointer (dbg->source_files) {
+      if (it->file_path == interned_path)  return it;
     }
+  }
+
+  // Path could come from a unit indexed after the last update of the list
+  if (dbg->indexing) {
+    s32 count = dbg->source_files.count > 0 ? dbg->source_files.count : 0;
+    add_indexed_sources(dbg);
 
-    if (!found_file_in_compilation_unit)  break;
+    interned_path = dbg->strings.find(file_path);
+    if (!interned_path)  return nullptr;
+
+    for (s32 i = count; i < dbg->source_files.count; i++) {
+      if (dbg->source_files[i].file_path == interned_path)  return &dbg->source_files[i];
+    }
   }
 
-  dbg->source_files = result;
+  return nullptr;
+}
+
+// Returns line without line feed, line numbers start from 1
+bool get_source_line(Debugger *dbg, Source_File *file, u64 line, char **line_start, u64 *line_length) {
+  if (!load_source_file(dbg, file) || line == 0 || line > (u64)file->lines.count)  return false;
+
+  *line_start = file->lines[line - 1];
+  auto line_end = (line < (u64)file->lines.count) ? file->lines[line] - 1 : file->content + file->length;
+  *line_length = line_end - *line_start;
+  return true;
 }
 
 void unload_sources(Debugger * dbg) {
-  For (dbg->source_files) {
-    it.lines.deinit();
-    if (it.content) free(it.content);
-  }
+  For_Pointer (dbg->source_files)  unmap_source_file(it);
   dbg->source_files.deinit();
+
+  // Closing the descriptor removes all the watches
+  if (dbg->source_watch_fd != -1)  close(dbg->source_watch_fd);
+  dbg->source_watch_fd = -1;
+}
+
+// Drains inotify events without blocking, so no files are stat'ed unless they were touched
+void check_source_changes(Debugger *dbg) {
+  timeline_zone("check source changes");
+
+  if (dbg->source_watch_fd == -1)  return;
+
+  alignas(inotify_event) char buffer[4096];
+
+  while (true) {
+    auto bytes_read = read(dbg->source_watch_fd, buffer, sizeof(buffer));
+    if (bytes_read <= 0)  break;
+
+    for (auto event_pointer = buffer; event_pointer < buffer + bytes_read; ) {
+      auto event = reinterpret_cast <inotify_event *>(event_pointer);
+      event_pointer += sizeof(inotify_event) + event->len;
+
+      For_Pointer (dbg->source_files) {
+        if (it->watch_descriptor != event->wd)  continue;
+
+        it->is_touched = true;
+        if (event->mask & IN_IGNORED)  it->watch_descriptor = -1; // File was deleted or replaced
+      }
+    }
+  }
+
+  For_Pointer (dbg->source_files) {
+    if (!it->is_touched)  continue;
+    it->is_touched = false;
+
+    // Deleted files keep the last content
+    struct stat file_stat;
+    if (stat(it->file_path, &file_stat) != 0)  continue;
+
+    bool is_changed = (file_stat.st_ino != it->inode || (u64)file_stat.st_size != it->length ||
+                       get_modification_time(&file_stat) != it->modification_time);
+    if (!is_changed)  continue;
+
+    // Editors often save by replacing the file, so the new one is watched instead
+    if (file_stat.st_ino != it->inode && it->watch_descriptor != -1) {
+      inotify_rm_watch(dbg->source_watch_fd, it->watch_descriptor);
+      it->watch_descriptor = -1;
+    }
+
+    unmap_source_file(it);
+    load_source_file(dbg, it);
+  }
 }
 
 Array<Source_File> get_updated_sources(Debugger * dbg) {
@@ -685,7 +1150,8 @@ Array<Source_File> get_updated_sources(Debugger * dbg) {
     return Array<Source_File>();
   }
 
-  // TODO: Check for files get updated
+  add_indexed_sources(dbg);
+  check_source_changes(dbg);
 
   dbg_success();
   return dbg->source_files;
@@ -693,11 +1159,18 @@ Array<Source_File> get_updated_sources(Debugger * dbg) {
 
 void print_sources(Array<Source_File> sources) {
   For (sources) {
-    printf("%s (lines=%d, length=%ld):\t%s\n", it.file_name, it.lines.count, it.length, it.file_path);
+    if (it.is_loaded) {
+      printf("%s (lines=%d, length=%ld%s):\t%s\n", it.file_name, it.lines.count, it.length,
+             it.is_newer_than_executable ? ", newer than executable" : "", it.file_path);
+    } else {
+      printf("%s (not loaded):\t%s\n", it.file_name, it.file_path);
+    }
   }
 }
 
 Source_Location get_source_location(Debugger *dbg) {
+  timeline_zone("get source location");
+
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
     return (Source_Location){};
@@ -747,51 +1220,37 @@ Source_Context get_source_context(Debugger *dbg, u32 line_count) {
   return (Source_Context){file_path, file_name, context_start_line, line, context_end_line};
 }
 
-void print_source_location(Source_Location * location) {
-  auto fp = fopen(location->file_path, "r");
-  defer { fclose(fp); };
+void print_source_location(Debugger * dbg, Source_Location * location) {
+  auto file = find_source_file(dbg, location->file_path);
 
-  if (!fp)  return;
+  char *line_start;
+  u64 line_length;
+  if (!file || !get_source_line(dbg, file, location->line, &line_start, &line_length))  return;
 
-  char c = 0;
-  u32 current_line = 1;
-  while (current_line != location->line && (c = fgetc(fp)) != EOF) {
-    if (c == '\n')  current_line++;
-  }
+  bool has_line_feed = (line_start + line_length < file->content + file->length);
+  printf("%s:%ld %.*s%s\n", location->file_name, location->line, (s32)line_length, line_start, has_line_feed ? "\n" : "");
+}
 
-  printf("%s:%ld ", location->file_name, location->line);
+void print_source_context(Debugger * dbg, Source_Context * context) {
+  auto file = find_source_file(dbg, context->file_path);
+  if (!file || !load_source_file(dbg, file))  return;
 
-  while ((c = fgetc(fp)) != EOF) {
-    printf("%c", c);
-    if (c == '\n')  break;
-  }
+  printf("In file %s:\n", context->file_path);
 
-  printf("\n");
-}
+  for (auto line = context->start_line; ; line++) {
+    if (line == context->current_line)  printf(">%lu ", line);
+    else  printf(" %lu ", line);
 
-void print_source_context(Source_Context * context) {
-  auto fp = fopen(context->file_path, "r");
-  defer { fclose(fp); };
+    char *line_start;
+    u64 line_length;
+    if (line > context->end_line || !get_source_line(dbg, file, line, &line_start, &line_length))  break;
 
-  if (!fp)  return;
+    printf("%.*s", (s32)line_length, line_start);
 
-  char c = 0;
-  u32 current_line = 1;
-  while (current_line != context->start_line && (c = fgetc(fp)) != EOF) {
-    if (c == '\n')  current_line++;
-  }
+    bool is_last_line = (line_start + line_length >= file->content + file->length);
+    if (is_last_line)  break;
 
-  printf("In file %s:\n", context->file_path);
-  if (current_line == context->current_line)  printf(">%d ", current_line);
-  else  printf(" %d ", current_line);
-
-  while (current_line <= context->end_line && (c = fgetc(fp)) != EOF) {
-    printf("%c", c);
-    if (c == '\n') {
-      current_line++;
-      if (current_line == context->current_line)  printf(">%d ", current_line);
-      else  printf(" %d ", current_line);
-    }
+    printf("\n");
   }
 
   printf("\n");
@@ -805,7 +1264,7 @@ void print_current_source_location(Debugger * dbg) {
 
   auto location = get_source_location(dbg);
   if (dbg->last_command_status == Command_Status::SUCCESS) {
-    print_source_location(&location);
+    print_source_location(dbg, &location);
 
     dbg_success();
   }
@@ -819,24 +1278,29 @@ void print_current_source_context(Debugger * dbg, u32 line_count) {
 
   auto context = get_source_context(dbg, line_count);
   if (dbg->last_command_status == Command_Status::SUCCESS) {
-    print_source_context(&context);
+    print_source_context(dbg, &context);
 
     dbg_success();
   }
 }
 
 void step_single_instruction(Debugger *dbg) {
+  time_command(Stats_Command::STEP_INSTRUCTION);
+
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
   }
 
-  ptrace(PTRACE_SINGLESTEP, dbg->debugee_pid, nullptr, nullptr);
+  end_stop(dbg);
+  debugee_ptrace(dbg, PTRACE_SINGLESTEP, nullptr, nullptr);
   wait_for_signal(dbg);
   dbg_success();
 }
 
 void step_over_breakpoint(Debugger *dbg) {
+  timeline_zone("step over breakpoint");
+
   auto res = dbg->breakpoint_map[get_pc(dbg)];
   if (!res)  return;
   auto bp = *res;
@@ -849,14 +1313,29 @@ void step_over_breakpoint(Debugger *dbg) {
 }
 
 void continue_execution(Debugger *dbg) {
+  time_command(Stats_Command::CONTINUE);
+
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
   }
 
+  // Execution can't go on before requested breakpoints are set
+  if (dbg->pending_breakpoints.count > 0)  wait_for_indexing(dbg);
+
+  end_stop(dbg);
   step_over_breakpoint(dbg);
-  ptrace(PTRACE_CONT, dbg->debugee_pid, nullptr, nullptr);
+  debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
   wait_for_signal(dbg);
+
+  // Stops in the dynamic linker's hook are internal, execution goes on transparently
+  while (dbg->state == Debugger_State::RUNNING && dbg->modules.rendezvous_address &&
+         get_pc(dbg) == dbg->modules.rendezvous_address) {
+    step_over_breakpoint(dbg);
+    debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+    wait_for_signal(dbg);
+  }
+
   dbg_success();
 }
 
@@ -872,6 +1351,8 @@ void single_instruction_step_with_breakpoint_check(Debugger *dbg) {
 }
 
 void step_in(Debugger * dbg) {
+  time_command(Stats_Command::STEP_IN);
+
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
@@ -901,14 +1382,31 @@ void step_in(Debugger * dbg) {
   dbg_success();
 }
 
+// Return address of the current function. Works at any point of the function,
+// including its entry before the frame is set up, as it's resolved by CFI.
+u64 get_return_address(Debugger *dbg, u64 *cfa) {
+  Unwind_Registers registers;
+  get_unwind_registers(dbg, &registers);
+
+  if (unwind_frame(dbg, &registers, false, cfa)) {
+    return registers.values[unwind_return_address_register];
+  }
+
+  // Assuming the frame pointer is set up
+  auto base_pointer = read_register(dbg, Register::rbp);
+  if (cfa)  *cfa = base_pointer + 16;
+  return read_memory(dbg, base_pointer + 8);
+}
+
 void step_out(Debugger * dbg) {
+  time_command(Stats_Command::STEP_OUT);
+
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
   }
 
-  auto base_pointer = read_register(dbg, Register::rbp);
-  auto return_address = read_memory(dbg, base_pointer + 8);
+  auto return_address = get_return_address(dbg);
 
   bool return_breakpoint_exists = dbg->breakpoint_map.exists(return_address);
 
@@ -929,6 +1427,8 @@ void step_out(Debugger * dbg) {
 }
 
 void step_over(Debugger * dbg) {
+  time_command(Stats_Command::STEP_OVER);
+
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
@@ -954,7 +1454,7 @@ void step_over(Debugger * dbg) {
     return;
   }
 
-  Array<Breakpoint *> to_delete;
+  Small_Array<Breakpoint *, 16> to_delete;
   defer {
     For (to_delete) {
       remove_breakpoint(dbg, it);
@@ -962,7 +1462,7 @@ void step_over(Debugger * dbg) {
     to_delete.deinit();
   };
 
-  Array<Breakpoint *> to_disable;
+  Small_Array<Breakpoint *, 16> to_disable;
   defer {
     For (to_disable) {
       disable_breakpoint(dbg, it);
@@ -991,8 +1491,8 @@ void step_over(Debugger * dbg) {
     ++line;
   }
 
-  auto base_pointer = read_register(dbg, Register::rbp);
-  auto return_address = read_memory(dbg, base_pointer + 8);
+  // Resolved by CFI, the last line could be stepped over in functions without a frame pointer
+  auto return_address = get_return_address(dbg);
 
   bool return_breakpoint_exists = dbg->breakpoint_map.exists(return_address);
 
@@ -1007,28 +1507,82 @@ void step_over(Debugger * dbg) {
 }
 
 
-class ptrace_expr_context : public dwarf::expr_context {
-public:
-  ptrace_expr_context(pid_t pid, u64 load_address) : pid(pid), load_address(load_address) {}
+// Bytes holding the bits of a bitfield, up to 9 for 64 bits not aligned to a byte
+u64 get_bitfield_data_size(u32 bit_offset, u32 bit_size) {
+  return (bit_offset + bit_size + 7) / 8;
+}
 
-  dwarf::taddr reg(u32 regnum) override {
-    return read_dwarf_register(pid, regnum);
-  }
-  dwarf::taddr pc() override {
-    struct user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
-    return regs.rip - load_address;
+// Value is taken from the first bytes of the data, bitfields are shifted and masked
+void set_variable_value(Variable *variable) {
+  auto data = variable->data;
+  auto data_size = variable->data_size;
+
+  variable->value = 0;
+  memcpy(&variable->value, data, data_size < sizeof(u64) ? data_size : sizeof(u64));
+
+  if (variable->bit_size == 0)  return;
+
+  variable->value >>= variable->bit_offset;
+  if (variable->bit_offset > 0 && data_size > sizeof(u64))  variable->value |= (u64)data[sizeof(u64)] << (64 - variable->bit_offset);
+  if (variable->bit_size < 64)  variable->value &= (1ull << variable->bit_size) - 1;
+}
+
+// Reads contents of all variables located in memory with one process_vm_readv call per
+// batch of scattered ranges. Batch is reread variable by variable, if any of its ranges
+// couldn't be read, as process_vm_readv stops on the first failed one.
+void read_variables_data(Debugger *dbg, Array<Variable> *variables) {
+  timeline_zone("read variables data");
+
+  constexpr u32 max_batch_size = 1024; // IOV_MAX
+
+  iovec local_buffers[max_batch_size];
+  iovec remote_buffers[max_batch_size];
+  Variable *batch[max_batch_size];
+
+  u32 batch_size = 0;
+  u64 batch_bytes = 0;
+
+  auto flush_batch = [&]() {
+    if (batch_size == 0)  return;
+
+    auto bytes_read = debugee_read_memory(dbg, local_buffers, remote_buffers, batch_size);
+    if (bytes_read != (ssize_t)batch_bytes) {
+      For_Count (batch_size, i)  read_memory(dbg, batch[i]->address, batch[i]->data, batch[i]->data_size);
+    }
+
+    batch_size = 0;
+    batch_bytes = 0;
+  };
+
+  For_Pointer (*variables) {
+    if (it->location != Variable_Location::MEMORY)  continue;
+
+    it->data_size = it->size < max_variable_read_size ? it->size : max_variable_read_size;
+    it->data = static_cast <u8 *>(allocate_memory(variables->allocator, it->data_size ? it->data_size : 1));
+    memset(it->data, 0, it->data_size ? it->data_size : 1);
+    if (it->data_size == 0)  continue;
+
+    local_buffers[batch_size] = { it->data, it->data_size };
+    remote_buffers[batch_size] = { reinterpret_cast <void *>(it->address), it->data_size };
+    batch[batch_size] = it;
+    batch_size++;
+    batch_bytes += it->data_size;
+
+    if (batch_size == max_batch_size)  flush_batch();
   }
-  dwarf::taddr deref_size(dwarf::taddr address, u32 size) override {
-    return ptrace(PTRACE_PEEKDATA, pid, address + load_address, nullptr);
+
+  flush_batch();
+
+  For_Pointer (*variables) {
+    if (it->location != Variable_Location::MEMORY)  continue;
+
+    set_variable_value(it);
   }
+}
 
-private:
-  pid_t pid;
-  u64 load_address;
-};
+void get_variables(Debugger *dbg, u32 frame_index, Array<Variable> * variables_pointer, Allocator allocator) {
+  time_command(Stats_Command::VARIABLES);
 
-void get_variables(Debugger *dbg, Array<Variable> * variables_pointer) {
   if (!variables_pointer) {
     dbg_fail("pointer to output array is null");
     return;
@@ -1036,69 +1590,324 @@ void get_variables(Debugger *dbg, Array<Variable> * variables_pointer) {
 
   auto &variables = *variables_pointer;
 
-  variables.reset();
+  free_variables_data(&variables);
+  reset_output_array(&variables, allocator);
 
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
   }
 
-  auto func = get_function_from_pc(dbg, offset_load_address(dbg, get_pc(dbg)));
+  // Registers of the frame are restored by unwinding from the innermost one
+  Unwind_Registers registers;
+  get_unwind_registers(dbg, &registers);
+
+  For_Count (frame_index, i) {
+    if (!unwind_frame(dbg, &registers, i > 0, nullptr)) {
+      dbg_fail("failed to unwind to the frame");
+      return;
+    }
+  }
+
+  // Return address could be past the end of the caller, when the call is its last instruction
+  bool is_caller_frame = (frame_index > 0);
+  auto pc = offset_load_address(dbg, registers.values[unwind_return_address_register] - (is_caller_frame ? 1 : 0));
+
+  auto func = get_function_from_pc(dbg, pc);
   if (dbg->last_command_status == Command_Status::FAIL) {
-    dbg_fail("failed to find current function location");
+    dbg_fail("failed to find function location of the frame");
     return;
   }
 
-  for (const auto &die : func) {
-    if (die.tag == dwarf::DW_TAG::variable) {
-      auto loc_val = die[dwarf::DW_AT::location];
-      if (loc_val.get_type() == dwarf::value::type::exprloc) {
-        ptrace_expr_context context(dbg->debugee_pid, dbg->load_address);
-        auto result = loc_val.as_exprloc().evaluate(&context);
-
-        switch (result.location_type) {
-        case dwarf::expr_result::type::address: {
-          auto address = result.value + 0x10;
-          auto value = read_memory(dbg, address);
-          auto name = const_cast <char *>(die[dwarf::DW_AT::name].as_cstr(nullptr));
-          variables.add((Variable){name, value, Variable_Location::MEMORY, address});
-          break;
-        }
+  auto locals = get_function_locals(dbg, func);
 
-        case dwarf::expr_result::type::reg: {
-          auto value = read_dwarf_register(dbg, result.value);
-          auto name = const_cast <char *>(die[dwarf::DW_AT::name].as_cstr(nullptr));
-          auto &reg = result.value;
-          variables.add((Variable){name, value, Variable_Location::REGISTER, reg});
-          break;
-        }
+  Expression_Context context = {};
+  context.dbg = dbg;
+  context.registers = &registers;
+  context.is_caller_frame = is_caller_frame;
+  context.allocator = variables.allocator;
+  context.frame_base_expression = locals->frame_base;
 
-        default:
-          fprintf(stderr, "ERROR: Unhandled variable location\n");
-          break;
-        }
-      }
-    }
+  For_Pointer (locals->variables) {
+    if (!is_variable_in_scope(locals, it, pc))  continue;
+
+    Variable variable;
+    variable.name = it->name;
+    variable.type = it->type;
+    variable.size = variable.type ? variable.type->size : sizeof(u64);
+    variable.value = 0;
+    variable.is_parameter = it->is_parameter;
+
+    auto location = get_variable_location(&context, it, pc);
+    set_variable_location(dbg, &context, location, &variable);
+
+    variables.add(variable);
   }
 
+  read_variables_data(dbg, &variables);
+
   dbg_success();
 }
 
+void get_variables(Debugger *dbg, Array<Variable> * variables, Allocator allocator) {
+  get_variables(dbg, 0, variables, allocator);
+}
+
 void deinit(Array<Variable> variables) {
+  free_variables_data(&variables);
   variables.deinit();
 }
 
+u64 get_child_count(Variable *variable) {
+  if (variable->location != Variable_Location::MEMORY)  return 0;
+
+  auto type = resolve_typedefs(variable->type);
+  if (!type)  return 0;
+
+  switch (type->kind) {
+  case Type_Kind::STRUCT:
+  case Type_Kind::UNION:
+    return type->members.count > 0 ? type->members.count : 0;
+
+  case Type_Kind::ARRAY:
+    return type->element_count;
+
+  case Type_Kind::POINTER: {
+    auto target = resolve_typedefs(type->target);
+    bool can_dereference = (variable->value != 0 && target && target->kind != Type_Kind::FUNCTION && target->size > 0);
+    return can_dereference ? 1 : 0;
+  }
+
+  default:
+    return 0;
+  }
+}
+
+void get_variable_children(Debugger *dbg, Variable *parent, u64 first_child, u64 count, Array<Variable> *children_pointer, Allocator allocator) {
+  time_command(Stats_Command::VARIABLE_CHILDREN);
+
+  if (!children_pointer) {
+    dbg_fail("pointer to output array is null");
+    return;
+  }
+
+  auto &children = *children_pointer;
+
+  free_variables_data(&children);
+  reset_output_array(&children, allocator);
+
+  auto child_count = get_child_count(parent);
+  if (first_child >= child_count) {
+    dbg_success();
+    return;
+  }
+  if (count > child_count - first_child)  count = child_count - first_child;
+
+  auto type = resolve_typedefs(parent->type);
+
+  for (u64 i = first_child; i < first_child + count; i++) {
+    Variable child;
+    child.location = Variable_Location::MEMORY;
+    child.index = i;
+
+    switch (type->kind) {
+    case Type_Kind::STRUCT:
+    case Type_Kind::UNION: {
+      auto &member = type->members[i];
+      child.name = member.name;
+      child.type = member.type;
+      child.address = parent->address + member.offset;
+      child.bit_offset = member.bit_offset;
+      child.bit_size = member.bit_size;
+      break;
+    }
+
+    case Type_Kind::ARRAY:
+      child.type = type->target;
+      child.address = parent->address + i * (type->target ? type->target->size : 0);
+      break;
+
+    case Type_Kind::POINTER:
+      child.type = type->target;
+      child.address = parent->value;
+      break;
+
+    default:
+      break;
+    }
+
+    child.size = child.type ? child.type->size : 0;
+    if (child.bit_size)  child.size = get_bitfield_data_size(child.bit_offset, child.bit_size);
+    children.add(child);
+  }
+
+  // Contents of children already read with parent are copied from it, others are read
+  // with one bulk read covering all of them
+  u64 span_start = (u64)-1;
+  u64 span_end = 0;
+
+  For_Pointer (children) {
+    it->data_size = it->size < max_variable_read_size ? it->size : max_variable_read_size;
+    it->data = static_cast <u8 *>(allocate_memory(children.allocator, it->data_size ? it->data_size : 1));
+    memset(it->data, 0, it->data_size ? it->data_size : 1);
+
+    bool is_inside_parent = (type->kind != Type_Kind::POINTER && it->address + it->data_size <= parent->address + parent->data_size);
+    if (is_inside_parent) {
+      memcpy(it->data, parent->data + (it->address - parent->address), it->data_size);
+    } else {
+      if (it->address < span_start)  span_start = it->address;
+      if (it->address + it->data_size > span_end)  span_end = it->address + it->data_size;
+    }
+  }
+
+  if (span_start < span_end) {
+    auto span_size = span_end - span_start;
+    auto span = static_cast <u8 *>(allocate_memory(children.allocator, span_size));
+    defer { free_memory(children.allocator, span); };
+
+    read_memory(dbg, span_start, span, span_size);
+
+    For_Pointer (children) {
+      if (it->address >= span_start && it->address + it->data_size <= span_end) {
+        bool is_inside_parent = (type->kind != Type_Kind::POINTER && it->address + it->data_size <= parent->address + parent->data_size);
+        if (!is_inside_parent)  memcpy(it->data, span + (it->address - span_start), it->data_size);
+      }
+    }
+  }
+
+  For_Pointer (children) {
+    set_variable_value(it);
+  }
+
+  dbg_success();
+}
+
+inline s64 sign_extend(u64 value, u64 bit_count) {
+  if (bit_count == 0 || bit_count >= 64)  return (s64)value;
+  u32 shift = 64 - bit_count;
+  return ((s64)(value << shift)) >> shift;
+}
+
+void format_variable_value(Variable *variable, char *buffer, u64 buffer_size) {
+  if (variable->location == Variable_Location::OPTIMIZED_OUT) {
+    snprintf(buffer, buffer_size, "<optimized out>");
+    return;
+  }
+
+  auto type = resolve_typedefs(variable->type);
+  if (!type) {
+    snprintf(buffer, buffer_size, "0x%lx", variable->value);
+    return;
+  }
+
+  // Bitfield value is already extracted from its bytes
+  u64 bit_count = variable->bit_size ? variable->bit_size : type->size * 8;
+  u64 value_size = variable->bit_size ? get_bitfield_data_size(variable->bit_offset, variable->bit_size) : type->size;
+
+  bool is_scalar = (type->kind == Type_Kind::BASE || type->kind == Type_Kind::POINTER || type->kind == Type_Kind::ENUM);
+  if (is_scalar && variable->data_size < value_size) {
+    snprintf(buffer, buffer_size, "<unavailable>");
+    return;
+  }
+
+  switch (type->kind) {
+  case Type_Kind::BASE:
+    switch (type->encoding) {
+    case Base_Type_Encoding::FLOAT:
+      if (type->size == sizeof(float32)) {
+        float32 value;
+        memcpy(&value, variable->data, sizeof(value));
+        snprintf(buffer, buffer_size, "%g", value);
+      } else if (type->size == sizeof(float64)) {
+        float64 value;
+        memcpy(&value, variable->data, sizeof(value));
+        snprintf(buffer, buffer_size, "%g", value);
+      } else {
+        long double value = 0;
+        memcpy(&value, variable->data, type->size < sizeof(value) ? type->size : sizeof(value));
+        snprintf(buffer, buffer_size, "%Lg", value);
+      }
+      break;
+
+    case Base_Type_Encoding::BOOLEAN:
+      snprintf(buffer, buffer_size, "%s", variable->value ? "true" : "false");
+      break;
+
+    case Base_Type_Encoding::SIGNED_CHAR:
+    case Base_Type_Encoding::UNSIGNED_CHAR: {
+      auto c = (u8)variable->value;
+      if (isprint(c)) {
+        snprintf(buffer, buffer_size, "%d '%c'", type->encoding == Base_Type_Encoding::SIGNED_CHAR ? (s8)c : c, c);
+      } else {
+        snprintf(buffer, buffer_size, "%d", type->encoding == Base_Type_Encoding::SIGNED_CHAR ? (s8)c : c);
+      }
+      break;
+    }
+
+    case Base_Type_Encoding::UNSIGNED:
+      snprintf(buffer, buffer_size, "%lu", variable->value);
+      break;
+
+    case Base_Type_Encoding::SIGNED:
+      snprintf(buffer, buffer_size, "%ld", sign_extend(variable->value, bit_count));
+      break;
+    }
+    break;
+
+  case Type_Kind::POINTER:
+    snprintf(buffer, buffer_size, "0x%lx", variable->value);
+    break;
+
+  case Type_Kind::ENUM: {
+    s64 value = (type->encoding == Base_Type_Encoding::SIGNED) ? sign_extend(variable->value, bit_count) : (s64)variable->value;
+
+    For_Pointer (type->enumerators) {
+      if (it->value == value) {
+        snprintf(buffer, buffer_size, "%s (%ld)", it->name, value);
+        return;
+      }
+    }
+    snprintf(buffer, buffer_size, "%ld", value);
+    break;
+  }
+
+  case Type_Kind::STRUCT:
+  case Type_Kind::UNION:
+    snprintf(buffer, buffer_size, "{...}");
+    break;
+
+  case Type_Kind::ARRAY:
+    snprintf(buffer, buffer_size, "[%lu]", type->element_count);
+    break;
+
+  default:
+    snprintf(buffer, buffer_size, "?");
+    break;
+  }
+}
+
 void print_variables(Array<Variable> variables) {
   For (variables) {
+    char value[128];
+    format_variable_value(&it, value, sizeof(value));
+
+    auto type_name = it.type ? it.type->name : (char *)"?";
+
     switch (it.location) {
     case Variable_Location::MEMORY:
-      printf("%s\t(addr 0x%lx)\t= 0x%lx\n", it.name, it.address, it.value);
+      printf("%s %s\t(addr 0x%lx)\t= %s\n", type_name, it.name, it.address, value);
       break;
     case Variable_Location::REGISTER: {
       auto register_name = global_register_descriptors[(u32)it.reg].name;
-      printf("%s\t(reg %s)\t= 0x%lx\n", it.name, register_name, it.value);
+      printf("%s %s\t(reg %s)\t= %s\n", type_name, it.name, register_name, value);
       break;
     }
+    case Variable_Location::VALUE:
+      printf("%s %s\t(computed)\t= %s\n", type_name, it.name, value);
+      break;
+    case Variable_Location::OPTIMIZED_OUT:
+      printf("%s %s\t= <optimized out>\n", type_name, it.name);
+      break;
     default:
       assert(false && "Unknownw variable location");
       break;
@@ -1109,19 +1918,23 @@ void print_variables(Array<Variable> variables) {
 inline char *get_function_name(dwarf::die function_die) {
   if (function_die.has(dwarf::DW_AT::name))  return const_cast <char *>(function_die[dwarf::DW_AT::name].as_cstr(nullptr));
   else if (function_die.has(dwarf::DW_AT::specification)) {
-    auto member_function_die = function_die[dwarf::DW_AT::specification].as_reference();
-    return const_cast <char *>(member_function_die[dwarf::DW_AT::name].as_cstr(nullptr));
+    return get_function_name(function_die[dwarf::DW_AT::specification].as_reference());
+  } else if (function_die.has(dwarf::DW_AT::abstract_origin)) {
+    return get_function_name(function_die[dwarf::DW_AT::abstract_origin].as_reference());
   }
-  assert(false);
+  return (char *)"??";
 }
 
-inline void add_function(Debugger *dbg, Array<Frame> *frames, dwarf::die function_die) {
-  auto function_name = get_function_name(function_die);
+inline void add_function(Debugger *dbg, Array<Frame> *frames, dwarf::die function_die, u64 pc, u64 cfa) {
+  auto function_name = dbg->strings.intern(get_function_name(function_die));
   auto file_coordinates = function_die[dwarf::DW_AT::decl_file].as_uconstant();
 
   // Finding filename from declaration coordinates
   char *file_path = nullptr;
+  u32 unit_index = 0;
   for (auto &cu : dbg->dwarf.compilation_units()) {
+    wait_for_unit(dbg, unit_index++);
+
     try {
       auto &lt = cu.get_line_table();
       auto file = lt.get_file(file_coordinates);
@@ -1139,10 +1952,12 @@ inline void add_function(Debugger *dbg, Array<Frame> *frames, dwarf::die functio
 
   auto function_location = (Source_Location){file_path, file_name, line};
 
-  frames->add((Frame){function_name, function_location, address});
+  frames->add((Frame){function_name, function_location, address, pc, cfa});
 }
 
-void get_stack_trace(Debugger * dbg, Array<Frame> * frames_pointer) {
+void get_stack_trace(Debugger * dbg, Array<Frame> * frames_pointer, Allocator allocator) {
+  time_command(Stats_Command::STACK_TRACE);
+
   if (!frames_pointer) {
     dbg_fail("pointer to output array is null");
     return;
@@ -1150,38 +1965,52 @@ void get_stack_trace(Debugger * dbg, Array<Frame> * frames_pointer) {
 
   auto &frames = *frames_pointer;
 
-  frames.reset();
+  reset_output_array(&frames, allocator);
 
   if (dbg->state != Debugger_State::RUNNING) {
     dbg_fail("debugged program isn't running");
     return;
   }
 
-  auto func = get_function_from_pc(dbg, offset_load_address(dbg, get_pc(dbg)));
-  if (dbg->last_command_status == Command_Status::FAIL) {
-    dbg_fail("failed to find current function location");
-    return;
-  }
+  Unwind_Registers registers;
+  get_unwind_registers(dbg, &registers);
 
-  add_function(dbg, &frames, func);
+  auto main_name = dbg->strings.intern("main");
 
-  auto frame_pointer = read_register(dbg, Register::rbp);
-  auto return_address = read_memory(dbg, frame_pointer + 8);
+  For_Count (max_stack_trace_depth, depth) {
+    bool is_caller_frame = (depth > 0);
+    auto pc = registers.values[unwind_return_address_register];
 
-  auto iter = func;
-  char *iter_function_name = get_function_name(iter);
-  while (strncmp(iter_function_name, "main", 5) != 0) {
-    iter = get_function_from_pc(dbg, offset_load_address(dbg, return_address));
+    auto func = get_function_from_pc(dbg, offset_load_address(dbg, pc - (is_caller_frame ? 1 : 0)));
+    bool is_in_library = false;
     if (dbg->last_command_status == Command_Status::FAIL) {
-      dbg_fail("failed to find function location");
-      frames.deinit();
-      return;
+      // Frames of shared libraries are named by their symbol tables
+      u64 function_address;
+      auto function_name = find_module_function_name(dbg, pc - (is_caller_frame ? 1 : 0), &function_address);
+
+      if (!function_name) {
+        if (depth == 0) {
+          dbg_fail("failed to find current function location");
+          return;
+        }
+        break; // Reached code without debug info
+      }
+
+      auto module = find_module(dbg, pc);
+      frames.add((Frame){dbg->strings.intern(function_name), (Source_Location){module->path, module->name, 0}, function_address, pc, 0});
+      is_in_library = true;
+    }
+
+    u64 cfa;
+    bool is_unwound = unwind_frame(dbg, &registers, is_caller_frame, &cfa);
+
+    if (is_in_library) {
+      frames.back().cfa = is_unwound ? cfa : 0;
+    } else {
+      add_function(dbg, &frames, func, pc, is_unwound ? cfa : 0);
     }
-    add_function(dbg, &frames, iter);
 
-    frame_pointer = read_memory(dbg, frame_pointer);
-    return_address = read_memory(dbg, frame_pointer + 8);
-    iter_function_name = get_function_name(iter);
+    if (!is_unwound || frames.back().function_name == main_name)  break;
   }
 
   dbg_success();
@@ -1204,9 +2033,6 @@ void print_stack_trace(Array<Frame> stack_trace) {
 //
 
 void deinit(Array<Symbol> symbols) {
-  For (symbols) {
-    if (it.name)  free(it.name);
-  }
   symbols.deinit();
 }
 
@@ -1232,7 +2058,9 @@ Symbol_Type to_symbol_type(elf::stt symbol) {
   }
 }
 
-void lookup_symbol(Debugger *dbg, const char *c_name, Array<Symbol> * symbols_pointer) {
+void lookup_symbol(Debugger *dbg, const char *c_name, Array<Symbol> * symbols_pointer, Allocator allocator) {
+  time_command(Stats_Command::LOOKUP_SYMBOL);
+
   if (!symbols_pointer) {
     dbg_fail("pointer to output array is null");
     return;
@@ -1240,7 +2068,7 @@ void lookup_symbol(Debugger *dbg, const char *c_name, Array<Symbol> * symbols_po
 
   auto &syms = *symbols_pointer;
 
-  syms.reset();
+  reset_output_array(&syms, allocator);
 
   if (dbg->state == Debugger_State::NOT_LOADED) {
     dbg_fail("debugged program isn't loaded");
@@ -1250,34 +2078,36 @@ void lookup_symbol(Debugger *dbg, const char *c_name, Array<Symbol> * symbols_po
   auto name = const_cast <char *>(c_name);
 
   auto name_len = strlen(name);
-  for (auto &sec : dbg->elf.sections()) {
-    if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym)  continue;
 
-    for (auto sym : sec.as_symtab()) {
-      size_t symtab_name_len = -1;
-      auto symtab_name = sym.get_name(&symtab_name_len);
+  // Stripped executables keep only the dynamic symbols, the full table is in the debug file
+  const elf::elf *symbol_files[] = { &dbg->elf, &dbg->debug_elf };
+  u32 symbol_file_count = (strcmp(dbg->debug_file_path, dbg->executable_path) == 0) ? 1 : 2;
 
-      if (symtab_name_len > 0) {
-        if (symtab_name_len >= 2 && symtab_name[0] == '_' && symtab_name[1] == 'Z') {
-          s32 status = -1;
+  For_Count (symbol_file_count, file_index) {
+    for (auto &sec : symbol_files[file_index]->sections()) {
+      if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym)  continue;
 
-          char *demangled_name = abi::__cxa_demangle(symtab_name, NULL, NULL, &status);
+      for (auto sym : sec.as_symtab()) {
+        size_t symtab_name_len = -1;
+        auto symtab_name = sym.get_name(&symtab_name_len);
 
-          if (status == 0 && strstr(demangled_name, name)) {
-            auto &d = sym.get_data();
-            syms.add((Symbol){to_symbol_type(d.type()), demangled_name, d.value});
-          } else {
-            free(demangled_name); // Free, if not adding to syms array
-          }
-        } else {
-          if (strstr(symtab_name, name)) {
-            auto &d = sym.get_data();
+        if (symtab_name_len > 0) {
+          if (symtab_name_len >= 2 && symtab_name[0] == '_' && symtab_name[1] == 'Z') {
+            s32 status = -1;
 
-            auto symbol_name = static_cast <char *>(malloc(symtab_name_len + 1));
-            strncpy(symbol_name, symtab_name, symtab_name_len);
-            symbol_name[symtab_name_len] = '\0';
+            // Buffer is reallocated by demangler only when a name doesn't fit
+            auto demangled_name = abi::__cxa_demangle(symtab_name, dbg->demangle_buffer, &dbg->demangle_buffer_size, &status);
+            if (demangled_name)  dbg->demangle_buffer = demangled_name;
 
-            syms.add((Symbol){to_symbol_type(d.type()), symbol_name, d.value});
+            if (status == 0 && strstr(demangled_name, name)) {
+              auto &d = sym.get_data();
+              syms.add((Symbol){to_symbol_type(d.type()), dbg->strings.intern(demangled_name), d.value});
+            }
+          } else {
+            if (strstr(symtab_name, name)) {
+              auto &d = sym.get_data();
+              syms.add((Symbol){to_symbol_type(d.type()), dbg->strings.intern(symtab_name, symtab_name_len), d.value});
+            }
           }
         }
       }
@@ -11,6 +11,8 @@
 #include "common.h"
 #include "Array.h"
 #include "Hash_Table.h"
+#include "String_Pool.h"
+#include "Timeline.h"
 
 //
 //  Debugger library interface
@@ -27,6 +29,16 @@ struct Symbol;
 struct Frame;
 struct Variable;
 struct Source_File;
+struct Profile;
+struct Unwind_Table;
+struct Type;
+struct Type_Table;
+struct Locals_Cache;
+struct Memory_Cache;
+struct Module_Debug_Info;
+struct Debug_Index;
+struct Indexing;
+struct Fork_Server;
 
 enum class Debugger_State : u8 {
   NOT_LOADED,
@@ -40,15 +52,178 @@ enum class Command_Status : u8 {
   FAIL,
 };
 
+// Files are memory-mapped and indexed on the first access, see load_source_file
 struct Source_File {
-  char *file_path = nullptr;
-  char *file_name = nullptr;
+  char *file_path = nullptr; // Interned
+  char *file_name = nullptr; // Last component of the path
+
+  u64 length = 0;
+
+  Array<char *> lines; // Starts of lines
+
+  char *content = nullptr; // Read-only, always followed by zero byte
+  u64 mapped_size = 0;
+
+  bool is_loaded = false;
+  bool is_missing = false; // Couldn't be read, not retried
+
+  // Change tracking, loaded files are reloaded by get_updated_sources when they change on disk
+  u64 inode = 0;
+  u64 modification_time = 0; // Nanoseconds
+  s32 watch_descriptor = -1;
+  bool is_touched = false;
+  bool is_newer_than_executable = false; // Lines could mismatch debug info
+};
+
+// Address range of a function in DWARF addresses (without load address)
+struct Function_Range {
+  u64 low_pc;
+  u64 high_pc;
+  char *name = nullptr;
+};
+
+// Function defined in a compilation unit, looked up by name for function breakpoints
+struct Function_Name {
+  char *name;
+  u32 unit_index;
+};
+
+// Breakpoint requested while its unit isn't indexed yet, set by update_indexing
+struct Pending_Breakpoint {
+  char *function_declaration = nullptr; // Either a function
+  char *file_name = nullptr;            // or a source line
+  u32 line = 0;
+};
+
+// Durations of the debug info loading phases in nanoseconds, see print_load_timings
+struct Load_Timings {
+  u64 elf = 0;          // Mapping of the executable
+  u64 debug_file = 0;   // Search for the file with DWARF
+  u64 dwarf = 0;        // Headers of compilation units
+  u64 debug_index = 0;  // Mapping and validation of the saved index
+  u64 preload = 0;      // Shared sections and abbreviations, before the background part
+  u64 entry_unit = 0;   // Until the unit with main is indexed, the only one needed at the start
+  u64 units = 0;        // Parsing of all compilation units on the thread pool
+  u64 merge = 0;        // Merging and sorting of per-unit indices
+  u64 sources = 0;      // Source paths read from the saved index
+  u64 index_write = 0;
+
+  u32 unit_count = 0;
+  u32 thread_count = 0;
+};
+
+// Allocations made from a stop of the process until it resumes, see print_allocation_stats
+struct Stop_Allocations {
+  u64 heap_count = 0;  // Through allocators on the debugger thread
+  u64 heap_bytes = 0;
+  u64 arena_count = 0; // From the stop arena
+  u64 arena_bytes = 0;
+};
+
+enum class Ptrace_Counter : u8 {
+  PEEK,          // PEEKDATA, PEEKTEXT, PEEKUSER
+  POKE,          // POKEDATA, POKETEXT, POKEUSER
+  GET_REGISTERS, // GETREGS, GETFPREGS
+  SET_REGISTERS, // SETREGS, SETFPREGS
+  CONTINUE,
+  SINGLE_STEP,
+  SIGNAL_INFO,
+  OTHER,         // ATTACH, DETACH and others
+  COUNT
+};
+
+enum class Stats_Cache : u8 {
+  MEMORY,     // Pages of read_cached_memory
+  MEMORY_MAP, // Refreshed once per stop
+  TYPES,      // Types by DIE offset
+  LOCALS,     // Local variables of functions
+  COUNT
+};
+
+enum class Stats_Command : u8 {
+  DEBUG,
+  ATTACH,
+  CONTINUE,
+  STEP_IN,
+  STEP_OUT,
+  STEP_OVER,
+  STEP_INSTRUCTION,
+  SET_BREAKPOINT,
+  REMOVE_BREAKPOINT,
+  STACK_TRACE,
+  VARIABLES,
+  VARIABLE_CHILDREN,
+  LOOKUP_SYMBOL,
+  EVALUATE_WATCHES,
+  COUNT
+};
+
+struct Command_Timing {
+  u64 count = 0;
+  u64 total_time = 0; // Nanoseconds
+  u64 max_time = 0;
+};
+
+// Counted all the time, with plain increments on the debugger thread
+struct Debugger_Stats {
+  u64 ptrace_calls[(u32)Ptrace_Counter::COUNT] = {};
+  u64 waitpid_calls = 0;   // Polling ones included
+  u64 stops = 0;           // Waits, which returned a stopped process
+  u64 memory_reads = 0;    // process_vm_readv calls
+  u64 bytes_read = 0;      // By process_vm_readv and PEEKDATA
+  u64 bytes_written = 0;   // By POKEDATA, breakpoints included
+  u64 dwarf_lookups = 0;   // Searches of functions and lines by address and of functions by name
+
+  u64 cache_hits[(u32)Stats_Cache::COUNT] = {};
+  u64 cache_misses[(u32)Stats_Cache::COUNT] = {};
+
+  Command_Timing commands[(u32)Stats_Command::COUNT]; // Only outermost commands, nested ones are a part of them
+
+  u64 reset_time = 0; // Monotonic time of init or of the last reset
+};
+
+enum Memory_Permission : u8 {
+  MEMORY_READ    = 1 << 0,
+  MEMORY_WRITE   = 1 << 1,
+  MEMORY_EXECUTE = 1 << 2,
+  MEMORY_SHARED  = 1 << 3,
+};
+
+struct Memory_Region {
+  u64 start;
+  u64 end;
+  u64 offset; // Offset in the mapped file
+  u8 permissions;
+  char *path = nullptr; // Null for anonymous regions, pseudo-paths like [stack] are kept
+};
+
+struct Memory_Map {
+  Array<Memory_Region> regions; // Sorted by address
+  char *text = nullptr;         // Contents of /proc/<pid>/maps, owns paths of the regions
+  u64 refresh_stop = 0;         // Stop during which the map was read
+};
+
+// Executable or shared library mapped into the process, see modules.cpp
+struct Module {
+  char *path = nullptr;
+  char *name = nullptr;   // File name part of the path
+  u64 load_bias = 0;      // Added to addresses of the file to get addresses in the process
+  u64 start = 0;          // Range of the file mappings in the process
+  u64 end = 0;
+  bool is_main = false;   // Executable itself, described by Debugger::elf and Debugger::dwarf
+
+  Module_Debug_Info *debug_info = nullptr; // Loaded on the first use, owned by Module_List
+};
 
-  u64 length;
+struct Module_List {
+  Array<Module> modules;                  // Sorted by start
+  Array<Module_Debug_Info *> debug_infos; // Kept between refreshes and restarts, found by path
 
-  Array<char *> lines;
+  u64 r_debug_address = 0;    // Rendezvous structure of the dynamic linker
+  u64 rendezvous_address = 0; // Function the dynamic linker calls on every change of the list
+  Breakpoint *rendezvous_breakpoint = nullptr; // Internal, isn't listed in Debugger::breakpoints
 
-  char *content = nullptr;
+  u64 refresh_stop = 0;
 };
 
 enum class Debug_Mode : u8 {
@@ -57,10 +232,21 @@ enum class Debug_Mode : u8 {
   DEBUG_CHILD
 };
 
+// How the debugged program is started by debug and by every restart
+struct Launch_Options {
+  const char * arguments = nullptr;         // Split like by a shell: by whitespace, with '...' and "..." quoting and \ escapes
+  const char * environment = nullptr;       // Overrides of the debugger environment, split as arguments: NAME=value sets, NAME unsets
+  const char * working_directory = nullptr; // Debugger working directory when null
+  const char * stdin_path = nullptr;        // Redirections, relative to the working directory. Stdout file gets stderr too
+  const char * stdout_path = nullptr;
+  bool use_pty = false;                     // Streams without a file go to a pseudo terminal instead of the debugger ones
+};
+
 struct Debugger {
   u32 debugee_pid = 0;
   char * executable_path = nullptr;
-  char * argument_string = nullptr;
+  Launch_Options launch_options; // Strings are owned copies
+  s32 pty_master_fd = -1;        // Terminal of the program, when it's launched with use_pty
 
   Debug_Mode mode = Debug_Mode::NONE;
 
@@ -72,23 +258,105 @@ struct Debugger {
 
   dwarf::dwarf dwarf;
   elf::elf elf;
+  elf::elf debug_elf;                   // File with DWARF, the executable itself when it isn't stripped
+  char * debug_file_path = nullptr;
+  char * debug_file_directory = nullptr; // Searched for debug files and caches the found ones by build-id
+  Debug_Index * debug_index = nullptr;   // Mapped index of debug info saved by an earlier session, see index.cpp
 
   Array<Source_File> source_files;
+  s32 source_watch_fd = -1; // inotify instance watching loaded sources
+  u64 executable_modification_time = 0;
+
+  Indexing * indexing = nullptr;        // Background indexing of debug info, while there is no debug index, see indexer.cpp
+  Array<Function_Range> function_index; // Sorted by low_pc, taken from indexing or read from the debug index on first lookup
+  Array<Function_Name> function_names;  // Sorted by name, taken from indexing when there is no debug index
+  Array<Pending_Breakpoint> pending_breakpoints;
+  Unwind_Table *unwind_table = nullptr; // Built on first unwinding
+  Type_Table *type_table = nullptr;     // Types parsed from DWARF on first use, cached by DIE offset
+  Locals_Cache *locals_cache = nullptr; // Local variables with parsed locations, cached by function DIE offset
+  Memory_Cache *memory_cache = nullptr; // Pages read during the current stop
+  Fork_Server *fork_server = nullptr;   // Parked copy of the program, which restarts fork from, see fork_server.cpp
+  Memory_Map memory_map;
+  Module_List modules;
+
+  // Names of symbols, frames and variables and paths of sources, they outlive unload and are freed by deinit
+  String_Pool strings;
+
+  Arena session_arena; // Types, local variables and breakpoints of the loaded executable, reset by unload
+  Arena stop_arena;    // Query results allocated by get_stop_allocator, reset when the process resumes
+  Array<Breakpoint *> free_breakpoints; // Removed breakpoints, reused by the new ones
+
+  char *demangle_buffer = nullptr; // Reused by every demangling, grown by __cxa_demangle
+  size_t demangle_buffer_size = 0;
+
+  Allocation_Counter stop_heap_allocations; // Heap counter at the start of the current stop
+  Stop_Allocations last_stop_allocations;
+
+  u64 stop_count = 0; // Incremented every time the process stops
+  Load_Timings load_timings;
+
+  Debugger_Stats stats;
+  u32 command_depth = 0; // Nesting of timed commands, only the outermost one is recorded
 
   u64 load_address = 0;
   bool verbose = false;
   bool autorestart_enabled = false;
+
+  // Autorestart forks the program parked at the entry of fork_server_function instead of executing it again.
+  // Breakpoints hit before that function aren't hit after restarts, stdin and stdout files are shared by restarts.
+  bool fork_server_enabled = false;
+  const char * fork_server_function = "main";
 };
 
 void init(Debugger * dbg);
 void deinit(Debugger * dbg);
 
 void debug(Debugger * dbg, const char * executable_path, const char * arguments);
+void debug(Debugger * dbg, const char * executable_path, Launch_Options options);
 void unload(Debugger * dbg);
 
 void attach(Debugger * dbg, u32 pid);
 void detach(Debugger * dbg);
 
+// Terminal of the program launched with use_pty. Both don't block, they return the number of bytes
+// read or written, which is zero when there is no terminal or nothing to read
+u64 read_program_output(Debugger * dbg, char * buffer, u64 size);
+u64 write_program_input(Debugger * dbg, const char * buffer, u64 size);
+
+// Local directory for separate debug files, SIMPDB_DEBUG_DIR or ~/.cache/simpdb/debug by default
+void set_debug_file_directory(Debugger * dbg, const char * path);
+
+// Saves index of debug info into the debug directory without running the program,
+// so the first session starts as fast as the following ones
+void build_debug_index(Debugger * dbg, const char * executable_path);
+
+// Debug info is indexed in the background after debug and attach, when there is no debug index.
+// Progress is false when indexing isn't running. Update sets pending breakpoints of the indexed
+// units and returns true when any was set, it should be called periodically by the debugger thread.
+bool get_indexing_progress(Debugger * dbg, u32 * indexed_units, u32 * total_units);
+bool update_indexing(Debugger * dbg);
+void wait_for_indexing(Debugger * dbg);
+
+// Durations of the loading phases of the last debug, attach or build_debug_index
+void print_load_timings(Debugger * dbg);
+
+// Queries given this allocator allocate their results from the stop arena, without freeing.
+// Results are valid until the process resumes, their arrays shouldn't be deinitialized.
+Allocator get_stop_allocator(Debugger * dbg);
+
+// Allocations of the last finished stop and of the current one so far
+void print_allocation_stats(Debugger * dbg);
+
+// Syscalls to the debugged process, DWARF lookups, cache hits and misses and wall time of commands,
+// counted since init or the last reset_stats. Owned by debugger.
+Debugger_Stats * get_stats(Debugger * dbg);
+void reset_stats(Debugger * dbg);
+void print_stats(Debugger * dbg);
+
+char * to_string(Ptrace_Counter counter);
+char * to_string(Stats_Cache cache);
+char * to_string(Stats_Command command);
+
 
 //
 // Reading and writing
@@ -112,8 +380,31 @@ void write_register(Debugger * dbg, Register reg, u64 value);
 u64 read_memory(Debugger * dbg, u64 address);
 void write_memory(Debugger * dbg, u64 address, u64 value);
 
+// Reads size bytes with a single syscall if possible. Returns false if memory couldn't be read completely.
+bool read_memory(Debugger * dbg, u64 address, void * buffer, u64 size);
+
+// Same, but through the page cache, which is dropped when the process runs or memory is written
+bool read_cached_memory(Debugger * dbg, u64 address, void * buffer, u64 size);
+
 void get_registers(Debugger * dbg, Array<u64> * register_values);
 
+//
+// Memory map
+//
+Memory_Map * get_memory_map(Debugger * dbg); // Owned by debugger, refreshed at most once per stop
+Memory_Region * find_memory_region(Debugger * dbg, u64 address);
+bool is_address_readable(Debugger * dbg, u64 address, u64 size);
+
+void print_memory_map(Memory_Map * map);
+
+//
+// Modules
+//
+Array<Module> * get_modules(Debugger * dbg); // Owned by debugger, updated when the dynamic linker reports changes
+Module * find_module(Debugger * dbg, u64 address);
+
+void print_modules(Array<Module> * modules);
+
 //
 // Location discovery
 //
@@ -140,8 +431,11 @@ Source_Location get_source_location(Debugger * dbg);
 Source_Context get_source_context(Debugger * dbg, u32 line_count = 3);
 Array<Source_File> get_updated_sources(Debugger * dbg);
 
-void print_source_location(Source_Location * location);
-void print_source_context(Source_Context * context);
+Source_File * find_source_file(Debugger * dbg, const char * file_path);
+bool load_source_file(Debugger * dbg, Source_File * file); // Returns false if file couldn't be read
+
+void print_source_location(Debugger * dbg, Source_Location * location);
+void print_source_context(Debugger * dbg, Source_Context * context);
 
 void print_current_source_location(Debugger * dbg);
 void print_current_source_context(Debugger * dbg, u32 line_count = 3);
@@ -222,12 +516,14 @@ Symbol_Type to_symbol_type(elf::stt symbol);
 
 struct Symbol {
   Symbol_Type type;
-  char *name = nullptr;
+  char *name = nullptr; // Interned
   u64 address;
 };
 
-void lookup_symbol(Debugger * dbg, const char * name, Array<Symbol> * symbol_table);
-void deinit(Array<Symbol> symbol_table); // Symbols table should be freed after the use
+// Output arrays of the queries are reused between calls. When they are given an allocator, like
+// get_stop_allocator, earlier results are dropped and the new ones are allocated by it instead.
+void lookup_symbol(Debugger * dbg, const char * name, Array<Symbol> * symbol_table, Allocator allocator = {});
+void deinit(Array<Symbol> symbol_table); // Symbols table should be freed after the use, names are owned by the debugger
 
 //
 // Stepping
@@ -245,41 +541,286 @@ void step_single_instruction(Debugger * dbg);
 // Stack trace
 //
 struct Frame {
-  char *function_name = nullptr;
+  char *function_name = nullptr; // Interned
   Source_Location location;
   u64 address;
+  u64 pc;  // Current instruction of the innermost frame, return address of the others
+  u64 cfa; // Canonical frame address, zero when frame couldn't be unwound
 };
 
-void get_stack_trace(Debugger * dbg, Array<Frame> * stack_trace);
+constexpr u32 max_stack_trace_depth = 256;
+
+void get_stack_trace(Debugger * dbg, Array<Frame> * stack_trace, Allocator allocator = {});
 void deinit(Array<Frame> stack_trace); // Stack trace should be freed after the use
 
 void print_stack_trace(Array<Frame> stack_trace);
 
+//
+// Types
+//
+enum class Type_Kind : u8 {
+  UNKNOWN,
+  BASE,
+  POINTER,
+  STRUCT,
+  UNION,
+  ARRAY,
+  ENUM,
+  TYPEDEF, // Also const, volatile and restrict qualified types
+  FUNCTION
+};
+
+enum class Base_Type_Encoding : u8 {
+  SIGNED,
+  UNSIGNED,
+  FLOAT,
+  BOOLEAN,
+  SIGNED_CHAR,
+  UNSIGNED_CHAR
+};
+
+struct Type_Member {
+  char *name = nullptr;
+  u64 offset;
+  Type *type = nullptr;
+
+  // Bitfields: bit_size bits starting at bit_offset of the little-endian value at offset
+  u32 bit_offset = 0; // Less than 8
+  u32 bit_size = 0;   // Zero for other members
+};
+
+struct Enumerator {
+  char *name = nullptr;
+  s64 value;
+};
+
+struct Type {
+  Type_Kind kind = Type_Kind::UNKNOWN;
+  char *name = nullptr;
+  u64 size = 0;
+
+  Base_Type_Encoding encoding = Base_Type_Encoding::SIGNED; // BASE and ENUM
+
+  Type *target = nullptr;      // Pointee of POINTER (null for void *), element of ARRAY, aliased type of TYPEDEF
+  u64 element_count = 0;       // ARRAY, multidimensional arrays are arrays of arrays
+
+  Array<Type_Member> members;  // STRUCT, UNION
+  Array<Enumerator> enumerators;
+};
+
+Type * resolve_typedefs(Type * type);
+
 //
 // Variables
 //
 enum class Variable_Location : u8 {
   MEMORY,
-  REGISTER
+  REGISTER,
+  VALUE,        // No storage, value is computed by location expression or constant
+  OPTIMIZED_OUT // Unavailable at current PC
 };
 
-// TODO: Maybe intern strings for variable and function names?
+// Variables bigger than this are read partially, their elements are read on expansion
+constexpr u64 max_variable_read_size = 4096;
+
 struct Variable {
-  char *name = nullptr;
-  u64 value;
+  char *name = nullptr; // Interned for locals and parameters, member name for struct members, null for array elements and pointer targets (see index)
+  u64 value;            // First bytes of the value, zero extended
   Variable_Location location;
 
   union {
     u64 address;
     Register reg;
   };
+
+  Type *type = nullptr;
+  u64 size = 0;
+  u64 index = 0;
+
+  u8 *data = nullptr; // Contents of the variable, min(size, max_variable_read_size) bytes
+  u64 data_size = 0;
+
+  u32 bit_offset = 0; // Bitfield members, value holds only their bits (see Type_Member)
+  u32 bit_size = 0;
+
+  bool is_parameter = false;
 };
 
-void get_variables(Debugger * dbg, Array<Variable> * variables);
+void get_variables(Debugger * dbg, Array<Variable> * variables, Allocator allocator = {});
+void get_variables(Debugger * dbg, u32 frame_index, Array<Variable> * variables, Allocator allocator = {}); // Locals and parameters of a frame from stack trace
 void deinit(Array<Variable> variables); // Varables should be freed after the use
 
+// Children are members of structs, elements of arrays and targets of pointers
+u64 get_child_count(Variable * variable);
+void get_variable_children(Debugger * dbg, Variable * parent, u64 first_child, u64 count, Array<Variable> * children, Allocator allocator = {});
+
+void format_variable_value(Variable * variable, char * buffer, u64 buffer_size);
+
+//
+// Watches
+//
+enum class Watch_Step_Type : u8 {
+  MEMBER,         // .name
+  POINTER_MEMBER, // ->name
+  INDEX,          // [index]
+  DEREFERENCE     // *
+};
+
+struct Watch_Step {
+  Watch_Step_Type type;
+  char *member_name = nullptr;
+  s64 index = 0;
+};
+
+struct Watch {
+  char *expression = nullptr;
+
+  // Parsed expression, steps are applied to the variable in order
+  char *variable_name = nullptr;
+  Array<Watch_Step> steps;
+
+  Variable result; // Named by the expression
+  bool is_valid = false;
+  const char *error = nullptr; // Why watch isn't valid
+
+  // Diff with the previous stop
+  bool has_changed = false;
+  bool has_previous = false;
+  bool was_valid = false;
+  u8 *previous_data = nullptr;
+  u64 previous_data_size = 0;
+  u64 evaluated_stop = 0;
+};
+
+void add_watch(Array<Watch> * watches, const char * expression);
+void remove_watch(Array<Watch> * watches, s32 index);
+void deinit(Array<Watch> watches);
+
+// Reevaluates all watches in scope of the innermost frame. Changes are detected only between stops,
+// so watches could be reevaluated any number of times during the same stop.
+void evaluate_watches(Debugger * dbg, Array<Watch> * watches);
+
+void print_watches(Array<Watch> watches);
+
 void print_variables(Array<Variable> variables);
 
+//
+// Profiling
+//
+struct Profile_Node {
+  char *function_name = nullptr;
+
+  u64 total_samples = 0; // Samples with this call path on the stack
+  u64 self_samples = 0;  // Samples with this call path on top of the stack
+
+  s32 parent = -1;
+  s32 first_child = -1;
+  s32 next_sibling = -1;
+};
+
+struct Profile {
+  Array<Profile_Node> nodes; // Call tree, nodes[0] is the root
+
+  u32 frequency = 0;
+  float64 duration = 0;
+  u64 sample_count = 0;
+  u64 lost_samples = 0;
+};
+
+enum class Profiler_Backend : u8 {
+  PTRACE,          // Stops the process to take every sample
+  PERF_CPU_CLOCK,  // Kernel samples into ring buffer without stopping the process
+  PERF_TASK_CLOCK,
+};
+
+// Samples stacks of the running process with given frequency (Hz) for given duration (seconds)
+void profile(Debugger * dbg, u32 frequency, float64 duration, Profile * result, Profiler_Backend backend = Profiler_Backend::PTRACE);
+void deinit(Profile * profile);
+
+void print_profile(Profile * profile);
+void export_folded_stacks(Profile * profile, const char * file_path);
+
+//
+// Function tracing
+//
+
+// Log-linear histogram of durations in nanoseconds (as in HdrHistogram):
+// each power of two range is split into equal sub-buckets, so relative
+// error of any recorded value is below 1 / latency_sub_bucket_count.
+constexpr u32 latency_sub_bucket_bits = 5;
+constexpr u32 latency_sub_bucket_count = 1 << latency_sub_bucket_bits;
+constexpr u32 latency_bucket_count = (64 - latency_sub_bucket_bits + 1) * latency_sub_bucket_count;
+
+struct Latency_Histogram {
+  u64 *counts = nullptr; // latency_bucket_count entries, allocated on the first record
+
+  u64 total_count = 0;
+  u64 min = 0;
+  u64 max = 0;
+  u64 sum = 0;
+};
+
+void record_latency(Latency_Histogram * histogram, u64 value);
+u64 get_latency_percentile(Latency_Histogram * histogram, float64 percentile);
+void deinit(Latency_Histogram * histogram);
+
+struct Traced_Function {
+  char *name = nullptr;
+  u64 address; // Entry address in the running process
+
+  Latency_Histogram latency;
+};
+
+struct Trace {
+  Array<Traced_Function> functions;
+
+  float64 duration = 0;
+  u64 unfinished_calls = 0; // Calls which didn't return during tracing or left by longjmp/exceptions
+};
+
+// Traces calls of functions with names matching glob pattern (e.g. "parse_*") for given duration (seconds)
+void trace_functions(Debugger * dbg, const char * pattern, float64 duration, Trace * result);
+void deinit(Trace * trace);
+
+void print_trace(Trace * trace);
+void export_trace_csv(Trace * trace, const char * file_path);
+
+//
+// Coverage
+//
+enum class Coverage_Line_State : u8 {
+  NO_CODE,
+  NOT_COVERED,
+  COVERED
+};
+
+struct Coverage_File {
+  char *file_path = nullptr;
+
+  Array<Coverage_Line_State> lines; // Indexed by line number
+
+  u32 lines_found = 0;
+  u32 lines_hit = 0;
+};
+
+struct Coverage {
+  Array<Coverage_File> files;
+
+  float64 duration = 0;
+  u64 probe_count = 0;
+  u64 probes_hit = 0;
+};
+
+// Runs the process with one-shot breakpoints on every statement of the line table
+// until it exits or given duration (seconds) passes
+void collect_coverage(Debugger * dbg, float64 duration, Coverage * result);
+void deinit(Coverage * coverage);
+
+Coverage_File * find_coverage_file(Coverage * coverage, const char * file_path);
+
+void print_coverage(Coverage * coverage);
+void export_lcov(Coverage * coverage, const char * file_path);
+
 DBG_NAMESPACE_END
 
 #endif
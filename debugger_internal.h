@@ -8,15 +8,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <fnmatch.h>
+#include <sys/uio.h>
+#include <link.h>
 
 #include <cxxabi.h>
+#include <system_error>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 #include "common.h"
 #include "defer.h"
 #include "Array.h"
 #include "Hash_Table.h"
+#include "Data_Cursor.h"
 
 #include "dwarf/dwarf++.hh"
 #include "elf/elf++.hh"
@@ -34,12 +54,158 @@
 // Debugger internal API
 DBG_NAMESPACE_BEGIN
 
+inline u64 get_monotonic_time_ns() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (u64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Stats. Syscalls to the debugged process go through these to be counted.
+inline Ptrace_Counter get_ptrace_counter(__ptrace_request request) {
+  switch (request) {
+  case PTRACE_PEEKDATA: case PTRACE_PEEKTEXT: case PTRACE_PEEKUSER:  return Ptrace_Counter::PEEK;
+  case PTRACE_POKEDATA: case PTRACE_POKETEXT: case PTRACE_POKEUSER:  return Ptrace_Counter::POKE;
+  case PTRACE_GETREGS:  case PTRACE_GETFPREGS:                       return Ptrace_Counter::GET_REGISTERS;
+  case PTRACE_SETREGS:  case PTRACE_SETFPREGS:                       return Ptrace_Counter::SET_REGISTERS;
+  case PTRACE_CONT:                                                  return Ptrace_Counter::CONTINUE;
+  case PTRACE_SINGLESTEP:                                            return Ptrace_Counter::SINGLE_STEP;
+  case PTRACE_GETSIGINFO:                                            return Ptrace_Counter::SIGNAL_INFO;
+  default:                                                           return Ptrace_Counter::OTHER;
+  }
+}
+
+template <typename Address, typename Data>
+inline long process_ptrace(Debugger *dbg, __ptrace_request request, u32 pid, Address address, Data data) {
+  dbg->stats.ptrace_calls[(u32)get_ptrace_counter(request)]++;
+  return ptrace(request, pid, address, data);
+}
+
+template <typename Address, typename Data>
+inline long debugee_ptrace(Debugger *dbg, __ptrace_request request, Address address, Data data) {
+  return process_ptrace(dbg, request, dbg->debugee_pid, address, data);
+}
+
+s32 process_waitpid(Debugger *dbg, u32 pid, s32 *wait_status, s32 options);
+s32 debugee_waitpid(Debugger *dbg, s32 *wait_status, s32 options);
+ssize_t debugee_read_memory(Debugger *dbg, iovec *local_buffers, iovec *remote_buffers, u64 buffer_count);
+
+inline void count_cache_access(Debugger *dbg, Stats_Cache cache, bool is_hit) {
+  if (is_hit) {
+    dbg->stats.cache_hits[(u32)cache]++;
+  } else {
+    dbg->stats.cache_misses[(u32)cache]++;
+  }
+}
+
+struct Command_Timer {
+  Stats_Command command;
+  u64 start_time;
+  Timeline_Zone zone; // Every command is a zone in the timeline, nested ones too
+};
+
+Command_Timer start_command_timer(Debugger *dbg, Stats_Command command);
+void end_command_timer(Debugger *dbg, Command_Timer *timer);
+
+// Wall time of the command is recorded when the scope is left, in the context of dbg pointer
+#define time_command(command) \
+  auto __command_timer = start_command_timer(dbg, command); \
+  defer { end_command_timer(dbg, &__command_timer); }
+
 u64 offset_load_address(Debugger *dbg, u64 addr);
 u64 offset_dwarf_address(Debugger *dbg, u64 addr);
 
 dwarf::line_table::iterator get_line_entry_from_pc(Debugger *dbg, u64 pc);
 dwarf::die get_function_from_pc(Debugger *dbg, u64 pc);
+Function_Range * find_function_range(Debugger *dbg, u64 pc);
+s32 compare_function_ranges(const void *a, const void *b);
 
 inline char * extract_file_name_from_path(char *file_path);
+inline u64 get_modification_time(struct stat *file_stat);
+inline char * get_function_name(dwarf::die function_die);
+
+void restart_or_finish_debug(Debugger *dbg);
+void kill_child_debugee(Debugger *dbg);
+
+u64 get_return_address(Debugger *dbg, u64 *cfa = nullptr);
+
+u64 get_bitfield_data_size(u32 bit_offset, u32 bit_size);
+void set_variable_value(Variable *variable);
+
+bool dwarf_register_to_register(u32 dwarf_register, Register *result);
+
+void invalidate_memory_cache(Debugger *dbg);
+void free_memory_cache(Debugger *dbg);
+void start_new_stop(Debugger *dbg);
+void end_stop(Debugger *dbg);
+
+void refresh_memory_map(Debugger *dbg);
+void deinit(Memory_Map *map);
+
+// Separate debug files
+char * find_debug_file(Debugger *dbg, const elf::elf &elf, const char *path, elf::elf *debug_elf);
+void set_default_debug_file_directory(Debugger *dbg);
+
+// Debug index
+s32 load_debug_info(Debugger *dbg);
+void load_sources(Debugger *dbg);
+void unload_sources(Debugger *dbg);
+void load_debug_index(Debugger *dbg);
+void write_debug_index(Debugger *dbg);
+void free_debug_index(Debugger *dbg);
+Unwind_Table * load_unwind_table_from_index(Debugger *dbg);
+void find_indexed_units(Debugger *dbg, const char *name, u64 name_length, Array<u32> *unit_indices);
+
+// Background indexing of compilation units
+void start_indexing(Debugger *dbg);
+void finish_indexing(Debugger *dbg);
+void free_indexing(Debugger *dbg);
+bool is_indexing(Debugger *dbg);
+inline bool is_unit_indexed(Debugger *dbg, u32 unit_index);
+void wait_for_unit(Debugger *dbg, u32 unit_index);
+void add_indexed_sources(Debugger *dbg);
+Function_Range * find_unit_function_range(Debugger *dbg, u64 pc);
+void find_units_indexed_so_far(Debugger *dbg, const char *name, u64 name_length, Array<u32> *unit_indices);
+
+// Breakpoints requested while indexing
+void add_pending_breakpoint(Debugger *dbg, const char *function_declaration, const char *file_name, u32 line);
+bool resolve_pending_breakpoints(Debugger *dbg);
+void free_pending_breakpoints(Debugger *dbg);
+
+// Launch and fork server restarts
+u32 launch_program(Debugger *dbg);
+bool restart_from_fork_server(Debugger *dbg);
+void stop_fork_server(Debugger *dbg);
+
+// Shared libraries
+void initialize_modules(Debugger *dbg);
+void handle_rendezvous(Debugger *dbg);
+void free_modules(Debugger *dbg);
+const char * find_module_function_name(Debugger *dbg, u64 address, u64 *function_address = nullptr);
+dwarf::dwarf * get_module_dwarf(Debugger *dbg, Module *module);
+
+// Unwinding
+constexpr u32 unwind_registers_count = 17; // DWARF registers rax..r15 and return address
+constexpr u32 unwind_frame_pointer_register = 6;
+constexpr u32 unwind_stack_pointer_register = 7;
+constexpr u32 unwind_return_address_register = 16;
+
+struct Unwind_Registers {
+  u64 values[unwind_registers_count]; // Indexed by DWARF register number
+  u32 valid_mask;
+};
+
+void get_unwind_registers(Debugger *dbg, Unwind_Registers *registers);
+bool unwind_frame(Debugger *dbg, Unwind_Registers *registers, bool is_caller_frame, u64 *cfa);
+void unwind_stack(Debugger *dbg, Array<u64> *addresses, u32 max_depth);
+void free_unwind_table(Debugger *dbg);
+Unwind_Table * build_unwind_table(Debugger *dbg, const elf::elf &elf);
+Unwind_Table * get_module_unwind_table(Debugger *dbg, Module *module);
+
+// Types
+Type * get_type(Debugger *dbg, const dwarf::die &type_die);
+void free_type_table(Debugger *dbg);
+
+// Locations of variables
+void free_locals_cache(Debugger *dbg);
 
 DBG_NAMESPACE_END
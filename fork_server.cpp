@@ -0,0 +1,259 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Fork server
+//
+// Autorestart with fork_server_enabled doesn't execute the program again. A copy of the program is launched
+// on the first restart and parked at the entry of fork_server_function, past static initialization and
+// loading of libraries. Every restart makes the parked process call clone, and the clone becomes the debugged
+// process: it's a child of the debugger (CLONE_PARENT), traced from the start (PTRACE_O_TRACEFORK of the server),
+// and breakpoints are put into it by their addresses, without going through debug info again.
+//
+
+struct Fork_Server {
+  u32 pid = 0;
+  u64 park_address = 0;
+  user_regs_struct registers;           // At the entry of the park function
+  u64 executable_modification_time = 0; // Parked program is replaced, when the executable is rebuilt
+};
+
+constexpr u64 syscall_int3_instructions = 0xcc050f; // syscall; int3
+
+// Exact name in the symbol tables of the executable and its debug file
+u64 find_executable_function_address(Debugger *dbg, const char *name) {
+  const elf::elf *symbol_files[] = { &dbg->elf, &dbg->debug_elf };
+  s32 symbol_file_count = (strcmp(dbg->debug_file_path, dbg->executable_path) == 0) ? 1 : 2;
+
+  For_Count (symbol_file_count, file_index) {
+    for (auto &section : symbol_files[file_index]->sections()) {
+      auto type = section.get_hdr().type;
+      if (type != elf::sht::symtab && type != elf::sht::dynsym)  continue;
+
+      for (auto sym : section.as_symtab()) {
+        auto &data = sym.get_data();
+        if (data.value != 0 && data.type() == elf::stt::func && strcmp(sym.get_name(nullptr), name) == 0) {
+          return offset_dwarf_address(dbg, data.value);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+u64 get_executable_modification_time(Debugger *dbg) {
+  struct stat executable_stat;
+  if (stat(dbg->executable_path, &executable_stat) != 0)  return 0;
+  return get_modification_time(&executable_stat);
+}
+
+// Signals on the way to a trap are passed to the server. False when it has exited.
+bool wait_for_server_trap(Debugger *dbg, u32 pid, s32 *wait_status) {
+  while (true) {
+    if (process_waitpid(dbg, pid, wait_status, __WALL) <= 0)  return false;
+    if (!WIFSTOPPED(*wait_status))  return false;
+
+    auto signal = WSTOPSIG(*wait_status);
+    if (signal == SIGTRAP)  return true;
+
+    process_ptrace(dbg, PTRACE_CONT, pid, nullptr, (void *)(u64)signal);
+  }
+}
+
+void stop_fork_server(Debugger *dbg) {
+  auto server = dbg->fork_server;
+  if (!server)  return;
+
+  if (server->pid) {
+    kill(server->pid, SIGKILL);
+    s32 wait_status;
+    waitpid(server->pid, &wait_status, __WALL);
+  }
+
+  delete server;
+  dbg->fork_server = nullptr;
+}
+
+bool start_fork_server(Debugger *dbg) {
+  timeline_zone("start fork server");
+
+  auto park_address = find_executable_function_address(dbg, dbg->fork_server_function);
+  if (!park_address) {
+    dbg_fail("function to park the fork server at isn't found");
+    return false;
+  }
+
+  auto server = new Fork_Server();
+  server->park_address = park_address;
+  server->executable_modification_time = get_executable_modification_time(dbg);
+  dbg->fork_server = server;
+
+  server->pid = launch_program(dbg);
+  if (!server->pid) {
+    stop_fork_server(dbg);
+    return false;
+  }
+
+  // Stop at exec
+  s32 wait_status;
+  bool is_parked = wait_for_server_trap(dbg, server->pid, &wait_status);
+
+  if (is_parked) {
+    process_ptrace(dbg, PTRACE_SETOPTIONS, server->pid, nullptr, (void *)(u64)(PTRACE_O_TRACEFORK | PTRACE_O_EXITKILL));
+
+    // Running to a temporary int3 at the entry of the park function
+    auto word = (u64)process_ptrace(dbg, PTRACE_PEEKDATA, server->pid, park_address, nullptr);
+    process_ptrace(dbg, PTRACE_POKEDATA, server->pid, park_address, (word & ~0xffull) | 0xcc);
+    process_ptrace(dbg, PTRACE_CONT, server->pid, nullptr, nullptr);
+
+    is_parked = wait_for_server_trap(dbg, server->pid, &wait_status);
+    if (is_parked) {
+      process_ptrace(dbg, PTRACE_POKEDATA, server->pid, park_address, word);
+      process_ptrace(dbg, PTRACE_GETREGS, server->pid, nullptr, &server->registers);
+
+      is_parked = (server->registers.rip == park_address + 1);
+      server->registers.rip = park_address;
+      process_ptrace(dbg, PTRACE_SETREGS, server->pid, nullptr, &server->registers);
+    }
+  }
+
+  if (!is_parked) {
+    stop_fork_server(dbg);
+    dbg_fail("program hasn't reached the function to park the fork server at");
+    return false;
+  }
+
+  return true;
+}
+
+// Returns pid of the clone stopped at the entry of the park function, or zero on failure
+u32 fork_from_server(Debugger *dbg) {
+  timeline_zone("fork from server");
+
+  auto server = dbg->fork_server;
+  auto pid = server->pid;
+
+  // Parked process executes clone from the park address, then stops at int3 right after it
+  auto word = (u64)process_ptrace(dbg, PTRACE_PEEKDATA, pid, server->park_address, nullptr);
+  process_ptrace(dbg, PTRACE_POKEDATA, pid, server->park_address, (word & ~0xffffffull) | syscall_int3_instructions);
+
+  auto registers = server->registers;
+  registers.rax = SYS_clone;
+  registers.rdi = CLONE_PARENT | SIGCHLD; // Flags
+  registers.rsi = 0;                      // Stack, the same one copied on write
+  registers.rdx = 0;
+  registers.r10 = 0;
+  registers.r8 = 0;
+  registers.orig_rax = -1;                // Not in a system call, nothing to restart
+  process_ptrace(dbg, PTRACE_SETREGS, pid, nullptr, &registers);
+  process_ptrace(dbg, PTRACE_CONT, pid, nullptr, nullptr);
+
+  u32 clone_pid = 0;
+  s32 wait_status;
+  if (wait_for_server_trap(dbg, pid, &wait_status) && (wait_status >> 16) == PTRACE_EVENT_FORK) {
+    unsigned long event_message = 0;
+    process_ptrace(dbg, PTRACE_GETEVENTMSG, pid, nullptr, &event_message);
+    clone_pid = (u32)event_message;
+
+    process_ptrace(dbg, PTRACE_CONT, pid, nullptr, nullptr);
+    if (!wait_for_server_trap(dbg, pid, &wait_status))  server->pid = 0;
+  } else {
+    server->pid = 0;
+  }
+
+  if (!server->pid) {
+    // Server is gone, the clone, if there is one, isn't usable without it
+    if (clone_pid)  kill(clone_pid, SIGKILL);
+    return 0;
+  }
+
+  // Parked process is put back to the park address
+  process_ptrace(dbg, PTRACE_POKEDATA, pid, server->park_address, word);
+  process_ptrace(dbg, PTRACE_SETREGS, pid, nullptr, &server->registers);
+
+  // Clone starts with SIGSTOP, right after the system call, with the instructions in its memory
+  if (!clone_pid || process_waitpid(dbg, clone_pid, &wait_status, __WALL) <= 0 || !WIFSTOPPED(wait_status))  return 0;
+
+  // Options are inherited from the server, forks of the program itself aren't followed like in a launched one
+  process_ptrace(dbg, PTRACE_SETOPTIONS, clone_pid, nullptr, (void *)(u64)PTRACE_O_EXITKILL);
+  process_ptrace(dbg, PTRACE_POKEDATA, clone_pid, server->park_address, word);
+  process_ptrace(dbg, PTRACE_SETREGS, clone_pid, nullptr, &server->registers);
+
+  return clone_pid;
+}
+
+s32 compare_breakpoint_addresses(const void *a, const void *b) {
+  auto first = (*(Breakpoint **)a)->address;
+  auto second = (*(Breakpoint **)b)->address;
+  if (first < second)  return -1;
+  if (first > second)  return 1;
+  return 0;
+}
+
+// Addresses are the same in every clone, so no lookups in debug info
+void insert_breakpoints_by_address(Debugger *dbg) {
+  Array<Breakpoint *> enabled_breakpoints;
+  enabled_breakpoints.init();
+  defer { enabled_breakpoints.deinit(); };
+
+  For (dbg->breakpoints) {
+    if (it->enabled)  enabled_breakpoints.add(it);
+  }
+
+  auto rendezvous_breakpoint = dbg->modules.rendezvous_breakpoint;
+  if (rendezvous_breakpoint && rendezvous_breakpoint->enabled)  enabled_breakpoints.add(rendezvous_breakpoint);
+
+  qsort(enabled_breakpoints.data, enabled_breakpoints.count, sizeof(Breakpoint *), compare_breakpoint_addresses);
+
+  Array<u64> addresses;
+  addresses.init();
+  defer { addresses.deinit(); };
+
+  Array<u8> saved_instructions;
+  saved_instructions.init();
+  defer { saved_instructions.deinit(); };
+
+  For (enabled_breakpoints) {
+    if (addresses.count == 0 || addresses[addresses.count - 1] != it->address)  addresses.add(it->address);
+  }
+
+  inject_int_instructions(dbg, &addresses, &saved_instructions);
+
+  s32 address_index = 0;
+  For (enabled_breakpoints) {
+    while (addresses[address_index] != it->address)  address_index++;
+    it->saved_instruction = saved_instructions[address_index];
+  }
+}
+
+bool restart_from_fork_server(Debugger *dbg) {
+  timeline_zone("restart from fork server");
+
+  // Rebuilt executable has to be launched again
+  if (dbg->fork_server && dbg->fork_server->executable_modification_time != get_executable_modification_time(dbg)) {
+    stop_fork_server(dbg);
+  }
+
+  if (!dbg->fork_server && !start_fork_server(dbg))  return false;
+
+  auto pid = fork_from_server(dbg);
+  if (!pid) {
+    stop_fork_server(dbg);
+    dbg_fail("couldn't fork from the fork server");
+    return false;
+  }
+
+  dbg->debugee_pid = pid;
+  start_new_stop(dbg);
+  refresh_memory_map(dbg);
+
+  insert_breakpoints_by_address(dbg);
+  initialize_modules(dbg);
+
+  dbg->state = Debugger_State::LOADED;
+  dbg_success();
+  return true;
+}
+
+DBG_NAMESPACE_END
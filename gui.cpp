@@ -1,4 +1,10 @@
 
+// Variables of expanded frames are reloaded on every stop
+struct Frame_Variables {
+  bool is_requested = false;
+  Array<dbg::Variable> variables;
+};
+
 struct Debugger_GUI {
   dbg::Debugger debugger;
   dbg::Debugger * d = &debugger;
@@ -8,7 +14,14 @@ struct Debugger_GUI {
 
   Array<dbg::Frame> m_stack_trace;
   Array<dbg::Variable> m_local_variables;
+  Array<Frame_Variables> m_frame_variables; // Parallel to m_stack_trace
+  Array<dbg::Watch> m_watches;
   Array<u64> m_register_values;
+  Array<char> m_program_output; // Read from the program terminal, null terminated
+
+  dbg::Profile m_profile;
+  dbg::Trace m_trace;
+  dbg::Coverage m_coverage;
 
   dbg::Debugger_State m_last_debugger_state = d->state;
 
@@ -18,17 +31,39 @@ struct Debugger_GUI {
     d->autorestart_enabled = true;
   }
 
+  void free_frame_variables() {
+    For_Pointer (m_frame_variables)  dbg::deinit(it->variables);
+    m_frame_variables.reset();
+  }
+
   void deinit_debugger() {
+    free_frame_variables();
+    m_frame_variables.deinit();
+    dbg::deinit(m_watches);
+    deinit(&m_profile);
+    deinit(&m_trace);
+    deinit(&m_coverage);
+    m_program_output.deinit();
     deinit(d);
   }
 
   void show_code_panel();
   void show_breakpoints_panel();
   void show_variables_panel();
+  void show_variable(dbg::Variable * variable, const char * label, bool is_changed = false);
+  void show_variable_children(dbg::Variable * parent, u64 first_child, u64 count);
+  void show_watches();
   void show_stack_panel();
   void show_register_panel();
   void show_symbols_panel();
   void show_memory_panel();
+  void show_profiler_panel();
+  void show_profile_node(s32 node_index);
+  void show_flame_graph_node(s32 node_index, ImVec2 origin, float32 x, float32 width, u32 depth);
+  void show_tracer_panel();
+  void show_coverage_panel();
+  void show_stats_panel();
+  void show_output_panel();
   void show_debugger_window();
 
   void update();
@@ -56,11 +91,22 @@ void Debugger_GUI::show_code_panel() {
       Array<bool> is_tab_open;
       is_tab_open.init(sources.count);
 
-      For_it (sources, source) {
+      For_it_Pointer (sources, source_pointer) {
+        auto &source = *source_pointer;
+
         ImGui::PushID(source.file_path);
         if (ImGui::BeginTabItem(source.file_name)) {
           ImGui::BeginChild("##file_content"); // Child for content scrollbar
 
+          // Only files of opened tabs are loaded
+          if (!dbg::load_source_file(d, source_pointer))  ImGui::TextDisabled("Couldn't read %s", source.file_path);
+
+          if (source.is_newer_than_executable) {
+            ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "Source file is newer than the executable, lines could mismatch");
+          }
+
+          auto coverage_file = dbg::find_coverage_file(&m_coverage, source.file_path);
+
           For_Range (1, source.lines.count + 1, line_number) {
             char line_number_buf[128];
             sprintf(line_number_buf, "%d", line_number);
@@ -85,6 +131,19 @@ void Debugger_GUI::show_code_panel() {
               }
             }
             
+            // Coverage gutter
+            if (coverage_file && line_number < coverage_file->lines.count) {
+              auto state = coverage_file->lines[line_number];
+              if (state != dbg::Coverage_Line_State::NO_CODE) {
+                const ImVec2 gutter_p = ImGui::GetCursorScreenPos();
+                const ImU32 covered_col = ImColor(ImVec4(0.2f, 0.8f, 0.2f, 1.0f));
+                const ImU32 uncovered_col = ImColor(ImVec4(0.8f, 0.2f, 0.2f, 1.0f));
+                ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(gutter_p.x - 6.0f, gutter_p.y),
+                                                          ImVec2(gutter_p.x - 2.0f, gutter_p.y + ImGui::GetFrameHeight()),
+                                                          state == dbg::Coverage_Line_State::COVERED ? covered_col : uncovered_col);
+              }
+            }
+
             if (ImGui::Button(line_number_buf)) {
               if (!breakpoint_exists_on_the_line) {
                 send_command(SET_BREAKPOINT, source.file_name, line_number);
@@ -190,63 +249,219 @@ void Debugger_GUI::show_breakpoints_panel() {
 
         ImGui::TableNextRow();
       }
+
+      // Requested while debug info is being indexed
+      For (d->pending_breakpoints) {
+        ImGui::TableNextColumn();
+        ImGui::TableNextColumn(); ImGui::TextDisabled("pending");
+        ImGui::TableNextColumn();
+        if (it.function_declaration) {
+          ImGui::TextDisabled("%s", it.function_declaration);
+        } else {
+          ImGui::TextDisabled("%s:%u", it.file_name, it.line);
+        }
+        ImGui::TableNextColumn();
+        ImGui::TableNextRow();
+      }
     }
     ImGui::EndTable();
   }
   ImGui::End();
 }
 
-void Debugger_GUI::show_variables_panel() {
-  if (ImGui::Begin("Local variables")) {
-    if (ImGui::BeginTable("##variables_table", 3)) {
-      // Header
-      ImGui::TableNextColumn(); ImGui::Text("Name");
-      ImGui::TableNextColumn(); ImGui::Text("Value");
-      ImGui::TableNextColumn(); ImGui::Text("Location");
+void Debugger_GUI::show_variable(dbg::Variable *variable, const char *label, bool is_changed) {
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+
+  auto child_count = dbg::get_child_count(variable);
+
+  ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth;
+  if (child_count == 0)  flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+
+  bool is_open = ImGui::TreeNodeEx(label, flags);
+
+  char value[128];
+  dbg::format_variable_value(variable, value, sizeof(value));
+
+  ImGui::TableNextColumn();
+  if (is_changed) {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", value);
+  } else {
+    ImGui::Text("%s", value);
+  }
+  ImGui::TableNextColumn(); ImGui::Text("%s", variable->type ? variable->type->name : "?");
+  ImGui::TableNextColumn();
+
+  switch (variable->location) {
+  case dbg::Variable_Location::REGISTER:
+    ImGui::Text("In register %s", dbg::register_to_string(variable->reg));
+    break;
+  case dbg::Variable_Location::MEMORY:
+    ImGui::Text("In memory at 0x%lx", variable->address);
+    break;
+  case dbg::Variable_Location::VALUE:
+    ImGui::Text("Computed value");
+    break;
+  case dbg::Variable_Location::OPTIMIZED_OUT:
+    ImGui::Text("Optimized out");
+    break;
+  }
+
+  if (is_open && child_count > 0) {
+    show_variable_children(variable, 0, child_count);
+    ImGui::TreePop();
+  }
+}
+
+void Debugger_GUI::show_variable_children(dbg::Variable *parent, u64 first_child, u64 count) {
+  constexpr u64 page_size = 100;
+
+  // Children are read only when their node is open, so huge arrays are split into
+  // nested ranges of at most page_size nodes each, and only opened ranges are read
+  if (count > page_size) {
+    u64 range_size = page_size;
+    while (range_size * page_size < count)  range_size *= page_size;
+
+    for (u64 range_start = first_child; range_start < first_child + count; range_start += range_size) {
+      auto range_end = range_start + range_size < first_child + count ? range_start + range_size : first_child + count;
+
+      char label[64];
+      sprintf(label, "[%lu..%lu]", range_start, range_end - 1);
+
       ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      if (ImGui::TreeNodeEx(label, ImGuiTreeNodeFlags_SpanFullWidth)) {
+        show_variable_children(parent, range_start, range_end - range_start);
+        ImGui::TreePop();
+      }
+    }
+    return;
+  }
 
-      For (m_local_variables) {
-        ImGui::TableNextColumn(); ImGui::Text("%s", it.name);
-        ImGui::TableNextColumn(); ImGui::Text("%d (0x%x)", it.value, it.value);
-        ImGui::TableNextColumn();
+  Array<dbg::Variable> children;
+  children.init();
+  defer { dbg::deinit(children); };
 
-        switch (it.location) {
-        case dbg::Variable_Location::REGISTER:
-          ImGui::Text("In register %d", dbg::register_to_string(it.reg));
-          break;
-        case dbg::Variable_Location::MEMORY:
-          ImGui::Text("In memory at 0x%lx", it.address);
-          break;
-        }
+  dbg::get_variable_children(d, parent, first_child, count, &children);
 
-        ImGui::TableNextRow();
+  auto parent_type = dbg::resolve_typedefs(parent->type);
+  bool is_pointer = (parent_type && parent_type->kind == dbg::Type_Kind::POINTER);
+
+  For_Pointer (children) {
+    char label[64];
+    if (it->name) {
+      show_variable(it, it->name);
+    } else {
+      if (is_pointer)  sprintf(label, "*");
+      else             sprintf(label, "[%lu]", it->index);
+      show_variable(it, label);
+    }
+  }
+}
+
+void Debugger_GUI::show_variables_panel() {
+  if (ImGui::Begin("Local variables")) {
+    if (ImGui::BeginTable("##variables_table", 4, ImGuiTableFlags_Resizable)) {
+      ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Value");
+      ImGui::TableSetupColumn("Type");
+      ImGui::TableSetupColumn("Location");
+      ImGui::TableHeadersRow();
+
+      For_Pointer (m_local_variables) {
+        show_variable(it, it->name);
       }
     }
     ImGui::EndTable();
+
+    show_watches();
   }
   ImGui::End();
 }
 
+void Debugger_GUI::show_watches() {
+  ImGui::Separator();
+  ImGui::Text("Watch");
+
+  static char expression[256];
+  bool expression_entered = ImGui::InputTextWithHint("##watch_expression", "buf->len, table[3].key, *p",
+                                                     expression, IM_ARRAYSIZE(expression), ImGuiInputTextFlags_EnterReturnsTrue);
+  ImGui::SameLine();
+  if ((ImGui::Button("Add watch") || expression_entered) && expression[0] != '\0') {
+    dbg::add_watch(&m_watches, expression);
+    expression[0] = '\0';
+    send_command(EVALUATE_WATCHES);
+  }
+
+  if (ImGui::BeginTable("##watch_table", 4, ImGuiTableFlags_Resizable)) {
+    ImGui::TableSetupColumn("Expression", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Value");
+    ImGui::TableSetupColumn("Type");
+    ImGui::TableSetupColumn("Location");
+    ImGui::TableHeadersRow();
+
+    s32 watch_to_remove = -1;
+
+    For_Count (m_watches.count, i) {
+      auto watch = &m_watches[i];
+      ImGui::PushID(i);
+
+      if (watch->is_valid) {
+        show_variable(&watch->result, watch->expression, watch->has_changed);
+      } else {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%s", watch->expression);
+        ImGui::TableNextColumn(); ImGui::TextDisabled("<%s>", watch->error ? watch->error : "not evaluated");
+      }
+
+      if (ImGui::BeginPopupContextItem("##watch_context")) {
+        if (ImGui::MenuItem("Remove"))  watch_to_remove = i;
+        ImGui::EndPopup();
+      }
+
+      ImGui::PopID();
+    }
+
+    if (watch_to_remove != -1)  dbg::remove_watch(&m_watches, watch_to_remove);
+  }
+  ImGui::EndTable();
+}
+
 void Debugger_GUI::show_stack_panel() {
   if (ImGui::Begin("Stack trace")) {
-    if (ImGui::BeginTable("##stack_table", 4)) {
+    if (ImGui::BeginTable("##stack_table", 4, ImGuiTableFlags_Resizable)) {
+      ImGui::TableSetupColumn("Function name / Variable", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Location / Value");
+      ImGui::TableSetupColumn("Address / Type");
+      ImGui::TableSetupColumn("Variable location");
+      ImGui::TableHeadersRow();
 
-      // Table header
-      ImGui::TableNextColumn(); ImGui::Text("#");
-      ImGui::TableNextColumn(); ImGui::Text("Function name");
-      ImGui::TableNextColumn(); ImGui::Text("Location");
-      ImGui::TableNextColumn(); ImGui::Text("Address");
-      ImGui::TableNextRow();
+      For_Count (m_stack_trace.count, frame_id) {
+        auto &frame = m_stack_trace[frame_id];
 
-      u32 frame_id = 0;
-      For (m_stack_trace) {
-        ImGui::TableNextColumn(); ImGui::Text("%d", frame_id);
-        ImGui::TableNextColumn(); ImGui::Text("%s", it.function_name);
-        ImGui::TableNextColumn(); ImGui::Text("%s:%d", it.location.file_name, it.location.line);
-        ImGui::TableNextColumn(); ImGui::Text("0x%lx", it.address);
         ImGui::TableNextRow();
+        ImGui::TableNextColumn();
 
-        frame_id++;
+        char label[256];
+        snprintf(label, sizeof(label), "#%d %s", frame_id, frame.function_name);
+
+        bool is_open = ImGui::TreeNodeEx(label, ImGuiTreeNodeFlags_SpanFullWidth);
+
+        ImGui::TableNextColumn(); ImGui::Text("%s:%lu", frame.location.file_name, frame.location.line);
+        ImGui::TableNextColumn(); ImGui::Text("0x%lx", frame.pc);
+
+        if (is_open) {
+          // Variables are loaded by the debugger thread, as unwinding of registers requires ptrace
+          bool is_loaded = (frame_id < m_frame_variables.count && m_frame_variables[frame_id].is_requested);
+          if (!is_loaded) {
+            send_command(LOAD_FRAME_VARIABLES, (Debugger_Frame_Arguments){(u32)frame_id});
+          } else {
+            For_Pointer (m_frame_variables[frame_id].variables) {
+              show_variable(it, it->name);
+            }
+          }
+          ImGui::TreePop();
+        }
       }
 
     }
@@ -315,7 +530,453 @@ void Debugger_GUI::show_symbols_panel() {
   ImGui::End();
 }
 
-void Debugger_GUI::show_memory_panel() { }
+void Debugger_GUI::show_memory_panel() {
+  if (ImGui::Begin("Memory")) {
+    if (d->state != dbg::Debugger_State::RUNNING) {
+      ImGui::TextDisabled("Program isn't running");
+      ImGui::End();
+      return;
+    }
+
+    static u64 view_address = 0;
+    static char address_text[32];
+
+    bool address_entered = ImGui::InputTextWithHint("##memory_address", "address (hex)", address_text, IM_ARRAYSIZE(address_text),
+                                                    ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    if (ImGui::Button("Go") || address_entered)  view_address = strtoull(address_text, nullptr, 16);
+
+    // @Note: Memory is read through the page cache with process_vm_readv, which doesn't require the tracer thread
+    constexpr u32 bytes_per_row = 16;
+    constexpr u32 row_count = 16;
+    u8 bytes[bytes_per_row * row_count];
+
+    // Map is refreshed first, so the region stays valid during drawing
+    auto map = dbg::get_memory_map(d);
+    auto region = dbg::find_memory_region(d, view_address);
+    if (region) {
+      ImGui::Text("Region 0x%lx-0x%lx %s", region->start, region->end, region->path ? region->path : "[anonymous]");
+    } else {
+      ImGui::TextDisabled("Address isn't mapped");
+    }
+
+    if (region && dbg::read_cached_memory(d, view_address, bytes, sizeof(bytes))) {
+      For_Count (row_count, row) {
+        char line[128];
+        auto c = line;
+        auto row_bytes = bytes + row * bytes_per_row;
+
+        c += sprintf(c, "%016lx  ", view_address + row * bytes_per_row);
+        For_Count (bytes_per_row, i)  c += sprintf(c, "%02x ", row_bytes[i]);
+        c += sprintf(c, " ");
+        For_Count (bytes_per_row, i)  *c++ = (row_bytes[i] >= 32 && row_bytes[i] < 127) ? row_bytes[i] : '.';
+        *c = '\0';
+
+        ImGui::TextUnformatted(line);
+      }
+    }
+
+    ImGui::Separator();
+
+    auto modules = dbg::get_modules(d);
+    if (modules && ImGui::CollapsingHeader("Modules")) {
+      For_Pointer (*modules) {
+        char label[512];
+        snprintf(label, sizeof(label), "%lx-%lx  %s%s", it->start, it->end, it->name, it->is_main ? " (main)" : "");
+
+        if (ImGui::Selectable(label, view_address >= it->start && view_address < it->end)) {
+          view_address = it->start;
+          sprintf(address_text, "%lx", view_address);
+        }
+        if (ImGui::IsItemHovered())  ImGui::SetTooltip("%s\nload bias 0x%lx", it->path, it->load_bias);
+      }
+    }
+
+    if (map && ImGui::BeginTable("##memory_map_table", 4, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+      ImGui::TableSetupColumn("Range");
+      ImGui::TableSetupColumn("Permissions");
+      ImGui::TableSetupColumn("Offset");
+      ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableHeadersRow();
+
+      For_Pointer (map->regions) {
+        char range[64];
+        sprintf(range, "%lx-%lx", it->start, it->end);
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (ImGui::Selectable(range, region == it, ImGuiSelectableFlags_SpanAllColumns)) {
+          view_address = it->start;
+          sprintf(address_text, "%lx", view_address);
+        }
+
+        ImGui::TableNextColumn();
+        ImGui::Text("%c%c%c%c", (it->permissions & dbg::MEMORY_READ)    ? 'r' : '-',
+                                (it->permissions & dbg::MEMORY_WRITE)   ? 'w' : '-',
+                                (it->permissions & dbg::MEMORY_EXECUTE) ? 'x' : '-',
+                                (it->permissions & dbg::MEMORY_SHARED)  ? 's' : 'p');
+        ImGui::TableNextColumn(); ImGui::Text("%lx", it->offset);
+        ImGui::TableNextColumn(); ImGui::Text("%s", it->path ? it->path : "");
+      }
+
+      ImGui::EndTable();
+    }
+  }
+  ImGui::End();
+}
+
+void Debugger_GUI::show_profile_node(s32 node_index) {
+  auto &node = m_profile.nodes[node_index];
+  auto percent = 100.0 * node.total_samples / m_profile.sample_count;
+
+  ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth;
+  if (node.first_child == -1)  flags |= ImGuiTreeNodeFlags_Leaf;
+
+  ImGui::TableNextRow();
+  ImGui::TableNextColumn();
+  bool is_open = ImGui::TreeNodeEx((void *)(intptr_t)node_index, flags, "%s", node.function_name);
+  ImGui::TableNextColumn(); ImGui::Text("%.1f%%", percent);
+  ImGui::TableNextColumn(); ImGui::Text("%lu", node.total_samples);
+  ImGui::TableNextColumn(); ImGui::Text("%lu", node.self_samples);
+
+  if (is_open) {
+    auto child = node.first_child;
+    while (child != -1) {
+      show_profile_node(child);
+      child = m_profile.nodes[child].next_sibling;
+    }
+    ImGui::TreePop();
+  }
+}
+
+void Debugger_GUI::show_flame_graph_node(s32 node_index, ImVec2 origin, float32 x, float32 width, u32 depth) {
+  const float32 row_height = ImGui::GetTextLineHeightWithSpacing();
+  if (width < 1.0f)  return;
+
+  auto &node = m_profile.nodes[node_index];
+
+  ImVec2 min = ImVec2(origin.x + x, origin.y + depth * row_height);
+  ImVec2 max = ImVec2(min.x + width - 1.0f, min.y + row_height - 1.0f);
+
+  // Stable color per function name, in warm flame palette
+  u32 name_hash = MurmurHash2(node.function_name, strlen(node.function_name), HASH_SEED);
+  auto color = ImColor(ImVec4(0.8f + (name_hash & 0xff) / 1280.0f, 0.3f + ((name_hash >> 8) & 0xff) / 512.0f, 0.1f, 1.0f));
+
+  ImDrawList* draw_list = ImGui::GetWindowDrawList();
+  draw_list->AddRectFilled(min, max, color);
+  draw_list->PushClipRect(min, max, true);
+  draw_list->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_BLACK, node.function_name);
+  draw_list->PopClipRect();
+
+  if (ImGui::IsMouseHoveringRect(min, max)) {
+    ImGui::SetTooltip("%s\n%lu samples (%.1f%%)", node.function_name, node.total_samples, 100.0 * node.total_samples / m_profile.sample_count);
+  }
+
+  auto child = node.first_child;
+  float32 child_x = x;
+  while (child != -1) {
+    auto child_width = width * m_profile.nodes[child].total_samples / node.total_samples;
+    show_flame_graph_node(child, origin, child_x, child_width, depth + 1);
+    child_x += child_width;
+    child = m_profile.nodes[child].next_sibling;
+  }
+}
+
+void Debugger_GUI::show_profiler_panel() {
+  if (ImGui::Begin("Profiler")) {
+    static u32 frequency = 1000;
+    static float64 duration = 1.0;
+    static char export_path[256] = "profile.folded";
+    static s32 backend_index = 0;
+
+    ImGui::SetNextItemWidth(200.0f);
+    ImGui::Combo("##profiler_backend", &backend_index, "ptrace (stops process)\0perf cpu-clock\0perf task-clock\0");
+    ImGui::SameLine();
+
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::InputScalar("Hz", ImGuiDataType_U32, &frequency);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::InputDouble("seconds", &duration, 0.0, 0.0, "%.2f");
+    ImGui::SameLine();
+
+    bool is_debugger_running = (d->state == dbg::Debugger_State::RUNNING);
+    if (!is_debugger_running)  ImGui::BeginDisabled();
+    if (ImGui::Button("Profile")) {
+      send_command(PROFILE, frequency, duration, (dbg::Profiler_Backend)backend_index);
+    }
+    if (!is_debugger_running)  ImGui::EndDisabled();
+
+    if (m_profile.sample_count > 0) {
+      ImGui::Text("%lu samples in %.2f s (%lu lost)", m_profile.sample_count, m_profile.duration, m_profile.lost_samples);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(200.0f);
+      ImGui::InputText("##export_path", export_path, IM_ARRAYSIZE(export_path));
+      ImGui::SameLine();
+      if (ImGui::Button("Export folded stacks")) {
+        dbg::export_folded_stacks(&m_profile, export_path);
+      }
+
+      if (ImGui::CollapsingHeader("Flame graph", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto origin = ImGui::GetCursorScreenPos();
+        auto width = ImGui::GetContentRegionAvail().x;
+
+        u32 max_depth = 0;
+        For_Pointer (m_profile.nodes) {
+          u32 depth = 0;
+          auto parent = it->parent;
+          while (parent != -1) { depth++; parent = m_profile.nodes[parent].parent; }
+          if (depth > max_depth)  max_depth = depth;
+        }
+
+        show_flame_graph_node(0, origin, 0.0f, width, 0);
+        ImGui::Dummy(ImVec2(width, (max_depth + 1) * ImGui::GetTextLineHeightWithSpacing()));
+      }
+
+      if (ImGui::CollapsingHeader("Call tree", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (ImGui::BeginTable("##profile_table", 4, ImGuiTableFlags_Resizable)) {
+          ImGui::TableSetupColumn("Function", ImGuiTableColumnFlags_WidthStretch);
+          ImGui::TableSetupColumn("Total %");
+          ImGui::TableSetupColumn("Total");
+          ImGui::TableSetupColumn("Self");
+          ImGui::TableHeadersRow();
+
+          auto child = m_profile.nodes[0].first_child;
+          while (child != -1) {
+            show_profile_node(child);
+            child = m_profile.nodes[child].next_sibling;
+          }
+        }
+        ImGui::EndTable();
+      }
+    }
+  }
+  ImGui::End();
+}
+
+void Debugger_GUI::show_tracer_panel() {
+  if (ImGui::Begin("Tracer")) {
+    static char pattern[256] = "*";
+    static float64 duration = 1.0;
+    static char export_path[256] = "trace.csv";
+
+    ImGui::SetNextItemWidth(200.0f);
+    ImGui::InputText("pattern", pattern, IM_ARRAYSIZE(pattern));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::InputDouble("seconds", &duration, 0.0, 0.0, "%.2f");
+    ImGui::SameLine();
+
+    bool is_debugger_running = (d->state == dbg::Debugger_State::RUNNING);
+    if (!is_debugger_running)  ImGui::BeginDisabled();
+    if (ImGui::Button("Trace")) {
+      send_command(TRACE, (Debugger_Trace_Arguments){pattern, duration});
+    }
+    if (!is_debugger_running)  ImGui::EndDisabled();
+
+    if (m_trace.functions.count > 0) {
+      ImGui::Text("%d functions in %.2f s (%lu unfinished calls)", m_trace.functions.count, m_trace.duration, m_trace.unfinished_calls);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(200.0f);
+      ImGui::InputText("##trace_export_path", export_path, IM_ARRAYSIZE(export_path));
+      ImGui::SameLine();
+      if (ImGui::Button("Export CSV")) {
+        dbg::export_trace_csv(&m_trace, export_path);
+      }
+
+      if (ImGui::BeginTable("##trace_table", 7, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+        ImGui::TableSetupColumn("Function", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Mean, us");
+        ImGui::TableSetupColumn("p50, us");
+        ImGui::TableSetupColumn("p90, us");
+        ImGui::TableSetupColumn("p99, us");
+        ImGui::TableSetupColumn("Max, us");
+        ImGui::TableHeadersRow();
+
+        For_Pointer (m_trace.functions) {
+          auto latency = &it->latency;
+          if (latency->total_count == 0)  continue;
+
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn(); ImGui::Text("%s", it->name);
+          ImGui::TableNextColumn(); ImGui::Text("%lu", latency->total_count);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", latency->sum / 1000.0 / latency->total_count);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", dbg::get_latency_percentile(latency, 50) / 1000.0);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", dbg::get_latency_percentile(latency, 90) / 1000.0);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", dbg::get_latency_percentile(latency, 99) / 1000.0);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", latency->max / 1000.0);
+        }
+        ImGui::EndTable();
+      }
+    }
+  }
+  ImGui::End();
+}
+
+void Debugger_GUI::show_coverage_panel() {
+  if (ImGui::Begin("Coverage")) {
+    static float64 duration = 1.0;
+    static char export_path[256] = "coverage.info";
+
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::InputDouble("seconds", &duration, 0.0, 0.0, "%.2f");
+    ImGui::SameLine();
+
+    bool is_debugger_running = (d->state == dbg::Debugger_State::RUNNING);
+    if (!is_debugger_running)  ImGui::BeginDisabled();
+    if (ImGui::Button("Collect coverage")) {
+      send_command(COLLECT_COVERAGE, (Debugger_Coverage_Arguments){duration});
+    }
+    if (!is_debugger_running)  ImGui::EndDisabled();
+
+    if (m_coverage.files.count > 0) {
+      ImGui::Text("%lu of %lu probes hit in %.2f s", m_coverage.probes_hit, m_coverage.probe_count, m_coverage.duration);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(200.0f);
+      ImGui::InputText("##coverage_export_path", export_path, IM_ARRAYSIZE(export_path));
+      ImGui::SameLine();
+      if (ImGui::Button("Export lcov")) {
+        dbg::export_lcov(&m_coverage, export_path);
+      }
+
+      if (ImGui::BeginTable("##coverage_table", 3, ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+        ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Lines");
+        ImGui::TableSetupColumn("Covered %");
+        ImGui::TableHeadersRow();
+
+        For_Pointer (m_coverage.files) {
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn(); ImGui::Text("%s", it->file_path);
+          ImGui::TableNextColumn(); ImGui::Text("%u/%u", it->lines_hit, it->lines_found);
+          ImGui::TableNextColumn(); ImGui::Text("%.1f", it->lines_found ? 100.0 * it->lines_hit / it->lines_found : 0.0);
+        }
+        ImGui::EndTable();
+      }
+    }
+  }
+  ImGui::End();
+}
+
+void Debugger_GUI::show_stats_panel() {
+  if (ImGui::Begin("Stats")) {
+    auto stats = dbg::get_stats(d);
+
+    ImGui::Text("Counted for %.1f s", (dbg::get_monotonic_time_ns() - stats->reset_time) / 1000000000.0);
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+      dbg::reset_stats(d);
+    }
+
+    ImGui::Text("waitpid %lu (%lu stops), process_vm_readv %lu", stats->waitpid_calls, stats->stops, stats->memory_reads);
+    ImGui::Text("Bytes read %lu, written %lu", stats->bytes_read, stats->bytes_written);
+    ImGui::Text("DWARF lookups %lu", stats->dwarf_lookups);
+
+    // Timeline of both threads, recorded zones are exported as Chrome trace JSON
+    static char timeline_path[256] = "timeline.json";
+    bool is_timeline_enabled = timeline_enabled;
+    if (ImGui::Checkbox("Record timeline", &is_timeline_enabled)) {
+      set_timeline_enabled(is_timeline_enabled);
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(200.0f);
+    ImGui::InputText("##timeline_path", timeline_path, IM_ARRAYSIZE(timeline_path));
+    ImGui::SameLine();
+    if (ImGui::Button("Export timeline")) {
+      export_timeline(timeline_path);
+    }
+
+    if (ImGui::BeginTable("##ptrace_table", 2, ImGuiTableFlags_Resizable)) {
+      ImGui::TableSetupColumn("ptrace request", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Calls");
+      ImGui::TableHeadersRow();
+
+      For_Count ((s32)dbg::Ptrace_Counter::COUNT, i) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%s", dbg::to_string((dbg::Ptrace_Counter)i));
+        ImGui::TableNextColumn(); ImGui::Text("%lu", stats->ptrace_calls[i]);
+      }
+      ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("##cache_table", 4, ImGuiTableFlags_Resizable)) {
+      ImGui::TableSetupColumn("Cache", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Hits");
+      ImGui::TableSetupColumn("Misses");
+      ImGui::TableSetupColumn("Hit %");
+      ImGui::TableHeadersRow();
+
+      For_Count ((s32)dbg::Stats_Cache::COUNT, i) {
+        auto accesses = stats->cache_hits[i] + stats->cache_misses[i];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%s", dbg::to_string((dbg::Stats_Cache)i));
+        ImGui::TableNextColumn(); ImGui::Text("%lu", stats->cache_hits[i]);
+        ImGui::TableNextColumn(); ImGui::Text("%lu", stats->cache_misses[i]);
+        ImGui::TableNextColumn(); ImGui::Text("%.1f", accesses ? 100.0 * stats->cache_hits[i] / accesses : 0.0);
+      }
+      ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("##command_table", 4, ImGuiTableFlags_Resizable)) {
+      ImGui::TableSetupColumn("Command", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Count");
+      ImGui::TableSetupColumn("Mean ms");
+      ImGui::TableSetupColumn("Max ms");
+      ImGui::TableHeadersRow();
+
+      For_Count ((s32)dbg::Stats_Command::COUNT, i) {
+        auto timing = &stats->commands[i];
+        if (timing->count == 0)  continue;
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::Text("%s", dbg::to_string((dbg::Stats_Command)i));
+        ImGui::TableNextColumn(); ImGui::Text("%lu", timing->count);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", timing->total_time / 1000000.0 / timing->count);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", timing->max_time / 1000000.0);
+      }
+      ImGui::EndTable();
+    }
+  }
+  ImGui::End();
+}
+
+void Debugger_GUI::show_output_panel() {
+  // Output is read on every frame, reading the terminal doesn't need the debugger thread
+  char buffer[4096];
+  while (auto bytes_read = dbg::read_program_output(d, buffer, sizeof(buffer))) {
+    if (m_program_output.count > 0)  m_program_output.count--; // Terminator
+    For_Count (bytes_read, i) {
+      if (buffer[i] != '\r')  m_program_output.add(buffer[i]);
+    }
+    m_program_output.add('\0');
+  }
+
+  if (ImGui::Begin("Output")) {
+    if (ImGui::Button("Clear")) {
+      m_program_output.reset();
+    }
+
+    ImGui::SameLine();
+    static char input[256] = "";
+    ImGui::SetNextItemWidth(-1.0f);
+    if (ImGui::InputTextWithHint("##program_input", "program input", input, IM_ARRAYSIZE(input), ImGuiInputTextFlags_EnterReturnsTrue)) {
+      auto length = strlen(input);
+      input[length] = '\n';
+      dbg::write_program_input(d, input, length + 1);
+      input[0] = '\0';
+      ImGui::SetKeyboardFocusHere(-1);
+    }
+
+    ImGui::BeginChild("##output_text");
+    if (m_program_output.count > 0) {
+      ImGui::TextUnformatted(m_program_output.data, m_program_output.data + m_program_output.count - 1);
+    }
+    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())  ImGui::SetScrollHereY(1.0f);
+    ImGui::EndChild();
+  }
+  ImGui::End();
+}
 
 void Debugger_GUI::show_debugger_window() {
   ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
@@ -346,8 +1007,44 @@ void Debugger_GUI::show_debugger_window() {
         if (ImGui::InputTextWithHint("##arguments", "program arguments", debug_arguments, IM_ARRAYSIZE(debug_arguments), input_flags)) {
         }
 
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("Environment"); ImGui::SameLine();
+        static char debug_environment[256] = "";
+        ImGui::InputTextWithHint("##environment", "NAME=value NAME", debug_environment, IM_ARRAYSIZE(debug_environment), input_flags);
+
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("Directory"); ImGui::SameLine();
+        static char debug_directory[256] = "";
+        ImGui::InputTextWithHint("##directory", "working directory", debug_directory, IM_ARRAYSIZE(debug_directory), input_flags);
+
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("Stdin"); ImGui::SameLine();
+        static char debug_stdin[256] = "";
+        ImGui::InputTextWithHint("##stdin", "input file", debug_stdin, IM_ARRAYSIZE(debug_stdin), input_flags);
+
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("Stdout"); ImGui::SameLine();
+        static char debug_stdout[256] = "";
+        ImGui::InputTextWithHint("##stdout", "output file", debug_stdout, IM_ARRAYSIZE(debug_stdout), input_flags);
+
+        static bool use_pty = true;
+        ImGui::Checkbox("Program output in the Output panel", &use_pty);
+        ImGui::Checkbox("Restart by forking the program parked at main", &d->fork_server_enabled);
+
         if (ImGui::MenuItem("Load debug session", NULL, false, d->state == dbg::Debugger_State::NOT_LOADED)) {
-          send_command(DEBUG, debug_path, debug_arguments);
+          // Empty fields aren't set
+          auto option = [](char *field) { return field[0] ? (const char *)field : nullptr; };
+
+          dbg::Launch_Options options;
+          options.arguments = option(debug_arguments);
+          options.environment = option(debug_environment);
+          options.working_directory = option(debug_directory);
+          options.stdin_path = option(debug_stdin);
+          options.stdout_path = option(debug_stdout);
+          options.use_pty = use_pty;
+
+          m_program_output.reset();
+          send_command(DEBUG, debug_path, options);
         }
 
         if (ImGui::MenuItem("Unload debug session", NULL, false, d->state == dbg::Debugger_State::LOADED)) {
@@ -423,6 +1120,13 @@ void Debugger_GUI::show_debugger_window() {
       ImGui::EndMenu();
     }
 
+    u32 indexed_units, total_units;
+    if (dbg::get_indexing_progress(d, &indexed_units, &total_units)) {
+      char progress_text[64];
+      sprintf(progress_text, "Indexing debug info %u/%u", indexed_units, total_units);
+      ImGui::ProgressBar(total_units > 0 ? (float32)indexed_units / total_units : 0.0f, ImVec2(250.0f, 0.0f), progress_text);
+    }
+
     ImGui::EndMainMenuBar();
   }
 
@@ -432,11 +1136,44 @@ void Debugger_GUI::show_debugger_window() {
   show_stack_panel();
   show_register_panel();
   show_symbols_panel();
+  show_memory_panel();
+  show_profiler_panel();
+  show_tracer_panel();
+  show_coverage_panel();
+  show_stats_panel();
+  show_output_panel();
+}
+
+void load_frame_variables(Debugger_GUI *debugger_gui) {
+  auto &frame_variables = debugger_gui->m_frame_variables;
+
+  // Expanded frames stay expanded while stack is the same depth
+  while (frame_variables.count < debugger_gui->m_stack_trace.count) {
+    Frame_Variables new_frame;
+    new_frame.variables.init();
+    frame_variables.add(new_frame);
+  }
+  while (frame_variables.count > debugger_gui->m_stack_trace.count) {
+    dbg::deinit(frame_variables.back().variables);
+    frame_variables.count--;
+  }
+
+  For_Count (frame_variables.count, i) {
+    if (frame_variables[i].is_requested)  dbg::get_variables(debugger_gui->d, i, &frame_variables[i].variables);
+  }
+}
+
+void request_frame_variables(Debugger_GUI *debugger_gui, u32 frame_index) {
+  if (frame_index < (u32)debugger_gui->m_frame_variables.count) {
+    debugger_gui->m_frame_variables[frame_index].is_requested = true;
+  }
 }
 
 // @Note: Running this function in the same thread as the debugger because
 //        functions calling ptrace require to be called from the same thread.
 void update_in_debugger_thread(Debugger_GUI *debugger_gui) {
+  timeline_zone("update in debugger thread");
+
   auto &d = debugger_gui->d;
 
   bool is_debugger_running = (d->state == dbg::Debugger_State::RUNNING);
@@ -451,11 +1188,17 @@ void update_in_debugger_thread(Debugger_GUI *debugger_gui) {
 
     dbg::get_variables(d, &debugger_gui->m_local_variables);
     dbg::get_stack_trace(d, &debugger_gui->m_stack_trace);
+    load_frame_variables(debugger_gui);
+    dbg::evaluate_watches(d, &debugger_gui->m_watches);
     dbg::get_registers(d, &debugger_gui->m_register_values);
   } else {
     if (debugger_gui->m_last_debugger_state == dbg::Debugger_State::RUNNING) {
+      For (debugger_gui->m_local_variables) {
+        if (it.data)  free(it.data);
+      }
       debugger_gui->m_local_variables.reset();
       debugger_gui->m_stack_trace.reset();
+      debugger_gui->free_frame_variables();
       debugger_gui->m_register_values.reset();
     }
   }
@@ -0,0 +1,511 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Debug index
+//
+// Everything the session builds by walking DWARF and .eh_frame on load is saved into
+// <debug directory>/.index/ab/cdef....index, keyed by build-id of the executable.
+// Later sessions map the file and use it instead: strings and the name index are used
+// in place, other tables are converted to the in-memory arrays with a single pass.
+//
+// Layout: header, fixed-size tables aligned to 8 bytes, string blob. Strings are
+// referenced by offsets in the blob, CFI instructions by offsets in .eh_frame.
+//
+
+constexpr u64 debug_index_magic = 0x3130584449424453; // "SDBIDX01"
+constexpr u32 debug_index_version = 1;
+constexpr u32 max_build_id_length = 80;
+
+struct Debug_Index_Table {
+  u64 offset;
+  u64 count;
+};
+
+struct Debug_Index_Header {
+  u64 magic;
+  u32 version;
+  u32 reserved;
+  char build_id[max_build_id_length]; // Hex, zero-terminated
+  u64 eh_frame_size;                  // CFI offsets are valid only for the same .eh_frame
+
+  Debug_Index_Table functions;
+  Debug_Index_Table names;
+  Debug_Index_Table sources;
+  Debug_Index_Table cies;
+  Debug_Index_Table fdes;
+  Debug_Index_Table strings;
+};
+
+struct Index_Function {
+  u64 low_pc;
+  u64 high_pc;
+  u64 name;
+};
+
+// Sorted by name, used by function breakpoints to parse only the units defining the function
+struct Index_Name {
+  u64 name;
+  u32 unit_index;
+  u32 reserved;
+};
+
+struct Index_Source {
+  u64 path;
+};
+
+struct Index_Cie {
+  u64 offset;
+  u64 code_alignment;
+  s64 data_alignment;
+  u64 return_address_register;
+  u64 instructions;
+  u64 instructions_end;
+  u8 pointer_encoding;
+  u8 has_augmentation_data;
+  u8 reserved[6];
+};
+
+struct Index_Fde {
+  u64 low_pc;
+  u64 high_pc;
+  u64 instructions;
+  u64 instructions_end;
+  s32 cie_index;
+  u32 reserved;
+};
+
+struct Debug_Index {
+  u8 *data;
+  u64 size;
+
+  Debug_Index_Header *header;
+  Index_Function *functions;
+  Index_Name *names;
+  Index_Source *sources;
+  Index_Cie *cies;
+  Index_Fde *fdes;
+  const char *strings;
+};
+
+bool get_debug_index_path(Debugger *dbg, char *path, u64 path_size, char **build_id) {
+  if (!dbg->debug_file_directory)  return false;
+
+  *build_id = get_build_id(dbg->elf);
+  if (!*build_id)  return false;
+
+  if (strlen(*build_id) < 3 || strlen(*build_id) >= max_build_id_length) {
+    free(*build_id);
+    *build_id = nullptr;
+    return false;
+  }
+
+  snprintf(path, path_size, "%s/.index/%.2s/%s.index", dbg->debug_file_directory, *build_id, *build_id + 2);
+  return true;
+}
+
+inline u64 get_eh_frame_size(Debugger *dbg) {
+  auto &section = dbg->elf.get_section(".eh_frame");
+  return section.valid() ? section.size() : 0;
+}
+
+inline bool is_table_valid(Debug_Index *index, Debug_Index_Table *table, u64 element_size) {
+  return table->offset <= index->size && table->count <= (index->size - table->offset) / element_size;
+}
+
+inline bool is_string_valid(Debug_Index *index, u64 string) {
+  return string < index->header->strings.count;
+}
+
+inline bool is_instructions_range_valid(Debug_Index *index, u64 instructions, u64 instructions_end) {
+  return instructions <= instructions_end && instructions_end <= index->header->eh_frame_size;
+}
+
+// References of the entries are checked once on load, as the file is shared and could be truncated or
+// corrupted, while tables are used in place or converted later, when the session needs them
+bool are_index_entries_valid(Debug_Index *index, u64 unit_count) {
+  auto header = index->header;
+
+  For_Count (header->functions.count, i) {
+    if (!is_string_valid(index, index->functions[i].name))  return false;
+  }
+
+  For_Count (header->names.count, i) {
+    auto &name = index->names[i];
+    if (!is_string_valid(index, name.name) || name.unit_index >= unit_count)  return false;
+  }
+
+  For_Count (header->sources.count, i) {
+    if (!is_string_valid(index, index->sources[i].path))  return false;
+  }
+
+  For_Count (header->cies.count, i) {
+    auto &cie = index->cies[i];
+    if (!is_instructions_range_valid(index, cie.instructions, cie.instructions_end))  return false;
+  }
+
+  For_Count (header->fdes.count, i) {
+    auto &fde = index->fdes[i];
+    if (!is_instructions_range_valid(index, fde.instructions, fde.instructions_end))  return false;
+    if (fde.cie_index < 0 || (u64)fde.cie_index >= header->cies.count)  return false;
+  }
+
+  return true;
+}
+
+void free_debug_index(Debugger *dbg) {
+  auto index = dbg->debug_index;
+  if (!index)  return;
+
+  munmap(index->data, index->size);
+  free(index);
+  dbg->debug_index = nullptr;
+}
+
+void load_debug_index(Debugger *dbg) {
+  free_debug_index(dbg);
+
+  char path[PATH_MAX];
+  char *build_id;
+  if (!get_debug_index_path(dbg, path, sizeof(path), &build_id))  return;
+  defer { free(build_id); };
+
+  auto fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)  return;
+  defer { close(fd); };
+
+  struct stat index_stat;
+  if (fstat(fd, &index_stat) != 0 || (u64)index_stat.st_size < sizeof(Debug_Index_Header))  return;
+
+  auto data = mmap(nullptr, index_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)  return;
+
+  Debug_Index index;
+  index.data = static_cast <u8 *>(data);
+  index.size = index_stat.st_size;
+  index.header = reinterpret_cast <Debug_Index_Header *>(data);
+
+  auto header = index.header;
+  bool is_valid = header->magic == debug_index_magic && header->version == debug_index_version &&
+                  strncmp(header->build_id, build_id, max_build_id_length) == 0 &&
+                  header->eh_frame_size == get_eh_frame_size(dbg) &&
+                  is_table_valid(&index, &header->functions, sizeof(Index_Function)) &&
+                  is_table_valid(&index, &header->names, sizeof(Index_Name)) &&
+                  is_table_valid(&index, &header->sources, sizeof(Index_Source)) &&
+                  is_table_valid(&index, &header->cies, sizeof(Index_Cie)) &&
+                  is_table_valid(&index, &header->fdes, sizeof(Index_Fde)) &&
+                  is_table_valid(&index, &header->strings, 1) &&
+                  (header->strings.count == 0 || index.data[header->strings.offset + header->strings.count - 1] == '\0');
+
+  if (is_valid) {
+    index.functions = reinterpret_cast <Index_Function *>(index.data + header->functions.offset);
+    index.names     = reinterpret_cast <Index_Name *>(index.data + header->names.offset);
+    index.sources   = reinterpret_cast <Index_Source *>(index.data + header->sources.offset);
+    index.cies      = reinterpret_cast <Index_Cie *>(index.data + header->cies.offset);
+    index.fdes      = reinterpret_cast <Index_Fde *>(index.data + header->fdes.offset);
+    index.strings   = reinterpret_cast <const char *>(index.data + header->strings.offset);
+
+    is_valid = are_index_entries_valid(&index, dbg->dwarf.compilation_units().size());
+  }
+
+  if (!is_valid) {
+    if (dbg->verbose)  printf("Warning: debug index %s is stale or corrupted, ignoring it\n", path);
+    munmap(data, index.size);
+    return;
+  }
+
+  dbg->debug_index = static_cast <Debug_Index *>(malloc(sizeof(Debug_Index)));
+  *dbg->debug_index = index;
+
+  if (dbg->verbose)  printf("Using debug index %s\n", path);
+}
+
+/////////////////////////////////////
+//
+//  Reading
+//
+
+void load_sources_from_index(Debugger *dbg, Array<Source_File> *sources) {
+  auto index = dbg->debug_index;
+
+  For_Count (index->header->sources.count, i) {
+    Source_File source;
+    source.file_path = dbg->strings.intern(index->strings + index->sources[i].path);
+    source.file_name = extract_file_name_from_path(source.file_path);
+    sources->add(source);
+  }
+}
+
+void load_function_index_from_index(Debugger *dbg) {
+  auto index = dbg->debug_index;
+
+  // Saved sorted
+  For_Count (index->header->functions.count, i) {
+    auto &function = index->functions[i];
+    dbg->function_index.add((Function_Range){function.low_pc, function.high_pc, const_cast <char *>(index->strings + function.name)});
+  }
+}
+
+Unwind_Table * load_unwind_table_from_index(Debugger *dbg) {
+  auto index = dbg->debug_index;
+
+  auto &section = dbg->elf.get_section(".eh_frame");
+  if (!section.valid())  return nullptr;
+
+  auto eh_frame = static_cast <const u8 *>(section.data());
+
+  auto table = static_cast <Unwind_Table *>(calloc(1, sizeof(Unwind_Table)));
+  table->cies.init();
+  table->fdes.init();
+
+  For_Count (index->header->cies.count, i) {
+    auto &saved = index->cies[i];
+
+    Frame_Common_Info cie = {};
+    cie.offset = saved.offset;
+    cie.code_alignment = saved.code_alignment;
+    cie.data_alignment = saved.data_alignment;
+    cie.return_address_register = saved.return_address_register;
+    cie.pointer_encoding = saved.pointer_encoding;
+    cie.has_augmentation_data = saved.has_augmentation_data;
+    cie.instructions = eh_frame + saved.instructions;
+    cie.instructions_end = eh_frame + saved.instructions_end;
+    table->cies.add(cie);
+  }
+
+  For_Count (index->header->fdes.count, i) {
+    auto &saved = index->fdes[i];
+    table->fdes.add((Frame_Description){saved.low_pc, saved.high_pc, saved.cie_index,
+                                        eh_frame + saved.instructions, eh_frame + saved.instructions_end});
+  }
+
+  return table;
+}
+
+// Compares zero-terminated name from the index with a name of given length
+inline s32 compare_index_name(const char *indexed_name, const char *name, u64 name_length) {
+  auto result = strncmp(indexed_name, name, name_length);
+  if (result == 0 && indexed_name[name_length] != '\0')  return 1;
+  return result;
+}
+
+// Indices of compilation units, which define a function with the exact name.
+// Names are taken from the debug index or from the ones collected by indexing.
+void find_indexed_units(Debugger *dbg, const char *name, u64 name_length, Array<u32> *unit_indices) {
+  unit_indices->reset();
+
+  if (is_indexing(dbg)) {
+    find_units_indexed_so_far(dbg, name, name_length, unit_indices);
+    return;
+  }
+
+  auto index = dbg->debug_index;
+  u64 name_count = index ? index->header->names.count : (dbg->function_names.count > 0 ? dbg->function_names.count : 0);
+
+  auto get_name = [&](u64 i) -> const char * {
+    return index ? index->strings + index->names[i].name : dbg->function_names.data[i].name;
+  };
+
+  // Looking for the first entry with the name
+  s64 low = 0;
+  s64 high = (s64)name_count - 1;
+  s64 first = -1;
+
+  while (low <= high) {
+    s64 middle = low + (high - low) / 2;
+    auto comparison = compare_index_name(get_name(middle), name, name_length);
+
+    if (comparison < 0) {
+      low = middle + 1;
+    } else {
+      if (comparison == 0)  first = middle;
+      high = middle - 1;
+    }
+  }
+
+  if (first == -1)  return;
+
+  for (u64 i = first; i < name_count; i++) {
+    if (compare_index_name(get_name(i), name, name_length) != 0)  break;
+    unit_indices->add(index ? index->names[i].unit_index : dbg->function_names.data[i].unit_index);
+  }
+}
+
+/////////////////////////////////////
+//
+//  Writing
+//
+
+u64 add_index_string(Array<char> *strings, const char *string) {
+  u64 offset = strings->count;
+  do {
+    strings->add(*string);
+  } while (*string++ != '\0');
+  return offset;
+}
+
+bool write_index_table(s32 fd, u64 *offset, Debug_Index_Table *table, const void *data, u64 count, u64 element_size) {
+  table->offset = *offset;
+  table->count = count;
+
+  auto size = count * element_size;
+  auto bytes = static_cast <const u8 *>(data);
+  while (size > 0) {
+    auto written = write(fd, bytes, size);
+    if (written <= 0)  return false;
+    bytes += written;
+    size -= written;
+    *offset += written;
+  }
+
+  // Next table is aligned to 8 bytes
+  static const u8 padding[8] = {};
+  auto padding_size = (8 - *offset % 8) % 8;
+  if (padding_size && write(fd, padding, padding_size) != (ssize_t)padding_size)  return false;
+  *offset += padding_size;
+
+  return true;
+}
+
+void write_debug_index(Debugger *dbg) {
+  u64 start_time = get_monotonic_time_ns();
+  defer { dbg->load_timings.index_write = get_monotonic_time_ns() - start_time; };
+
+  char path[PATH_MAX];
+  char *build_id;
+  if (!get_debug_index_path(dbg, path, sizeof(path), &build_id)) {
+    if (dbg->verbose)  printf("Warning: executable has no build-id, debug index isn't written\n");
+    return;
+  }
+  defer { free(build_id); };
+
+  Array<char> strings;
+  Array<Index_Function> functions;
+  Array<Index_Name> names;
+  Array<Index_Source> sources;
+  Array<Index_Cie> cies;
+  Array<Index_Fde> fdes;
+  strings.init();
+  functions.init();
+  names.init();
+  sources.init();
+  cies.init();
+  fdes.init();
+  defer {
+    strings.deinit();
+    functions.deinit();
+    names.deinit();
+    sources.deinit();
+    cies.deinit();
+    fdes.deinit();
+  };
+
+  // Functions, names and sources are collected by the background indexing
+  For_Pointer (dbg->function_index) {
+    functions.add((Index_Function){it->low_pc, it->high_pc, add_index_string(&strings, it->name)});
+  }
+
+  For_Pointer (dbg->source_files) {
+    sources.add((Index_Source){add_index_string(&strings, it->file_path)});
+  }
+
+  For_Pointer (dbg->function_names) {
+    names.add((Index_Name){add_index_string(&strings, it->name), it->unit_index, 0});
+  }
+
+  auto unwind_table = get_unwind_table(dbg);
+  auto &eh_frame_section = dbg->elf.get_section(".eh_frame");
+  if (unwind_table && eh_frame_section.valid()) {
+    auto eh_frame = static_cast <const u8 *>(eh_frame_section.data());
+
+    For_Pointer (unwind_table->cies) {
+      Index_Cie cie = {};
+      cie.offset = it->offset;
+      cie.code_alignment = it->code_alignment;
+      cie.data_alignment = it->data_alignment;
+      cie.return_address_register = it->return_address_register;
+      cie.instructions = it->instructions - eh_frame;
+      cie.instructions_end = it->instructions_end - eh_frame;
+      cie.pointer_encoding = it->pointer_encoding;
+      cie.has_augmentation_data = it->has_augmentation_data;
+      cies.add(cie);
+    }
+
+    For_Pointer (unwind_table->fdes) {
+      fdes.add((Index_Fde){it->low_pc, it->high_pc, (u64)(it->instructions - eh_frame), (u64)(it->instructions_end - eh_frame), it->cie_index, 0});
+    }
+  }
+
+  Debug_Index_Header header = {};
+  header.magic = debug_index_magic;
+  header.version = debug_index_version;
+  strncpy(header.build_id, build_id, max_build_id_length - 1);
+  header.eh_frame_size = get_eh_frame_size(dbg);
+
+  // Written next to the final path and renamed, so readers never see a partial index
+  char temporary_path[PATH_MAX + 16];
+  snprintf(temporary_path, sizeof(temporary_path), "%s.%d", path, getpid());
+  make_directories(temporary_path);
+
+  auto fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    if (dbg->verbose)  printf("Warning: couldn't write debug index %s\n", path);
+    return;
+  }
+
+  u64 offset = sizeof(header);
+  bool is_written = lseek(fd, offset, SEEK_SET) == (off_t)offset &&
+                    write_index_table(fd, &offset, &header.functions, functions.data, functions.count, sizeof(Index_Function)) &&
+                    write_index_table(fd, &offset, &header.names, names.data, names.count, sizeof(Index_Name)) &&
+                    write_index_table(fd, &offset, &header.sources, sources.data, sources.count, sizeof(Index_Source)) &&
+                    write_index_table(fd, &offset, &header.cies, cies.data, cies.count, sizeof(Index_Cie)) &&
+                    write_index_table(fd, &offset, &header.fdes, fdes.data, fdes.count, sizeof(Index_Fde)) &&
+                    write_index_table(fd, &offset, &header.strings, strings.data, strings.count, 1) &&
+                    pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+  close(fd);
+
+  if (!is_written || rename(temporary_path, path) != 0) {
+    if (dbg->verbose)  printf("Warning: couldn't write debug index %s\n", path);
+    unlink(temporary_path);
+    return;
+  }
+
+  if (dbg->verbose)  printf("Debug index written to %s\n", path);
+}
+
+// Loads only debug info without starting the process, for pre-generation of the index
+void build_debug_index(Debugger *dbg, const char *executable_path) {
+  if (dbg->state != Debugger_State::NOT_LOADED) {
+    dbg_fail("debug index could be built only in NOT_LOADED state");
+    return;
+  }
+
+  dbg->executable_path = realpath(executable_path, nullptr);
+  if (!dbg->executable_path) {
+    dbg_fail("executable doesn't exist");
+    return;
+  }
+
+  if (load_debug_info(dbg) != 0) {
+    dbg_fail("couldn't load debug info");
+    return;
+  }
+
+  // Index being built is never read, even if a stale one exists
+  if (dbg->debug_index) {
+    free_debug_index(dbg);
+    start_indexing(dbg);
+  }
+
+  load_sources(dbg);
+  finish_indexing(dbg); // Writes the index
+
+  unload_sources(dbg);
+  free_unwind_table(dbg);
+  dbg->function_index.deinit();
+  dbg->function_names.deinit();
+
+  dbg_success();
+}
+
+DBG_NAMESPACE_END
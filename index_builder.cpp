@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#include "defer.h"
+#include "common.h"
+
+#include "debugger.h"
+#include "debugger.cpp"
+
+// Pre-generates debug index of an executable, see index.cpp
+s32 main(s32 argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <executable>\n", argv[0]);
+    return 1;
+  }
+
+  dbg::Debugger debugger;
+  dbg::Debugger *d = &debugger;
+  d->verbose = true;
+
+  dbg::init(d);
+  defer { dbg::deinit(d); };
+
+  dbg::build_debug_index(d, argv[1]);
+  dbg::print_load_timings(d);
+
+  return d->last_command_status == dbg::Command_Status::SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,504 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Background indexing
+//
+// Without the debug index, function ranges, function names and source paths are collected
+// from all compilation units in the background, debug and attach return right after the
+// process is stopped. Units are parsed on a pool of threads: every worker owns a contiguous
+// slice of units and takes units from slices of other workers when its own is done.
+// The unit containing main goes first. Each unit gets a partial index, which is usable as
+// soon as the unit is done, partial indices are merged when all units are done.
+//
+// Queries wait only for the units they touch (see wait_for_unit), breakpoints in units not
+// indexed yet are queued and set by update_indexing.
+//
+// @Note: libelfin parses lazily and has no locks. Shared sections and abbreviations of all
+//        units are loaded upfront on the debugger thread, after that DIEs are only read.
+//        Line table of a unit is parsed by the worker, which took the unit, the debugger
+//        thread touches line tables of indexed units only.
+//
+
+struct Unit_Index {
+  Array<Function_Range> functions; // Sorted by low_pc
+  Array<Function_Name> names;
+  Array<char *> source_paths;
+};
+
+struct alignas(64) Work_Slice { // Own cache line, as workers take units with atomics
+  std::atomic<u32> next;
+  u32 end;
+};
+
+struct Indexing {
+  u32 unit_count = 0;
+  u32 thread_count = 0;
+  s32 entry_unit = -1;
+
+  Array<u32> order;                      // Unit indices, slices are ranges of this array
+  Work_Slice *slices = nullptr;
+  Unit_Index *results = nullptr;         // Indexed by unit index
+  std::atomic<bool> *is_unit_indexed = nullptr;
+
+  std::atomic<u32> indexed_count;
+  std::atomic<bool> is_done;             // All units are indexed and merged
+  std::atomic<bool> is_cancelled;
+  std::mutex mutex;
+  std::condition_variable unit_indexed;
+  std::thread thread;
+
+  // Merged by the indexing thread, taken by the debugger when indexing is done
+  Array<Function_Range> functions;
+  Array<Function_Name> names;
+
+  u64 start_time = 0;
+  u64 entry_unit_time = 0;
+  u64 units_time = 0;
+  u64 merge_time = 0;
+
+  // Used only by the debugger thread
+  Array<bool> is_unit_merged;            // Sources of the unit are added to Debugger::source_files
+  Hash_Table<Interned_String, s32> source_indices;
+  u32 seen_indexed_count = 0;
+};
+
+// Time since the start of the phase, next phase starts now
+inline u64 end_load_phase(u64 *phase_start) {
+  auto now = get_monotonic_time_ns();
+  auto duration = now - *phase_start;
+  *phase_start = now;
+  return duration;
+}
+
+s32 compare_function_names(const void *a, const void *b) {
+  auto first = static_cast <const Function_Name *>(a);
+  auto second = static_cast <const Function_Name *>(b);
+
+  auto result = strcmp(first->name, second->name);
+  if (result != 0)  return result;
+  return (first->unit_index > second->unit_index) - (first->unit_index < second->unit_index);
+}
+
+// Binary search over ranges sorted by low_pc
+Function_Range * search_function_ranges(Array<Function_Range> *ranges, u64 pc) {
+  s32 low = 0;
+  s32 high = ranges->count - 1;
+  s32 candidate = -1;
+
+  // Looking for the last range with low_pc <= pc
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    if (ranges->data[middle].low_pc <= pc) {
+      candidate = middle;
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  if (candidate != -1 && pc < ranges->data[candidate].high_pc)  return &ranges->data[candidate];
+  return nullptr;
+}
+
+void add_unit_functions(const dwarf::die &parent, u32 unit_index, Unit_Index *result) {
+  for (const auto &die : parent) {
+    switch (die.tag) {
+    case dwarf::DW_TAG::subprogram: {
+      if (!die.has(dwarf::DW_AT::low_pc) && !die.has(dwarf::DW_AT::ranges))  break;
+
+      auto name = get_function_name(die);
+      for (const auto &range : dwarf::die_pc_range(die)) {
+        result->functions.add((Function_Range){range.low, range.high, name});
+      }
+
+      // Function breakpoints are set at the body found by low_pc
+      if (die.has(dwarf::DW_AT::low_pc) && strcmp(name, "??") != 0)  result->names.add((Function_Name){name, unit_index});
+      break;
+    }
+
+    // Member functions defined inside of class and functions in namespaces are nested
+    case dwarf::DW_TAG::namespace_:
+    case dwarf::DW_TAG::class_type:
+    case dwarf::DW_TAG::structure_type:
+      add_unit_functions(die, unit_index, result);
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+void add_unit_source_paths(const dwarf::compilation_unit &cu, Unit_Index *result) {
+  auto &lt = cu.get_line_table();
+
+  for (u32 file_index = 0; ; file_index++) {
+    const dwarf::line_table::file *file;
+    try {
+      file = lt.get_file(file_index);
+    } catch (std::out_of_range ex) { break; }
+
+    result->source_paths.add(const_cast <char *>(file->path.c_str()));
+  }
+}
+
+// Next unit of the own slice, or of the slice of another worker
+s32 take_unit(Indexing *indexing, u32 worker_index) {
+  For_Count (indexing->thread_count, i) {
+    auto slice = &indexing->slices[(worker_index + i) % indexing->thread_count];
+    if (slice->next.load(std::memory_order_relaxed) >= slice->end)  continue;
+
+    auto position = slice->next.fetch_add(1, std::memory_order_relaxed);
+    if (position < slice->end)  return indexing->order[position];
+  }
+
+  return -1;
+}
+
+void run_indexing_worker(Indexing *indexing, const std::vector<dwarf::compilation_unit> *units, u32 worker_index) {
+  s32 unit_index;
+  while (!indexing->is_cancelled.load(std::memory_order_relaxed) && (unit_index = take_unit(indexing, worker_index)) != -1) {
+    auto &cu = (*units)[unit_index];
+    auto result = &indexing->results[unit_index];
+
+    // Broken unit is skipped, as exceptions can't leave the thread
+    try {
+      add_unit_functions(cu.root(), unit_index, result);
+      add_unit_source_paths(cu, result);
+    } catch (std::exception ex) { }
+
+    // Sorted, so the unit is searched while others are being indexed
+    qsort(result->functions.data, result->functions.count, sizeof(Function_Range), compare_function_ranges);
+
+    if (unit_index == indexing->entry_unit)  indexing->entry_unit_time = get_monotonic_time_ns() - indexing->start_time;
+
+    {
+      std::lock_guard<std::mutex> lock(indexing->mutex);
+      indexing->is_unit_indexed[unit_index].store(true, std::memory_order_release);
+      indexing->indexed_count.fetch_add(1);
+    }
+    indexing->unit_indexed.notify_all();
+  }
+}
+
+void merge_unit_functions(Indexing *indexing) {
+  indexing->functions.init();
+  indexing->names.init();
+
+  For_Count (indexing->unit_count, unit_index) {
+    auto result = &indexing->results[unit_index];
+    For (result->functions)  indexing->functions.add(it);
+    For (result->names)  indexing->names.add(it);
+  }
+
+  qsort(indexing->functions.data, indexing->functions.count, sizeof(Function_Range), compare_function_ranges);
+
+  // Names are sorted for binary search, same function could be listed twice by a unit
+  auto &names = indexing->names;
+  qsort(names.data, names.count, sizeof(Function_Name), compare_function_names);
+
+  s32 unique_count = 0;
+  For_Count (names.count, i) {
+    if (unique_count > 0 && compare_function_names(&names[i], &names[unique_count - 1]) == 0)  continue;
+    names[unique_count++] = names[i];
+  }
+  names.count = unique_count;
+}
+
+// Indexing thread, which is also the first worker of the pool
+void run_indexing(Indexing *indexing, const std::vector<dwarf::compilation_unit> *units) {
+  u64 phase_start = indexing->start_time;
+
+  std::vector<std::thread> workers;
+  for (u32 i = 1; i < indexing->thread_count; i++)  workers.emplace_back(run_indexing_worker, indexing, units, i);
+  run_indexing_worker(indexing, units, 0);
+  for (auto &worker : workers)  worker.join();
+
+  indexing->units_time = end_load_phase(&phase_start);
+
+  if (!indexing->is_cancelled.load())  merge_unit_functions(indexing);
+
+  indexing->merge_time = end_load_phase(&phase_start);
+
+  {
+    std::lock_guard<std::mutex> lock(indexing->mutex);
+    indexing->is_done.store(true);
+  }
+  indexing->unit_indexed.notify_all();
+}
+
+// Loads everything libelfin initializes lazily and shares between units
+void preload_shared_debug_info(Debugger *dbg) {
+  const dwarf::section_type sections[] = {
+    dwarf::section_type::info, dwarf::section_type::abbrev, dwarf::section_type::str,
+    dwarf::section_type::line, dwarf::section_type::ranges,
+  };
+
+  for (auto type : sections) {
+    try {
+      dbg->dwarf.get_section(type);
+    } catch (std::runtime_error ex) { } // Optional sections could be missing
+  }
+
+  // Root DIE reads abbreviations of the unit, which are needed for references between units as well
+  for (auto &cu : dbg->dwarf.compilation_units())  cu.root();
+}
+
+// Unit containing main, so the code the session starts with is indexed first
+s32 find_entry_unit(Debugger *dbg) {
+  u64 main_address = 0;
+
+  const elf::elf *files[] = { &dbg->debug_elf, &dbg->elf };
+  For_Count (2, file_index) {
+    for (auto &section : files[file_index]->sections()) {
+      if (section.get_hdr().type != elf::sht::symtab)  continue;
+
+      for (auto symbol : section.as_symtab()) {
+        if (strcmp(symbol.get_name(nullptr), "main") != 0)  continue;
+        main_address = symbol.get_data().value;
+        break;
+      }
+    }
+    if (main_address)  break;
+  }
+
+  if (!main_address)  return -1;
+
+  s32 unit_index = 0;
+  for (auto &cu : dbg->dwarf.compilation_units()) {
+    if (dwarf::die_pc_range(cu.root()).contains(main_address))  return unit_index;
+    unit_index++;
+  }
+
+  return -1;
+}
+
+void free_indexing(Debugger *dbg) {
+  auto indexing = dbg->indexing;
+  if (!indexing)  return;
+
+  indexing->is_cancelled.store(true);
+  if (indexing->thread.joinable())  indexing->thread.join();
+
+  For_Count (indexing->unit_count, i) {
+    auto result = &indexing->results[i];
+    result->functions.deinit();
+    result->names.deinit();
+    result->source_paths.deinit();
+  }
+
+  delete[] indexing->results;
+  delete[] indexing->slices;
+  delete[] indexing->is_unit_indexed;
+
+  indexing->order.deinit();
+  indexing->functions.deinit();
+  indexing->names.deinit();
+  indexing->is_unit_merged.deinit();
+  indexing->source_indices.deinit();
+
+  delete indexing;
+  dbg->indexing = nullptr;
+}
+
+void start_indexing(Debugger *dbg) {
+  free_indexing(dbg);
+
+  u64 phase_start = get_monotonic_time_ns();
+
+  preload_shared_debug_info(dbg);
+
+  auto &units = dbg->dwarf.compilation_units();
+
+  auto indexing = new Indexing;
+  indexing->unit_count = units.size();
+  indexing->entry_unit = find_entry_unit(dbg);
+  indexing->indexed_count = 0;
+  indexing->is_done = false;
+  indexing->is_cancelled = false;
+
+  // Entry unit goes first into the slice of the indexing thread
+  indexing->order.init();
+  if (indexing->entry_unit != -1)  indexing->order.add(indexing->entry_unit);
+  For_Count (indexing->unit_count, i) {
+    if (i != indexing->entry_unit)  indexing->order.add(i);
+  }
+
+  u32 thread_count = std::thread::hardware_concurrency();
+  if (thread_count == 0)  thread_count = 1;
+  if (thread_count > indexing->unit_count)  thread_count = indexing->unit_count > 0 ? indexing->unit_count : 1;
+  indexing->thread_count = thread_count;
+
+  indexing->slices = new Work_Slice[thread_count];
+  For_Count (thread_count, i) {
+    indexing->slices[i].next = (u64)indexing->unit_count * i / thread_count;
+    indexing->slices[i].end  = (u64)indexing->unit_count * (i + 1) / thread_count;
+  }
+
+  indexing->results = new Unit_Index[indexing->unit_count];
+  indexing->is_unit_indexed = new std::atomic<bool>[indexing->unit_count]();
+  indexing->is_unit_merged.init(indexing->unit_count);
+  indexing->source_indices.init();
+
+  dbg->load_timings.preload = end_load_phase(&phase_start);
+
+  dbg->indexing = indexing;
+  indexing->start_time = phase_start;
+  indexing->thread = std::thread(run_indexing, indexing, &units);
+}
+
+inline bool is_unit_indexed(Debugger *dbg, u32 unit_index) {
+  auto indexing = dbg->indexing;
+  return !indexing || unit_index >= indexing->unit_count || indexing->is_unit_indexed[unit_index].load(std::memory_order_acquire);
+}
+
+// Blocks until the unit is indexed, so the debugger thread could parse its line table
+void wait_for_unit(Debugger *dbg, u32 unit_index) {
+  if (is_unit_indexed(dbg, unit_index))  return;
+
+  auto indexing = dbg->indexing;
+  std::unique_lock<std::mutex> lock(indexing->mutex);
+  indexing->unit_indexed.wait(lock, [&]() { return indexing->is_unit_indexed[unit_index].load(); });
+}
+
+// Sources of the units indexed so far, so the file list grows while indexing goes on
+void add_indexed_sources(Debugger *dbg) {
+  auto indexing = dbg->indexing;
+  if (!indexing)  return;
+
+  if (dbg->source_files.count < 0)  dbg->source_files.init();
+
+  For_Count (indexing->unit_count, unit_index) {
+    if (indexing->is_unit_merged[unit_index] || !is_unit_indexed(dbg, unit_index))  continue;
+    indexing->is_unit_merged[unit_index] = true;
+
+    For (indexing->results[unit_index].source_paths) {
+      auto file_path = dbg->strings.intern(it);
+
+      // There could be duplicates of file path
+      if (indexing->source_indices.exists({file_path}))  continue;
+
+      Source_File source;
+      source.file_path = file_path;
+      source.file_name = extract_file_name_from_path(file_path);
+      dbg->source_files.add(source);
+
+      indexing->source_indices.insert({file_path}, dbg->source_files.count - 1);
+    }
+  }
+}
+
+// Waits for the indexing thread and takes its results, the debug index is written for next sessions
+void finish_indexing(Debugger *dbg) {
+  auto indexing = dbg->indexing;
+  if (!indexing)  return;
+
+  indexing->thread.join();
+  add_indexed_sources(dbg);
+
+  dbg->function_index.deinit();
+  dbg->function_names.deinit();
+  dbg->function_index = indexing->functions;
+  dbg->function_names = indexing->names;
+  indexing->functions = Array<Function_Range>();
+  indexing->names = Array<Function_Name>();
+
+  auto timings = &dbg->load_timings;
+  timings->entry_unit = indexing->entry_unit_time;
+  timings->units = indexing->units_time;
+  timings->merge = indexing->merge_time;
+  timings->unit_count = indexing->unit_count;
+  timings->thread_count = indexing->thread_count;
+
+  free_indexing(dbg);
+
+  if (!dbg->debug_index)  write_debug_index(dbg);
+}
+
+// Indexing which is done is finished on the first check
+bool is_indexing(Debugger *dbg) {
+  if (dbg->indexing && dbg->indexing->is_done.load())  finish_indexing(dbg);
+  return dbg->indexing != nullptr;
+}
+
+// Function containing the address, only the units with the address are waited for
+Function_Range * find_unit_function_range(Debugger *dbg, u64 pc) {
+  u32 unit_index = 0;
+  for (auto &cu : dbg->dwarf.compilation_units()) {
+    if (dwarf::die_pc_range(cu.root()).contains(pc)) {
+      wait_for_unit(dbg, unit_index);
+
+      auto range = search_function_ranges(&dbg->indexing->results[unit_index].functions, pc);
+      if (range)  return range;
+    }
+    unit_index++;
+  }
+
+  return nullptr;
+}
+
+// Same as find_indexed_units, but only the units indexed so far are searched
+void find_units_indexed_so_far(Debugger *dbg, const char *name, u64 name_length, Array<u32> *unit_indices) {
+  auto indexing = dbg->indexing;
+
+  For_Count (indexing->unit_count, unit_index) {
+    if (!is_unit_indexed(dbg, unit_index))  continue;
+
+    For_Pointer (indexing->results[unit_index].names) {
+      if (strncmp(it->name, name, name_length) == 0 && it->name[name_length] == '\0') {
+        unit_indices->add(unit_index);
+        break;
+      }
+    }
+  }
+}
+
+bool get_indexing_progress(Debugger *dbg, u32 *indexed_units, u32 *total_units) {
+  auto indexing = dbg->indexing;
+  if (!indexing)  return false;
+
+  if (indexed_units)  *indexed_units = indexing->indexed_count.load();
+  if (total_units)  *total_units = indexing->unit_count;
+  return true;
+}
+
+bool update_indexing(Debugger *dbg) {
+  auto indexing = dbg->indexing;
+  if (!indexing)  return resolve_pending_breakpoints(dbg); // Queued right before indexing was finished
+
+  auto indexed_count = indexing->indexed_count.load();
+  auto is_done = indexing->is_done.load();
+  if (indexed_count == indexing->seen_indexed_count && !is_done)  return false;
+  indexing->seen_indexed_count = indexed_count;
+
+  add_indexed_sources(dbg);
+  if (is_done)  finish_indexing(dbg);
+
+  return resolve_pending_breakpoints(dbg);
+}
+
+void wait_for_indexing(Debugger *dbg) {
+  finish_indexing(dbg);
+  resolve_pending_breakpoints(dbg);
+  dbg_success();
+}
+
+void print_load_timings(Debugger *dbg) {
+  auto timings = &dbg->load_timings;
+  auto ms = [](u64 ns) { return ns / 1000000.0; };
+
+  printf("Load timings (%u units, %u threads):\n", timings->unit_count, timings->thread_count);
+  printf("  ELF          %8.2f ms\n", ms(timings->elf));
+  printf("  Debug file   %8.2f ms\n", ms(timings->debug_file));
+  printf("  DWARF        %8.2f ms\n", ms(timings->dwarf));
+  printf("  Debug index  %8.2f ms\n", ms(timings->debug_index));
+  printf("  Preload      %8.2f ms\n", ms(timings->preload));
+  printf("  Entry unit   %8.2f ms\n", ms(timings->entry_unit));
+  printf("  Units        %8.2f ms\n", ms(timings->units));
+  printf("  Merge        %8.2f ms\n", ms(timings->merge));
+  printf("  Sources      %8.2f ms\n", ms(timings->sources));
+  printf("  Index write  %8.2f ms\n", ms(timings->index_write));
+}
+
+DBG_NAMESPACE_END
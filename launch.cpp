@@ -0,0 +1,301 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Launch
+//
+// The program is started with vfork: the child runs on the memory of the debugger until exec, so page
+// tables of the debugger, big with debug info loaded, aren't copied. Everything the child needs (argv,
+// environment, opened files) is prepared before vfork, the child only makes system calls.
+//
+
+struct Launch {
+  Array<char *> argv;
+  Array<char *> environment;
+  char *argument_tokens = nullptr; // argv and environment point into these
+  char *environment_tokens = nullptr;
+
+  s32 directory_fd = -1;
+  s32 stdin_fd = -1;
+  s32 stdout_fd = -1;
+  s32 pty_slave_fd = -1;
+};
+
+void free_launch(Launch *launch) {
+  launch->argv.deinit();
+  launch->environment.deinit();
+  if (launch->argument_tokens)  free(launch->argument_tokens);
+  if (launch->environment_tokens)  free(launch->environment_tokens);
+
+  if (launch->directory_fd >= 0)  close(launch->directory_fd);
+  if (launch->stdin_fd >= 0)  close(launch->stdin_fd);
+  if (launch->stdout_fd >= 0)  close(launch->stdout_fd);
+  if (launch->pty_slave_fd >= 0)  close(launch->pty_slave_fd);
+}
+
+inline bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\n';
+}
+
+// Splits a command line like a shell: by whitespace, with '...' and "..." quoting and \ escapes.
+// Tokens are copied into one buffer, which is returned, or nullptr when a quote isn't closed.
+char * split_command_line(const char *line, Array<char *> *tokens) {
+  auto buffer = (char *)malloc(strlen(line) + 1); // Tokens never outgrow the line, every terminator takes place of a separator
+  auto out = buffer;
+  auto c = line;
+
+  while (true) {
+    while (is_blank(*c))  c++;
+    if (*c == '\0')  return buffer;
+
+    tokens->add(out);
+
+    char quote = 0;
+    while (*c && (quote || !is_blank(*c))) {
+      if (quote) {
+        if (*c == quote) {
+          quote = 0;
+          c++;
+          continue;
+        }
+        // Within double quotes only a quote and a backslash are escaped
+        if (quote == '"' && *c == '\\' && (c[1] == '"' || c[1] == '\\'))  c++;
+      } else {
+        if (*c == '\'' || *c == '"') {
+          quote = *c++;
+          continue;
+        }
+        if (*c == '\\' && c[1])  c++;
+      }
+      *out++ = *c++;
+    }
+    *out++ = '\0';
+
+    if (quote) {
+      free(buffer);
+      return nullptr;
+    }
+  }
+}
+
+// Environment of the debugger with overrides applied, terminated by nullptr
+void build_environment(Array<char *> *environment, Array<char *> *overrides) {
+  for (auto variable = environ; *variable; variable++) {
+    environment->add(*variable);
+  }
+
+  For (*overrides) {
+    auto name_length = strcspn(it, "=");
+
+    s32 i = 0;
+    while (i < environment->count) {
+      auto variable = (*environment)[i];
+      if (strncmp(variable, it, name_length) == 0 && variable[name_length] == '=') {
+        environment->remove(i);
+      } else {
+        i++;
+      }
+    }
+
+    if (it[name_length] == '=')  environment->add(it);
+  }
+
+  environment->add(nullptr);
+}
+
+// Master side is kept by the debugger between restarts, a slave side is opened for every launch
+bool open_pty_slave(Debugger *dbg, Launch *launch) {
+  if (dbg->pty_master_fd < 0) {
+    auto master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master_fd < 0)  return false;
+
+    if (grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+      close(master_fd);
+      return false;
+    }
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+    dbg->pty_master_fd = master_fd;
+  }
+
+  auto slave_path = ptsname(dbg->pty_master_fd);
+  if (!slave_path)  return false;
+
+  launch->pty_slave_fd = open(slave_path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  return launch->pty_slave_fd >= 0;
+}
+
+void close_pty(Debugger *dbg) {
+  if (dbg->pty_master_fd >= 0)  close(dbg->pty_master_fd);
+  dbg->pty_master_fd = -1;
+}
+
+// Returns false with the reason written into error
+bool prepare_launch(Debugger *dbg, Launch *launch, char *error, u64 error_size) {
+  auto options = &dbg->launch_options;
+
+  launch->argv.init();
+  launch->environment.init();
+
+  launch->argv.add(dbg->executable_path);
+  if (options->arguments) {
+    launch->argument_tokens = split_command_line(options->arguments, &launch->argv);
+    if (!launch->argument_tokens) {
+      snprintf(error, error_size, "unterminated quote in program arguments");
+      return false;
+    }
+  }
+  launch->argv.add(nullptr);
+
+  Array<char *> overrides;
+  overrides.init();
+  defer { overrides.deinit(); };
+
+  if (options->environment) {
+    launch->environment_tokens = split_command_line(options->environment, &overrides);
+    if (!launch->environment_tokens) {
+      snprintf(error, error_size, "unterminated quote in program environment");
+      return false;
+    }
+  }
+  build_environment(&launch->environment, &overrides);
+
+  s32 directory_fd = AT_FDCWD;
+  if (options->working_directory) {
+    launch->directory_fd = directory_fd = open(options->working_directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (launch->directory_fd < 0) {
+      snprintf(error, error_size, "couldn't open working directory %s: %s", options->working_directory, strerror(errno));
+      return false;
+    }
+  }
+
+  if (options->stdin_path) {
+    launch->stdin_fd = openat(directory_fd, options->stdin_path, O_RDONLY | O_CLOEXEC);
+    if (launch->stdin_fd < 0) {
+      snprintf(error, error_size, "couldn't open %s for stdin: %s", options->stdin_path, strerror(errno));
+      return false;
+    }
+  }
+
+  if (options->stdout_path) {
+    launch->stdout_fd = openat(directory_fd, options->stdout_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (launch->stdout_fd < 0) {
+      snprintf(error, error_size, "couldn't open %s for stdout: %s", options->stdout_path, strerror(errno));
+      return false;
+    }
+  }
+
+  if (options->use_pty && !open_pty_slave(dbg, launch)) {
+    snprintf(error, error_size, "couldn't open pseudo terminal: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+// Starts the program stopped at exec, returns its pid or zero on failure
+u32 launch_program(Debugger *dbg) {
+  timeline_zone("launch program");
+
+  Launch launch;
+  defer { free_launch(&launch); };
+
+  char error[512];
+  if (!prepare_launch(dbg, &launch, error, sizeof(error))) {
+    dbg_fail(error);
+    return 0;
+  }
+
+  auto argv = launch.argv.data;
+  auto environment = launch.environment.data;
+
+  // Written by the child through the shared memory, when it fails before exec
+  volatile s32 child_errno = 0;
+
+  auto pid = vfork();
+
+  if (pid == 0) {
+    // @Note: Only system calls here, the child shares memory and the stack with the debugger until exec
+    personality(ADDR_NO_RANDOMIZE);
+
+    if (launch.pty_slave_fd >= 0) {
+      setsid();
+      ioctl(launch.pty_slave_fd, TIOCSCTTY, 0);
+    }
+
+    // Files take precedence over the terminal
+    s32 input_fd = launch.stdin_fd >= 0 ? launch.stdin_fd : launch.pty_slave_fd;
+    s32 output_fd = launch.stdout_fd >= 0 ? launch.stdout_fd : launch.pty_slave_fd;
+
+    bool is_ready = (input_fd < 0 || dup2(input_fd, STDIN_FILENO) >= 0) &&
+                    (output_fd < 0 || dup2(output_fd, STDOUT_FILENO) >= 0) &&
+                    (output_fd < 0 || dup2(output_fd, STDERR_FILENO) >= 0) &&
+                    (launch.directory_fd < 0 || fchdir(launch.directory_fd) == 0);
+
+    if (is_ready) {
+      ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+      execve(dbg->executable_path, argv, environment);
+    }
+
+    child_errno = errno;
+    _exit(127);
+  }
+
+  if (pid < 0) {
+    snprintf(error, sizeof(error), "couldn't start the program: %s", strerror(errno));
+    dbg_fail(error);
+    return 0;
+  }
+
+  if (child_errno != 0) {
+    s32 status;
+    waitpid(pid, &status, 0);
+
+    snprintf(error, sizeof(error), "couldn't execute %s: %s", dbg->executable_path, strerror(child_errno));
+    dbg_fail(error);
+    return 0;
+  }
+
+  return pid;
+}
+
+inline char * copy_option(const char *option) {
+  return option ? strdup(option) : nullptr;
+}
+
+void free_launch_options(Launch_Options *options) {
+  free((void *)options->arguments);
+  free((void *)options->environment);
+  free((void *)options->working_directory);
+  free((void *)options->stdin_path);
+  free((void *)options->stdout_path);
+  *options = Launch_Options();
+}
+
+void set_launch_options(Debugger *dbg, Launch_Options *options) {
+  free_launch_options(&dbg->launch_options);
+
+  auto copy = &dbg->launch_options;
+  copy->arguments = copy_option(options->arguments);
+  copy->environment = copy_option(options->environment);
+  copy->working_directory = copy_option(options->working_directory);
+  copy->stdin_path = copy_option(options->stdin_path);
+  copy->stdout_path = copy_option(options->stdout_path);
+  copy->use_pty = options->use_pty;
+}
+
+u64 read_program_output(Debugger *dbg, char *buffer, u64 size) {
+  if (dbg->pty_master_fd < 0)  return 0;
+
+  auto bytes_read = read(dbg->pty_master_fd, buffer, size);
+  return bytes_read > 0 ? bytes_read : 0;
+}
+
+u64 write_program_input(Debugger *dbg, const char *buffer, u64 size) {
+  if (dbg->pty_master_fd < 0)  return 0;
+
+  auto bytes_written = write(dbg->pty_master_fd, buffer, size);
+  return bytes_written > 0 ? bytes_written : 0;
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,769 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  DWARF expressions
+//
+// Own evaluator instead of libelfin's one, which doesn't know frame base and CFA.
+// Registers are taken from unwound register set, so variables of caller frames
+// could be evaluated the same way.
+//
+
+enum DWARF_Operation : u8 {
+  DW_OP_addr = 0x03, DW_OP_deref = 0x06,
+  DW_OP_const1u = 0x08, DW_OP_const1s, DW_OP_const2u, DW_OP_const2s, DW_OP_const4u, DW_OP_const4s,
+  DW_OP_const8u, DW_OP_const8s, DW_OP_constu, DW_OP_consts,
+  DW_OP_dup, DW_OP_drop, DW_OP_over, DW_OP_pick, DW_OP_swap, DW_OP_rot, DW_OP_xderef,
+  DW_OP_abs, DW_OP_and, DW_OP_div, DW_OP_minus, DW_OP_mod, DW_OP_mul, DW_OP_neg, DW_OP_not,
+  DW_OP_or, DW_OP_plus, DW_OP_plus_uconst, DW_OP_shl, DW_OP_shr, DW_OP_shra, DW_OP_xor,
+  DW_OP_bra, DW_OP_eq, DW_OP_ge, DW_OP_gt, DW_OP_le, DW_OP_lt, DW_OP_ne, DW_OP_skip,
+  DW_OP_lit0 = 0x30, DW_OP_lit31 = 0x4f,
+  DW_OP_reg0 = 0x50, DW_OP_reg31 = 0x6f,
+  DW_OP_breg0 = 0x70, DW_OP_breg31 = 0x8f,
+  DW_OP_regx = 0x90, DW_OP_fbreg, DW_OP_bregx, DW_OP_piece, DW_OP_deref_size, DW_OP_xderef_size, DW_OP_nop,
+  DW_OP_call_frame_cfa = 0x9c, DW_OP_implicit_value = 0x9e, DW_OP_stack_value = 0x9f,
+};
+
+constexpr u32 dwarf_xmm0_register = 17;
+constexpr u32 dwarf_xmm15_register = 32;
+
+enum class Location_Type : u8 {
+  MEMORY,      // value is an address
+  REGISTER,    // value is a DWARF register number
+  VALUE,       // value is the value itself (DW_OP_stack_value, DW_OP_implicit_value, constants)
+  UNAVAILABLE  // Optimized out or not supported
+};
+
+struct Location {
+  Location_Type type = Location_Type::UNAVAILABLE;
+  u64 value = 0;
+};
+
+struct Location_Expression {
+  const u8 *data = nullptr; // Points into debug sections
+  u64 size = 0;
+};
+
+struct Expression_Context {
+  Debugger *dbg;
+  Unwind_Registers *registers;
+  bool is_caller_frame;
+
+  Allocator allocator; // Of the data of register and computed variables
+
+  Location_Expression frame_base_expression;
+
+  bool frame_base_evaluated = false;
+  bool has_frame_base = false;
+  u64 frame_base;
+
+  bool cfa_evaluated = false;
+  bool has_cfa = false;
+  u64 cfa;
+};
+
+bool evaluate_expression(Expression_Context *context, Location_Expression expression, Location *result);
+
+inline bool read_context_register(Expression_Context *context, u64 dwarf_register, u64 *value) {
+  if (dwarf_register >= unwind_registers_count)  return false;
+  if (!(context->registers->valid_mask & (1 << dwarf_register)))  return false;
+
+  *value = context->registers->values[dwarf_register];
+  return true;
+}
+
+bool get_frame_base(Expression_Context *context, u64 *frame_base) {
+  if (!context->frame_base_evaluated) {
+    context->frame_base_evaluated = true;
+
+    Location location;
+    if (context->frame_base_expression.data && evaluate_expression(context, context->frame_base_expression, &location)) {
+      switch (location.type) {
+      case Location_Type::MEMORY:
+        context->frame_base = location.value;
+        context->has_frame_base = true;
+        break;
+      case Location_Type::REGISTER:
+        context->has_frame_base = read_context_register(context, location.value, &context->frame_base);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  *frame_base = context->frame_base;
+  return context->has_frame_base;
+}
+
+bool get_cfa(Expression_Context *context, u64 *cfa) {
+  if (!context->cfa_evaluated) {
+    context->cfa_evaluated = true;
+
+    Unwind_Registers caller_registers = *context->registers;
+    context->has_cfa = unwind_frame(context->dbg, &caller_registers, context->is_caller_frame, &context->cfa);
+  }
+
+  *cfa = context->cfa;
+  return context->has_cfa;
+}
+
+inline u64 read_target_memory(Debugger *dbg, u64 address, u64 size) {
+  u64 value = 0;
+  read_memory(dbg, address, &value, size < sizeof(u64) ? size : sizeof(u64));
+  return value;
+}
+
+bool evaluate_expression(Expression_Context *context, Location_Expression expression, Location *result) {
+  constexpr u32 max_stack_size = 64;
+  u64 stack[max_stack_size];
+  u32 stack_size = 0;
+
+  #define push(v)  { u64 pushed = (v);  if (stack_size >= max_stack_size)  return false;  stack[stack_size++] = pushed; }
+  #define need(n)  { if (stack_size < (n))  return false; }
+  #define top      stack[stack_size - 1]
+
+  Data_Cursor cursor;
+  cursor.init(expression.data, expression.size);
+
+  result->type = Location_Type::MEMORY;
+
+  while (!cursor.at_end()) {
+    u8 operation = cursor.read_u8();
+
+    if (operation >= DW_OP_lit0 && operation <= DW_OP_lit31) {
+      push(operation - DW_OP_lit0);
+      continue;
+    }
+
+    if (operation >= DW_OP_reg0 && operation <= DW_OP_reg31) {
+      result->type = Location_Type::REGISTER;
+      result->value = operation - DW_OP_reg0;
+      return true;
+    }
+
+    if (operation >= DW_OP_breg0 && operation <= DW_OP_breg31) {
+      u64 value;
+      if (!read_context_register(context, operation - DW_OP_breg0, &value))  return false;
+      push(value + cursor.read_sleb128());
+      continue;
+    }
+
+    switch (operation) {
+    case DW_OP_addr:
+      push(offset_dwarf_address(context->dbg, cursor.read_u64()));
+      break;
+
+    case DW_OP_deref:
+      need(1);
+      top = read_target_memory(context->dbg, top, sizeof(u64));
+      break;
+
+    case DW_OP_deref_size: {
+      need(1);
+      u8 size = cursor.read_u8();
+      top = read_target_memory(context->dbg, top, size);
+      break;
+    }
+
+    case DW_OP_const1u: push(cursor.read_u8());        break;
+    case DW_OP_const1s: push(cursor.read_s8());        break;
+    case DW_OP_const2u: push(cursor.read_u16());       break;
+    case DW_OP_const2s: push(cursor.read_s16());       break;
+    case DW_OP_const4u: push(cursor.read_u32());       break;
+    case DW_OP_const4s: push(cursor.read_s32());       break;
+    case DW_OP_const8u: push(cursor.read_u64());       break;
+    case DW_OP_const8s: push(cursor.read_s64());       break;
+    case DW_OP_constu:  push(cursor.read_uleb128());   break;
+    case DW_OP_consts:  push(cursor.read_sleb128());   break;
+
+    case DW_OP_dup:  need(1); push(top); break;
+    case DW_OP_drop: need(1); stack_size--; break;
+    case DW_OP_over: need(2); push(stack[stack_size - 2]); break;
+
+    case DW_OP_pick: {
+      u8 index = cursor.read_u8();
+      need(index + 1u);
+      push(stack[stack_size - 1 - index]);
+      break;
+    }
+
+    case DW_OP_swap: {
+      need(2);
+      auto value = top;
+      top = stack[stack_size - 2];
+      stack[stack_size - 2] = value;
+      break;
+    }
+
+    case DW_OP_rot: {
+      need(3);
+      auto value = top;
+      top = stack[stack_size - 2];
+      stack[stack_size - 2] = stack[stack_size - 3];
+      stack[stack_size - 3] = value;
+      break;
+    }
+
+    case DW_OP_abs: need(1); if ((s64)top < 0)  top = -(s64)top; break;
+    case DW_OP_neg: need(1); top = -(s64)top; break;
+    case DW_OP_not: need(1); top = ~top; break;
+    case DW_OP_plus_uconst: need(1); top += cursor.read_uleb128(); break;
+
+    case DW_OP_and: case DW_OP_div: case DW_OP_minus: case DW_OP_mod: case DW_OP_mul: case DW_OP_or:
+    case DW_OP_plus: case DW_OP_shl: case DW_OP_shr: case DW_OP_shra: case DW_OP_xor:
+    case DW_OP_eq: case DW_OP_ge: case DW_OP_gt: case DW_OP_le: case DW_OP_lt: case DW_OP_ne: {
+      need(2);
+      auto second = stack[--stack_size];
+      auto first = top;
+
+      switch (operation) {
+      case DW_OP_and:   top = first & second; break;
+      case DW_OP_div:   if (second == 0)  return false;  top = (s64)first / (s64)second; break;
+      case DW_OP_minus: top = first - second; break;
+      case DW_OP_mod:   if (second == 0)  return false;  top = first % second; break;
+      case DW_OP_mul:   top = first * second; break;
+      case DW_OP_or:    top = first | second; break;
+      case DW_OP_plus:  top = first + second; break;
+      case DW_OP_shl:   top = first << second; break;
+      case DW_OP_shr:   top = first >> second; break;
+      case DW_OP_shra:  top = (s64)first >> second; break;
+      case DW_OP_xor:   top = first ^ second; break;
+      case DW_OP_eq:    top = (s64)first == (s64)second; break;
+      case DW_OP_ge:    top = (s64)first >= (s64)second; break;
+      case DW_OP_gt:    top = (s64)first >  (s64)second; break;
+      case DW_OP_le:    top = (s64)first <= (s64)second; break;
+      case DW_OP_lt:    top = (s64)first <  (s64)second; break;
+      case DW_OP_ne:    top = (s64)first != (s64)second; break;
+      }
+      break;
+    }
+
+    case DW_OP_skip: {
+      s16 offset = cursor.read_s16();
+      cursor.seek(cursor.offset() + offset);
+      break;
+    }
+
+    case DW_OP_bra: {
+      need(1);
+      s16 offset = cursor.read_s16();
+      if (stack[--stack_size] != 0)  cursor.seek(cursor.offset() + offset);
+      break;
+    }
+
+    case DW_OP_regx:
+      result->type = Location_Type::REGISTER;
+      result->value = cursor.read_uleb128();
+      return true;
+
+    case DW_OP_bregx: {
+      u64 value;
+      if (!read_context_register(context, cursor.read_uleb128(), &value))  return false;
+      push(value + cursor.read_sleb128());
+      break;
+    }
+
+    case DW_OP_fbreg: {
+      u64 frame_base;
+      if (!get_frame_base(context, &frame_base))  return false;
+      push(frame_base + cursor.read_sleb128());
+      break;
+    }
+
+    case DW_OP_call_frame_cfa: {
+      u64 cfa;
+      if (!get_cfa(context, &cfa))  return false;
+      push(cfa);
+      break;
+    }
+
+    case DW_OP_piece:
+      // @Incomplete: Only the first piece of composite location is evaluated
+      need(1);
+      result->value = top;
+      return true;
+
+    case DW_OP_stack_value:
+      need(1);
+      result->type = Location_Type::VALUE;
+      result->value = top;
+      return true;
+
+    case DW_OP_implicit_value: {
+      u64 size = cursor.read_uleb128();
+      result->type = Location_Type::VALUE;
+      result->value = 0;
+      memcpy(&result->value, cursor.pointer, size < sizeof(u64) ? size : sizeof(u64));
+      return true;
+    }
+
+    case DW_OP_nop:
+      break;
+
+    default:
+      // Entry values, TLS and typed stack operations aren't supported
+      return false;
+    }
+  }
+
+  #undef push
+  #undef need
+  #undef top
+
+  if (stack_size == 0)  return false;
+
+  result->value = stack[stack_size - 1];
+  return true;
+}
+
+
+/////////////////////////////////////
+//
+//  Location lists
+//
+
+enum DWARF_Location_List_Entry : u8 {
+  DW_LLE_end_of_list = 0x00,
+  DW_LLE_base_addressx, DW_LLE_startx_endx, DW_LLE_startx_length, DW_LLE_offset_pair,
+  DW_LLE_default_location, DW_LLE_base_address, DW_LLE_start_end, DW_LLE_start_length,
+};
+
+constexpr dwarf::DW_AT DW_AT_addr_base = (dwarf::DW_AT)0x73;
+
+// Ranges are in DWARF addresses. Single expression covers the whole address space.
+struct Location_Range {
+  u64 low_pc;
+  u64 high_pc;
+  Location_Expression expression;
+};
+
+u64 get_compilation_unit_base_address(const dwarf::die &die) {
+  auto &cu_die = die.get_unit().root();
+  if (cu_die.has(dwarf::DW_AT::low_pc))  return dwarf::at_low_pc(cu_die);
+  return 0;
+}
+
+// .debug_loc of DWARF 4
+void parse_location_list_v4(Data_Cursor *cursor, u64 base_address, Array<Location_Range> *ranges) {
+  while (!cursor->at_end()) {
+    u64 start = cursor->read_u64();
+    u64 end = cursor->read_u64();
+
+    if (start == 0 && end == 0)  break;
+
+    if (start == (u64)-1) {
+      base_address = end;
+      continue;
+    }
+
+    u16 size = cursor->read_u16();
+    ranges->add((Location_Range){base_address + start, base_address + end, {cursor->pointer, size}});
+    cursor->skip(size);
+  }
+}
+
+inline u64 read_debug_address(Debugger *dbg, u64 addr_base, u64 index) {
+  auto &section = dbg->debug_elf.get_section(".debug_addr");
+  if (!section.valid())  return 0;
+
+  Data_Cursor cursor;
+  cursor.init(section.data(), section.size());
+  cursor.seek(addr_base + index * sizeof(u64));
+  return cursor.read_u64();
+}
+
+// .debug_loclists of DWARF 5
+void parse_location_list_v5(Debugger *dbg, Data_Cursor *cursor, u64 base_address, u64 addr_base, Array<Location_Range> *ranges) {
+  while (!cursor->at_end()) {
+    u8 kind = cursor->read_u8();
+    u64 start = 0;
+    u64 end = 0;
+
+    switch (kind) {
+    case DW_LLE_end_of_list:
+      return;
+
+    case DW_LLE_base_addressx:
+      base_address = read_debug_address(dbg, addr_base, cursor->read_uleb128());
+      continue;
+
+    case DW_LLE_base_address:
+      base_address = cursor->read_u64();
+      continue;
+
+    case DW_LLE_startx_endx:
+      start = read_debug_address(dbg, addr_base, cursor->read_uleb128());
+      end = read_debug_address(dbg, addr_base, cursor->read_uleb128());
+      break;
+
+    case DW_LLE_startx_length:
+      start = read_debug_address(dbg, addr_base, cursor->read_uleb128());
+      end = start + cursor->read_uleb128();
+      break;
+
+    case DW_LLE_offset_pair:
+      start = base_address + cursor->read_uleb128();
+      end = base_address + cursor->read_uleb128();
+      break;
+
+    case DW_LLE_default_location:
+      start = 0;
+      end = (u64)-1;
+      break;
+
+    case DW_LLE_start_end:
+      start = cursor->read_u64();
+      end = cursor->read_u64();
+      break;
+
+    case DW_LLE_start_length:
+      start = cursor->read_u64();
+      end = start + cursor->read_uleb128();
+      break;
+
+    default:
+      return;
+    }
+
+    u64 size = cursor->read_uleb128();
+    ranges->add((Location_Range){start, end, {cursor->pointer, size}});
+    cursor->skip(size);
+  }
+}
+
+void parse_location(Debugger *dbg, const dwarf::die &die, const dwarf::value &value, Array<Location_Range> *ranges) {
+  switch (value.get_type()) {
+  case dwarf::value::type::exprloc:
+  case dwarf::value::type::block: {
+    size_t size = 0;
+    auto data = static_cast <const u8 *>(value.as_block(&size));
+    ranges->add((Location_Range){0, (u64)-1, {data, size}});
+    break;
+  }
+
+  case dwarf::value::type::loclist: {
+    auto offset = value.as_sec_offset();
+    auto base_address = get_compilation_unit_base_address(die);
+
+    auto &debug_loc = dbg->debug_elf.get_section(".debug_loc");
+    if (debug_loc.valid()) {
+      Data_Cursor cursor;
+      cursor.init(debug_loc.data(), debug_loc.size());
+      cursor.seek(offset);
+      parse_location_list_v4(&cursor, base_address, ranges);
+      break;
+    }
+
+    auto &debug_loclists = dbg->debug_elf.get_section(".debug_loclists");
+    if (debug_loclists.valid()) {
+      auto &cu_die = die.get_unit().root();
+      u64 addr_base = cu_die.has(DW_AT_addr_base) ? cu_die[DW_AT_addr_base].as_sec_offset() : 8; // Right after the first header
+
+      Data_Cursor cursor;
+      cursor.init(debug_loclists.data(), debug_loclists.size());
+      cursor.seek(offset);
+      parse_location_list_v5(dbg, &cursor, base_address, addr_base, ranges);
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+
+/////////////////////////////////////
+//
+//  Locals of functions
+//
+// Variables of a function with their parsed locations are cached by function DIE offset,
+// so on every stop only the expression for the current PC is evaluated. The cache is
+// allocated by the session arena.
+// Variables of lexical blocks are visible only inside of PC ranges of their block.
+//
+
+struct Pc_Range {
+  u64 low_pc;
+  u64 high_pc;
+};
+
+struct Lexical_Block {
+  Array<Pc_Range> ranges; // DWARF addresses
+};
+
+struct Local_Variable_Info {
+  char *name = nullptr;
+  Type *type = nullptr;
+
+  s32 block_index = -1; // Variables with -1 are visible in the whole function
+  bool is_parameter = false;
+
+  Array<Location_Range> locations;
+
+  bool has_const_value = false;
+  u64 const_value = 0;
+};
+
+struct Function_Locals {
+  Location_Expression frame_base;
+  Array<Local_Variable_Info> variables;
+  Array<Lexical_Block> blocks;
+};
+
+struct Locals_Cache {
+  Hash_Table<u64, Function_Locals *> function_map;
+  Arena *arena;
+
+  Function_Locals *globals = nullptr; // Variables of compilation units, built on first lookup of a global
+};
+
+Locals_Cache * get_locals_cache(Debugger *dbg) {
+  if (!dbg->locals_cache) {
+    dbg->locals_cache = static_cast <Locals_Cache *>(dbg->session_arena.allocate(sizeof(Locals_Cache)));
+    *dbg->locals_cache = Locals_Cache();
+    dbg->locals_cache->function_map.init();
+    dbg->locals_cache->arena = &dbg->session_arena;
+  }
+
+  return dbg->locals_cache;
+}
+
+Function_Locals * add_function_locals(Locals_Cache *cache) {
+  auto locals = static_cast <Function_Locals *>(cache->arena->allocate(sizeof(Function_Locals)));
+  *locals = Function_Locals();
+  locals->variables.allocator = get_allocator(cache->arena);
+  locals->variables.init();
+  locals->blocks.allocator = get_allocator(cache->arena);
+  locals->blocks.init();
+
+  return locals;
+}
+
+// Memory of the cache is released with the session arena
+void free_locals_cache(Debugger *dbg) {
+  auto cache = dbg->locals_cache;
+  if (!cache)  return;
+
+  cache->function_map.deinit();
+  dbg->locals_cache = nullptr;
+}
+
+// Attributes of concrete instances of inlined functions are in their abstract origins,
+// and attributes of definitions of static members are in their declarations
+inline dwarf::die get_origin_die(const dwarf::die &die) {
+  if (die.has(dwarf::DW_AT::name))  return die;
+  if (die.has(dwarf::DW_AT::abstract_origin))  return dwarf::at_abstract_origin(die);
+  if (die.has(dwarf::DW_AT::specification))  return die[dwarf::DW_AT::specification].as_reference();
+  return die;
+}
+
+void add_local_variable(Debugger *dbg, const dwarf::die &die, s32 block_index, Function_Locals *locals) {
+  auto origin = get_origin_die(die);
+
+  Local_Variable_Info variable;
+  variable.block_index = block_index;
+  variable.is_parameter = (die.tag == dwarf::DW_TAG::formal_parameter);
+  variable.name = dbg->strings.intern(origin.has(dwarf::DW_AT::name) ? origin[dwarf::DW_AT::name].as_cstr() : "?");
+  variable.type = origin.has(dwarf::DW_AT::type) ? get_type(dbg, dwarf::at_type(origin)) : nullptr;
+  variable.locations.allocator = get_allocator(&dbg->session_arena);
+  variable.locations.init();
+
+  if (die.has(dwarf::DW_AT::location)) {
+    parse_location(dbg, die, die[dwarf::DW_AT::location], &variable.locations);
+  } else if (die.has(dwarf::DW_AT::const_value)) {
+    auto value = die[dwarf::DW_AT::const_value];
+    variable.has_const_value = true;
+
+    switch (value.get_type()) {
+    case dwarf::value::type::sconstant:
+      variable.const_value = value.as_sconstant();
+      break;
+    case dwarf::value::type::block: {
+      size_t size = 0;
+      auto data = value.as_block(&size);
+      memcpy(&variable.const_value, data, size < sizeof(u64) ? size : sizeof(u64));
+      break;
+    }
+    default:
+      variable.const_value = value.as_uconstant();
+      break;
+    }
+  }
+
+  locals->variables.add(variable);
+}
+
+void add_scope_variables(Debugger *dbg, const dwarf::die &scope_die, s32 block_index, Function_Locals *locals) {
+  for (const auto &die : scope_die) {
+    switch (die.tag) {
+    case dwarf::DW_TAG::formal_parameter:
+    case dwarf::DW_TAG::variable:
+      add_local_variable(dbg, die, block_index, locals);
+      break;
+
+    case dwarf::DW_TAG::lexical_block: {
+      Lexical_Block block;
+      block.ranges.allocator = get_allocator(&dbg->session_arena);
+      block.ranges.init();
+      for (const auto &range : dwarf::die_pc_range(die)) {
+        block.ranges.add((Pc_Range){range.low, range.high});
+      }
+
+      // Blocks without ranges don't limit the scope, their variables belong to the outer one
+      s32 inner_block_index = block_index;
+      if (block.ranges.count > 0) {
+        locals->blocks.add(block);
+        inner_block_index = locals->blocks.count - 1;
+      } else {
+        block.ranges.deinit();
+      }
+
+      add_scope_variables(dbg, die, inner_block_index, locals);
+      break;
+    }
+
+    default:
+      // Variables of inlined subroutines aren't collected
+      break;
+    }
+  }
+}
+
+Function_Locals * get_function_locals(Debugger *dbg, const dwarf::die &function_die) {
+  auto cache = get_locals_cache(dbg);
+
+  auto offset = function_die.get_section_offset();
+  auto cached_locals = cache->function_map[offset];
+  count_cache_access(dbg, Stats_Cache::LOCALS, cached_locals != nullptr);
+  if (cached_locals)  return *cached_locals;
+
+  auto locals = add_function_locals(cache);
+
+  if (function_die.has(dwarf::DW_AT::frame_base)) {
+    Small_Array<Location_Range, 4> frame_base;
+    frame_base.init();
+    defer { frame_base.deinit(); };
+
+    parse_location(dbg, function_die, function_die[dwarf::DW_AT::frame_base], &frame_base);
+    if (frame_base.count > 0)  locals->frame_base = frame_base[0].expression;
+  }
+
+  add_scope_variables(dbg, function_die, -1, locals);
+
+  cache->function_map.insert(offset, locals);
+
+  return locals;
+}
+
+Function_Locals * get_global_variables(Debugger *dbg) {
+  auto cache = get_locals_cache(dbg);
+  if (cache->globals)  return cache->globals;
+
+  cache->globals = add_function_locals(cache);
+
+  for (const auto &cu : dbg->dwarf.compilation_units()) {
+    for (const auto &die : cu.root()) {
+      if (die.tag != dwarf::DW_TAG::variable)  continue;
+      if (!die.has(dwarf::DW_AT::location) && !die.has(dwarf::DW_AT::const_value))  continue; // Declarations
+
+      add_local_variable(dbg, die, -1, cache->globals);
+    }
+  }
+
+  return cache->globals;
+}
+
+bool is_variable_in_scope(Function_Locals *locals, Local_Variable_Info *variable, u64 pc) {
+  if (variable->block_index < 0)  return true;
+
+  // Nested blocks are inside of their outer blocks, so only the innermost one is checked
+  For_Pointer (locals->blocks[variable->block_index].ranges) {
+    if (pc >= it->low_pc && pc < it->high_pc)  return true;
+  }
+  return false;
+}
+
+// Evaluates location of the variable at given PC (DWARF address)
+Location get_variable_location(Expression_Context *context, Local_Variable_Info *variable, u64 pc) {
+  Location location;
+
+  if (variable->has_const_value) {
+    location.type = Location_Type::VALUE;
+    location.value = variable->const_value;
+    return location;
+  }
+
+  For_Pointer (variable->locations) {
+    if (pc < it->low_pc || pc >= it->high_pc)  continue;
+
+    if (it->expression.size == 0 || !evaluate_expression(context, it->expression, &location)) {
+      location.type = Location_Type::UNAVAILABLE;
+    }
+    return location;
+  }
+
+  location.type = Location_Type::UNAVAILABLE;
+  return location;
+}
+
+// Registers of caller frames are known only if they were restored by the unwinder
+void read_register_variable(Debugger *dbg, Expression_Context *context, u32 dwarf_register, Variable *variable) {
+  variable->data_size = variable->size < sizeof(u64) ? variable->size : sizeof(u64);
+
+  Register reg;
+  u64 value;
+  if (dwarf_register_to_register(dwarf_register, &reg) && read_context_register(context, dwarf_register, &value)) {
+    variable->location = Variable_Location::REGISTER;
+    variable->reg = reg;
+    variable->value = value;
+  } else if (dwarf_register >= dwarf_xmm0_register && dwarf_register <= dwarf_xmm15_register && !context->is_caller_frame) {
+    user_fpregs_struct fpregs;
+    debugee_ptrace(dbg, PTRACE_GETFPREGS, nullptr, &fpregs);
+
+    // @Note: No descriptors for vector registers, so their contents are shown as a computed value
+    auto xmm = reinterpret_cast <u8 *>(&fpregs.xmm_space[(dwarf_register - dwarf_xmm0_register) * 4]);
+    variable->location = Variable_Location::VALUE;
+    variable->data_size = variable->size < 16 ? variable->size : 16;
+    variable->data = static_cast <u8 *>(allocate_memory(context->allocator, 16));
+    memset(variable->data, 0, 16);
+    memcpy(variable->data, xmm, variable->data_size);
+    memcpy(&variable->value, xmm, sizeof(u64));
+    return;
+  } else {
+    variable->location = Variable_Location::OPTIMIZED_OUT;
+    variable->data_size = 0;
+  }
+
+  variable->data = static_cast <u8 *>(allocate_memory(context->allocator, sizeof(u64)));
+  memcpy(variable->data, &variable->value, sizeof(u64));
+}
+
+// Contents of variables in memory aren't read here, so they could be read in batch
+void set_variable_location(Debugger *dbg, Expression_Context *context, Location location, Variable *variable) {
+  switch (location.type) {
+  case Location_Type::MEMORY:
+    variable->location = Variable_Location::MEMORY;
+    variable->address = location.value;
+    break;
+
+  case Location_Type::REGISTER:
+    read_register_variable(dbg, context, location.value, variable);
+    break;
+
+  case Location_Type::VALUE:
+    variable->location = Variable_Location::VALUE;
+    variable->value = location.value;
+    variable->data_size = variable->size < sizeof(u64) ? variable->size : sizeof(u64);
+    variable->data = static_cast <u8 *>(allocate_memory(context->allocator, sizeof(u64)));
+    memcpy(variable->data, &variable->value, sizeof(u64));
+    break;
+
+  case Location_Type::UNAVAILABLE:
+    variable->location = Variable_Location::OPTIMIZED_OUT;
+    break;
+  }
+}
+
+DBG_NAMESPACE_END
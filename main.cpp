@@ -43,13 +43,18 @@ enum Debugger_Command_Type : u8 {
   CONTINUE_EXECUTION,
   STEP_OVER,
   STEP_IN,
-  STEP_OUT
+  STEP_OUT,
+  PROFILE,
+  TRACE,
+  COLLECT_COVERAGE,
+  LOAD_FRAME_VARIABLES,
+  EVALUATE_WATCHES
 };
 
 
 struct Debugger_Debug_Arguments {
   char *executable_path = nullptr;
-  char *arguments = nullptr;
+  dbg::Launch_Options options;
 };
 
 struct Debugger_Attach_Arguments {
@@ -65,11 +70,34 @@ struct Debugger_Breakpoint_Arguments {
   dbg::Breakpoint * breakpoint;
 };
 
+struct Debugger_Profile_Arguments {
+  u32 frequency;
+  float64 duration;
+  dbg::Profiler_Backend backend;
+};
+
+struct Debugger_Trace_Arguments {
+  const char * pattern;
+  float64 duration;
+};
+
+struct Debugger_Coverage_Arguments {
+  float64 duration;
+};
+
+struct Debugger_Frame_Arguments {
+  u32 frame_index;
+};
+
 union Debugger_Command_Arguments {
   Debugger_Debug_Arguments debug_arguments;
   Debugger_Attach_Arguments attach_arguments;
   Debugger_Set_Breakpoint_Arguments set_breakpoint_arguments;
   Debugger_Breakpoint_Arguments breakpoint_arguments;
+  Debugger_Profile_Arguments profile_arguments;
+  Debugger_Trace_Arguments trace_arguments;
+  Debugger_Coverage_Arguments coverage_arguments;
+  Debugger_Frame_Arguments frame_arguments;
 };
 
 struct Debugger_Command {
@@ -96,8 +124,8 @@ inline void send_command(Debugger_Command_Type command) {
   send_command(command, (Debugger_Command_Arguments){});
 }
 
-inline void send_command(Debugger_Command_Type command, char *executable_path, char *arguments) {
-  auto args = (Debugger_Debug_Arguments){executable_path, arguments};
+inline void send_command(Debugger_Command_Type command, char *executable_path, dbg::Launch_Options options) {
+  auto args = (Debugger_Debug_Arguments){executable_path, options};
   send_command(command, (Debugger_Command_Arguments){.debug_arguments = args});
 }
 
@@ -116,6 +144,24 @@ inline void send_command(Debugger_Command_Type command, dbg::Breakpoint * breakp
   send_command(command, (Debugger_Command_Arguments){.breakpoint_arguments = args});
 }
 
+inline void send_command(Debugger_Command_Type command, u32 frequency, float64 duration, dbg::Profiler_Backend backend) {
+  auto args = (Debugger_Profile_Arguments){frequency, duration, backend};
+  send_command(command, (Debugger_Command_Arguments){.profile_arguments = args});
+}
+
+// @Note: Taking arguments struct, as (const char *, float64) overload is ambiguous with the breakpoint one
+inline void send_command(Debugger_Command_Type command, Debugger_Trace_Arguments args) {
+  send_command(command, (Debugger_Command_Arguments){.trace_arguments = args});
+}
+
+inline void send_command(Debugger_Command_Type command, Debugger_Coverage_Arguments args) {
+  send_command(command, (Debugger_Command_Arguments){.coverage_arguments = args});
+}
+
+inline void send_command(Debugger_Command_Type command, Debugger_Frame_Arguments args) {
+  send_command(command, (Debugger_Command_Arguments){.frame_arguments = args});
+}
+
 Debugger_Command get_command() {
   auto result = Global_command;
   Global_command = (Debugger_Command){};
@@ -131,14 +177,20 @@ void continue_command_thread() {
 
 void debugger_loop(Debugger_GUI *debugger_gui) {
   auto &dbg = debugger_gui->d;
+  set_timeline_thread_name("debugger");
+
   while (true) {
     auto c = get_command();
     if (c.type) {
+      timeline_zone("debugger command");
+
+      auto lock_zone = begin_timeline_zone("wait for lock");
       std::lock_guard<std::mutex> lock(Global_debugger_mutex);
+      end_timeline_zone(&lock_zone);
 
       switch (c.type) {
       case DEBUG:
-        dbg::debug(dbg, c.arguments.debug_arguments.executable_path, c.arguments.debug_arguments.arguments);
+        dbg::debug(dbg, c.arguments.debug_arguments.executable_path, c.arguments.debug_arguments.options);
         break;
 
       case ATTACH:
@@ -169,6 +221,25 @@ void debugger_loop(Debugger_GUI *debugger_gui) {
       case STEP_IN:            dbg::step_in(dbg); break;
       case STEP_OUT:           dbg::step_out(dbg); break;
 
+      case PROFILE:
+        dbg::profile(dbg, c.arguments.profile_arguments.frequency, c.arguments.profile_arguments.duration,
+                     &debugger_gui->m_profile, c.arguments.profile_arguments.backend);
+        break;
+
+      case TRACE:
+        dbg::trace_functions(dbg, c.arguments.trace_arguments.pattern, c.arguments.trace_arguments.duration, &debugger_gui->m_trace);
+        break;
+
+      case COLLECT_COVERAGE:
+        dbg::collect_coverage(dbg, c.arguments.coverage_arguments.duration, &debugger_gui->m_coverage);
+        break;
+
+      case LOAD_FRAME_VARIABLES:
+        request_frame_variables(debugger_gui, c.arguments.frame_arguments.frame_index);
+        break;
+
+      case EVALUATE_WATCHES: break; // Watches are evaluated in update_in_debugger_thread
+
       default: assert(false && "Unknown debugger command");
       }
 
@@ -177,6 +248,13 @@ void debugger_loop(Debugger_GUI *debugger_gui) {
 
     if (!Global_wait_for_command_finished) continue_command_thread();
 
+    // Breakpoints requested while debug info is indexed are set as their units get indexed
+    if (dbg::get_indexing_progress(dbg, nullptr, nullptr) || dbg->pending_breakpoints.count > 0) {
+      timeline_zone("update indexing");
+      std::lock_guard<std::mutex> lock(Global_debugger_mutex);
+      if (dbg::update_indexing(dbg))  update_in_debugger_thread(debugger_gui);
+    }
+
     sleep(0.001); // @Hack: Think of a better solution
   }
 }
@@ -206,6 +284,8 @@ s32 main() {
   debugger_gui.init_debugger();
 
   std::thread gui_thread([&]() {
+    set_timeline_thread_name("gui");
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
       printf("Error: %s\n", SDL_GetError());
       return -1;
@@ -253,10 +333,16 @@ s32 main() {
           done = true;
       }
 
+      timeline_zone("frame");
+
       BeginFrame();
 
       {
+        auto lock_zone = begin_timeline_zone("wait for lock");
         std::lock_guard<std::mutex> lock(Global_debugger_mutex);
+        end_timeline_zone(&lock_zone);
+
+        timeline_zone("draw");
 
         // ImGui::ShowDemoWindow(nullptr);
         debugger_gui.draw();
@@ -264,7 +350,10 @@ s32 main() {
         debugger_gui.update();
       }
 
-      EndFrame(window, io);
+      {
+        timeline_zone("render");
+        EndFrame(window, io);
+      }
     }
 
     // Clean up
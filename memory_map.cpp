@@ -0,0 +1,186 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Memory map
+//
+// Regions are parsed from /proc/<pid>/maps, read with a single buffer. The map is kept
+// between stops, as mappings change rarely. It is refreshed on a lookup miss (at most once
+// per stop) or when the dynamic linker reports loading of libraries.
+//
+
+void deinit(Memory_Map *map) {
+  map->regions.deinit();
+  if (map->text)  free(map->text);
+  map->text = nullptr;
+  map->refresh_stop = 0;
+}
+
+inline u64 parse_hex(char **c) {
+  u64 result = 0;
+  while (true) {
+    char digit = **c;
+    if      (digit >= '0' && digit <= '9')  result = (result << 4) | (digit - '0');
+    else if (digit >= 'a' && digit <= 'f')  result = (result << 4) | (digit - 'a' + 10);
+    else break;
+    (*c)++;
+  }
+  return result;
+}
+
+inline void skip_field(char **c) {
+  while (**c != ' ' && **c != '\n' && **c != '\0')  (*c)++;
+  while (**c == ' ')  (*c)++;
+}
+
+// Reads the whole file with as few syscalls as possible, as procfs files have no size
+char * read_proc_file(const char *path, u64 *size) {
+  auto fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)  return nullptr;
+  defer { close(fd); };
+
+  u64 capacity = 64 * 1024;
+  u64 length = 0;
+  auto buffer = static_cast <char *>(malloc(capacity + 1));
+
+  while (true) {
+    if (length == capacity) {
+      capacity *= 2;
+      buffer = static_cast <char *>(realloc(buffer, capacity + 1));
+    }
+
+    auto bytes_read = read(fd, buffer + length, capacity - length);
+    if (bytes_read <= 0)  break;
+    length += bytes_read;
+  }
+
+  buffer[length] = '\0';
+  *size = length;
+  return buffer;
+}
+
+void refresh_memory_map(Debugger *dbg) {
+  auto map = &dbg->memory_map;
+  deinit(map);
+  map->regions.init();
+  map->refresh_stop = dbg->stop_count;
+
+  char maps_path[64];
+  sprintf(maps_path, "/proc/%d/maps", dbg->debugee_pid);
+
+  u64 size;
+  map->text = read_proc_file(maps_path, &size);
+  if (!map->text)  return;
+
+  // Lines look like: 555555554000-555555555000 r--p 00000000 103:02 1234   /path/to/file
+  auto c = map->text;
+  while (*c != '\0') {
+    Memory_Region region;
+    region.start = parse_hex(&c);
+    if (*c == '-')  c++;
+    region.end = parse_hex(&c);
+    while (*c == ' ')  c++;
+
+    region.permissions = 0;
+    if (c[0] == 'r')  region.permissions |= MEMORY_READ;
+    if (c[1] == 'w')  region.permissions |= MEMORY_WRITE;
+    if (c[2] == 'x')  region.permissions |= MEMORY_EXECUTE;
+    if (c[3] == 's')  region.permissions |= MEMORY_SHARED;
+    skip_field(&c);
+
+    region.offset = parse_hex(&c);
+    while (*c == ' ')  c++;
+
+    skip_field(&c); // Device
+    skip_field(&c); // Inode
+
+    // Path is terminated in place, anonymous regions have none
+    region.path = (*c != '\n' && *c != '\0') ? c : nullptr;
+    while (*c != '\n' && *c != '\0')  c++;
+    if (*c == '\n')  *c++ = '\0';
+
+    map->regions.add(region);
+  }
+
+  // @Note: Kernel lists regions sorted by address, which binary search relies on
+}
+
+Memory_Region * search_memory_region(Memory_Map *map, u64 address) {
+  s32 low = 0;
+  s32 high = map->regions.count - 1;
+
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    auto region = &map->regions.data[middle];
+
+    if (address < region->start) {
+      high = middle - 1;
+    } else if (address >= region->end) {
+      low = middle + 1;
+    } else {
+      return region;
+    }
+  }
+
+  return nullptr;
+}
+
+Memory_Region * find_memory_region(Debugger *dbg, u64 address) {
+  if (dbg->state == Debugger_State::NOT_LOADED)  return nullptr;
+
+  auto map = &dbg->memory_map;
+  if (map->regions.count < 0)  refresh_memory_map(dbg);
+
+  auto region = search_memory_region(map, address);
+
+  // Address could be mapped after the last refresh
+  if (!region && map->refresh_stop != dbg->stop_count) {
+    refresh_memory_map(dbg);
+    region = search_memory_region(map, address);
+  }
+
+  return region;
+}
+
+bool is_address_readable(Debugger *dbg, u64 address, u64 size) {
+  while (size > 0) {
+    auto region = find_memory_region(dbg, address);
+    if (!region || !(region->permissions & MEMORY_READ))  return false;
+
+    auto region_left = region->end - address;
+    if (size <= region_left)  break;
+
+    address += region_left;
+    size -= region_left;
+  }
+  return true;
+}
+
+// Memory_Map is owned by the debugger, returning pointer to it to not copy the regions
+Memory_Map * get_memory_map(Debugger *dbg) {
+  if (dbg->state == Debugger_State::NOT_LOADED) {
+    dbg_fail("debugged program isn't loaded");
+    return nullptr;
+  }
+
+  bool is_fresh = (dbg->memory_map.regions.count >= 0 && dbg->memory_map.refresh_stop == dbg->stop_count);
+  count_cache_access(dbg, Stats_Cache::MEMORY_MAP, is_fresh);
+
+  if (!is_fresh)  refresh_memory_map(dbg);
+
+  dbg_success();
+  return &dbg->memory_map;
+}
+
+void print_memory_map(Memory_Map *map) {
+  For_Pointer (map->regions) {
+    printf("%016lx-%016lx %c%c%c%c %08lx %s\n", it->start, it->end,
+           (it->permissions & MEMORY_READ)    ? 'r' : '-',
+           (it->permissions & MEMORY_WRITE)   ? 'w' : '-',
+           (it->permissions & MEMORY_EXECUTE) ? 'x' : '-',
+           (it->permissions & MEMORY_SHARED)  ? 's' : 'p',
+           it->offset, it->path ? it->path : "");
+  }
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,495 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Shared libraries
+//
+// The list of loaded objects is read from the rendezvous structure of the dynamic linker
+// (r_debug and its chain of link_maps). The linker calls _dl_debug_state before and after
+// every change of the chain, an internal breakpoint there keeps the list up to date across
+// dlopen/dlclose. ELF and DWARF of libraries are opened only when something asks for them.
+//
+
+struct Module_Symbol {
+  u64 low_pc; // File addresses, without load bias
+  u64 high_pc;
+  const char *name;               // Points into the string table of the ELF
+  char *demangled_name = nullptr; // Demangled on the first use
+};
+
+struct Module_Debug_Info {
+  char *path = nullptr;
+
+  elf::elf elf;
+  elf::elf debug_elf; // Library itself or its separate debug file
+  dwarf::dwarf dwarf;
+
+  bool is_missing = false; // File couldn't be read, not retried
+  bool is_dwarf_loaded = false;
+  bool has_dwarf = false;
+
+  Array<Module_Symbol> symbols; // Functions sorted by address, built on the first lookup
+
+  Unwind_Table *unwind_table = nullptr;
+  bool is_unwind_table_built = false;
+};
+
+constexpr u32 max_link_map_count = 4096; // Guards against cycles in a corrupted chain
+constexpr u32 max_module_path_length = 4096;
+
+void free_module_list(Module_List *list) {
+  For_Pointer (list->modules)  free(it->path);
+  list->modules.reset();
+}
+
+void free_modules(Debugger *dbg) {
+  auto list = &dbg->modules;
+
+  For_Pointer (list->modules)  free(it->path);
+  list->modules.deinit();
+
+  For (list->debug_infos) {
+    free(it->path);
+    For_it_Pointer (it->symbols, symbol) {
+      if (symbol->demangled_name)  free(symbol->demangled_name);
+    }
+    it->symbols.deinit();
+
+    if (it->unwind_table) {
+      it->unwind_table->cies.deinit();
+      it->unwind_table->fdes.deinit();
+      free(it->unwind_table);
+    }
+
+    delete it;
+  }
+  list->debug_infos.deinit();
+
+  if (list->rendezvous_breakpoint) {
+    if (list->rendezvous_breakpoint->enabled)  disable_breakpoint(dbg, list->rendezvous_breakpoint);
+    free(list->rendezvous_breakpoint);
+  }
+
+  *list = Module_List();
+}
+
+/////////////////////////////////////
+//
+//  Lazy loading of ELF and DWARF
+//
+
+Module_Debug_Info * get_module_debug_info(Debugger *dbg, Module *module) {
+  if (module->debug_info)  return module->debug_info;
+
+  auto list = &dbg->modules;
+  For (list->debug_infos) {
+    if (strcmp(it->path, module->path) == 0) {
+      module->debug_info = it;
+      return it;
+    }
+  }
+
+  auto info = new Module_Debug_Info();
+  info->path = strdup(module->path);
+  list->debug_infos.add(info);
+  module->debug_info = info;
+
+  auto fd = open(module->path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    info->is_missing = true; // Pseudo-objects like vdso have no file
+    return info;
+  }
+
+  try {
+    info->elf = elf::elf(elf::create_mmap_loader(fd));
+  } catch (elf::format_error ex) {
+    if (dbg->verbose)  printf("Warning: couldn't load ELF of %s: %s\n", module->path, ex.what());
+    info->is_missing = true;
+  } catch (std::system_error ex) {
+    if (dbg->verbose)  printf("Warning: couldn't load ELF of %s: %s\n", module->path, ex.what());
+    info->is_missing = true;
+  }
+
+  return info;
+}
+
+dwarf::dwarf * get_module_dwarf(Debugger *dbg, Module *module) {
+  if (module->is_main)  return &dbg->dwarf;
+
+  auto info = get_module_debug_info(dbg, module);
+  if (info->is_missing)  return nullptr;
+
+  if (!info->is_dwarf_loaded) {
+    info->is_dwarf_loaded = true;
+
+    // Most system libraries are stripped, symbol table is all there is without debug packages
+    auto debug_file_path = find_debug_file(dbg, info->elf, info->path, &info->debug_elf);
+    if (!debug_file_path)  return nullptr;
+    free(debug_file_path);
+
+    try {
+      info->dwarf = dwarf::dwarf(dwarf::elf::create_loader(info->debug_elf));
+      info->has_dwarf = true;
+    } catch (std::runtime_error ex) {
+      if (dbg->verbose)  printf("Warning: couldn't load debug info of %s: %s\n", info->path, ex.what());
+    }
+  }
+
+  return info->has_dwarf ? &info->dwarf : nullptr;
+}
+
+Unwind_Table * get_module_unwind_table(Debugger *dbg, Module *module) {
+  auto info = get_module_debug_info(dbg, module);
+  if (info->is_missing)  return nullptr;
+
+  if (!info->is_unwind_table_built) {
+    info->is_unwind_table_built = true;
+    info->unwind_table = build_unwind_table(dbg, info->elf);
+  }
+
+  return info->unwind_table;
+}
+
+s32 compare_module_symbols(const void *a, const void *b) {
+  auto first = static_cast <const Module_Symbol *>(a);
+  auto second = static_cast <const Module_Symbol *>(b);
+  if (first->low_pc < second->low_pc)  return -1;
+  if (first->low_pc > second->low_pc)  return 1;
+  return 0;
+}
+
+void build_module_symbols(Module_Debug_Info *info) {
+  info->symbols.init();
+
+  // Static symbol table is a superset of the dynamic one, when it isn't stripped
+  bool has_symtab = false;
+  for (auto &section : info->elf.sections()) {
+    if (section.get_hdr().type == elf::sht::symtab)  has_symtab = true;
+  }
+
+  auto symbol_table_type = has_symtab ? elf::sht::symtab : elf::sht::dynsym;
+  for (auto &section : info->elf.sections()) {
+    if (section.get_hdr().type != symbol_table_type)  continue;
+
+    for (auto sym : section.as_symtab()) {
+      auto &data = sym.get_data();
+      if (data.type() != elf::stt::func || data.value == 0 || data.size == 0)  continue;
+
+      Module_Symbol symbol;
+      symbol.low_pc = data.value;
+      symbol.high_pc = data.value + data.size;
+      symbol.name = sym.get_name(nullptr);
+      info->symbols.add(symbol);
+    }
+  }
+
+  qsort(info->symbols.data, info->symbols.count, sizeof(Module_Symbol), compare_module_symbols);
+}
+
+Module_Symbol * find_module_symbol(Module_Debug_Info *info, u64 pc) {
+  if (info->symbols.count < 0)  build_module_symbols(info);
+
+  // Last symbol starting at or before pc
+  s32 low = 0;
+  s32 high = info->symbols.count - 1;
+  Module_Symbol *result = nullptr;
+
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    if (info->symbols.data[middle].low_pc <= pc) {
+      result = &info->symbols.data[middle];
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  if (result && pc >= result->high_pc)  return nullptr;
+  return result;
+}
+
+// Names are owned by the debugger and valid until it's unloaded
+const char * find_module_function_name(Debugger *dbg, u64 address, u64 *function_address) {
+  auto module = find_module(dbg, address);
+  if (!module || module->is_main)  return nullptr;
+
+  auto info = get_module_debug_info(dbg, module);
+  if (info->is_missing)  return nullptr;
+
+  auto symbol = find_module_symbol(info, address - module->load_bias);
+  if (!symbol)  return nullptr;
+
+  if (!symbol->demangled_name) {
+    s32 status = -1;
+    if (symbol->name[0] == '_' && symbol->name[1] == 'Z') {
+      symbol->demangled_name = abi::__cxa_demangle(symbol->name, nullptr, nullptr, &status);
+    }
+    if (status != 0)  symbol->demangled_name = strdup(symbol->name);
+  }
+
+  if (function_address)  *function_address = symbol->low_pc + module->load_bias;
+  return symbol->demangled_name;
+}
+
+u64 find_module_symbol_address(Debugger *dbg, Module *module, const char *name) {
+  auto info = get_module_debug_info(dbg, module);
+  if (info->is_missing)  return 0;
+
+  // Linker symbols aren't functions with size, all the tables are searched
+  for (auto &section : info->elf.sections()) {
+    auto type = section.get_hdr().type;
+    if (type != elf::sht::symtab && type != elf::sht::dynsym)  continue;
+
+    for (auto sym : section.as_symtab()) {
+      auto &data = sym.get_data();
+      if (data.value != 0 && strcmp(sym.get_name(nullptr), name) == 0)  return data.value + module->load_bias;
+    }
+  }
+
+  return 0;
+}
+
+/////////////////////////////////////
+//
+//  Module list
+//
+
+inline bool is_same_mapping(Memory_Region *a, Memory_Region *b) {
+  return a->path && b->path && strcmp(a->path, b->path) == 0;
+}
+
+// Range is the run of neighbouring regions mapped from the same file as the given address
+void set_module_range(Debugger *dbg, Module *module, u64 address) {
+  auto region = find_memory_region(dbg, address);
+  if (!region)  return;
+
+  auto &regions = dbg->memory_map.regions;
+  s32 first = region - regions.data;
+  s32 last = first;
+
+  while (first > 0 && is_same_mapping(&regions[first - 1], region))  first--;
+  while (last + 1 < regions.count && is_same_mapping(&regions[last + 1], region))  last++;
+
+  module->start = regions[first].start;
+  module->end = regions[last].end;
+}
+
+void add_module(Module_List *list, const char *path, u64 load_bias, bool is_main) {
+  // Names in link maps aren't canonical, e.g. /lib64 is a link to /usr/lib
+  auto resolved_path = realpath(path, nullptr);
+
+  Module module;
+  module.path = resolved_path ? resolved_path : strdup(path); // Pseudo-objects like vdso have no file
+  auto slash = strrchr(module.path, '/');
+  module.name = slash ? slash + 1 : module.path;
+  module.load_bias = load_bias;
+  module.is_main = is_main;
+
+  // Debug info loaded before the refresh is reused
+  For (list->debug_infos) {
+    if (strcmp(it->path, module.path) == 0)  module.debug_info = it;
+  }
+
+  list->modules.add(module);
+}
+
+s32 compare_modules(const void *a, const void *b) {
+  auto first = static_cast <const Module *>(a);
+  auto second = static_cast <const Module *>(b);
+  if (first->start < second->start)  return -1;
+  if (first->start > second->start)  return 1;
+  return 0;
+}
+
+// DT_DEBUG entry of the executable's dynamic section is filled by the dynamic linker
+u64 find_r_debug_from_dynamic_section(Debugger *dbg) {
+  auto &section = dbg->elf.get_section(".dynamic");
+  if (!section.valid())  return 0;
+
+  auto address = offset_dwarf_address(dbg, section.get_hdr().addr);
+  auto count = section.size() / sizeof(ElfW(Dyn));
+
+  For_Count (count, i) {
+    ElfW(Dyn) entry;
+    if (!read_memory(dbg, address + i * sizeof(ElfW(Dyn)), &entry, sizeof(entry)))  return 0;
+
+    if (entry.d_tag == DT_NULL)  break;
+    if (entry.d_tag == DT_DEBUG)  return entry.d_un.d_ptr;
+  }
+
+  return 0;
+}
+
+void insert_rendezvous_breakpoint(Debugger *dbg) {
+  auto list = &dbg->modules;
+  if (!list->rendezvous_address)  return;
+
+  if (!list->rendezvous_breakpoint) {
+    list->rendezvous_breakpoint = static_cast <Breakpoint *>(calloc(1, sizeof(Breakpoint)));
+  }
+
+  auto breakpoint = list->rendezvous_breakpoint;
+  if (breakpoint->enabled && breakpoint->address == list->rendezvous_address)  return;
+
+  // Previous process could have had the breakpoint elsewhere, its memory is gone
+  breakpoint->enabled = false;
+  breakpoint->address = list->rendezvous_address;
+
+  dbg->breakpoint_map.insert(breakpoint->address, breakpoint);
+  enable_breakpoint(dbg, breakpoint);
+}
+
+void refresh_modules(Debugger *dbg) {
+  auto list = &dbg->modules;
+  free_module_list(list);
+  list->refresh_stop = dbg->stop_count;
+
+  if (!list->r_debug_address)  list->r_debug_address = find_r_debug_from_dynamic_section(dbg);
+
+  r_debug rendezvous = {};
+  if (list->r_debug_address)  read_memory(dbg, list->r_debug_address, &rendezvous, sizeof(rendezvous));
+
+  if (!list->rendezvous_address && rendezvous.r_brk) {
+    list->rendezvous_address = rendezvous.r_brk;
+    insert_rendezvous_breakpoint(dbg);
+  }
+
+  auto link_map_address = (u64)rendezvous.r_map;
+  u32 link_map_count = 0;
+
+  while (link_map_address && link_map_count++ < max_link_map_count) {
+    link_map entry;
+    if (!read_memory(dbg, link_map_address, &entry, sizeof(entry)))  break;
+    link_map_address = (u64)entry.l_next;
+
+    char path[max_module_path_length];
+    path[0] = '\0';
+    if (entry.l_name)  read_memory(dbg, (u64)entry.l_name, path, sizeof(path));
+    path[sizeof(path) - 1] = '\0';
+
+    // Executable is the first object and has no name
+    bool is_main = (list->modules.count == 0 && path[0] == '\0');
+    if (path[0] == '\0' && !is_main)  continue;
+
+    add_module(list, is_main ? dbg->executable_path : path, is_main ? dbg->load_address : entry.l_addr, is_main);
+
+    // Dynamic section is always mapped, unlike the start of the file
+    set_module_range(dbg, &list->modules.back(), (u64)entry.l_ld);
+  }
+
+  // Linker isn't initialized yet, only the executable is known
+  if (list->modules.count == 0) {
+    add_module(list, dbg->executable_path, dbg->load_address, true);
+    set_module_range(dbg, &list->modules.back(), dbg->load_address);
+  }
+
+  qsort(list->modules.data, list->modules.count, sizeof(Module), compare_modules);
+}
+
+// Called when the process is stopped right after exec or attach
+void initialize_modules(Debugger *dbg) {
+  auto list = &dbg->modules;
+  list->r_debug_address = 0;
+  list->rendezvous_address = 0;
+
+  // At exec the dynamic linker hasn't filled the rendezvous structure yet,
+  // so its address and the address of the linker's hook are taken from the linker's symbols
+  for (auto &segment : dbg->elf.segments()) {
+    if (segment.get_hdr().type != elf::pt::interp)  continue;
+
+    auto interpreter_path = realpath(static_cast <const char *>(segment.data()), nullptr);
+    if (!interpreter_path)  break;
+    defer { free(interpreter_path); };
+
+    refresh_memory_map(dbg);
+
+    // @Note: Linker's first segment has zero address, so the start of the mapping is its bias
+    For_Pointer (dbg->memory_map.regions) {
+      if (it->offset != 0 || !it->path || strcmp(it->path, interpreter_path) != 0)  continue;
+
+      Module interpreter;
+      interpreter.path = interpreter_path;
+      interpreter.load_bias = it->start;
+
+      list->r_debug_address = find_module_symbol_address(dbg, &interpreter, "_r_debug");
+      list->rendezvous_address = find_module_symbol_address(dbg, &interpreter, "_dl_debug_state");
+      break;
+    }
+    break;
+  }
+
+  insert_rendezvous_breakpoint(dbg);
+  refresh_modules(dbg);
+}
+
+// The process is stopped at the linker's hook, breakpoint is already stepped back
+void handle_rendezvous(Debugger *dbg) {
+  r_debug rendezvous = {};
+  if (!dbg->modules.r_debug_address || !read_memory(dbg, dbg->modules.r_debug_address, &rendezvous, sizeof(rendezvous)))  return;
+
+  // Hook is called before and after every change, the chain is valid only after
+  if (rendezvous.r_state != r_debug::RT_CONSISTENT)  return;
+
+  refresh_memory_map(dbg);
+  refresh_modules(dbg);
+}
+
+Module * search_module(Module_List *list, u64 address) {
+  s32 low = 0;
+  s32 high = list->modules.count - 1;
+
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    auto module = &list->modules.data[middle];
+
+    if (address < module->start) {
+      high = middle - 1;
+    } else if (address >= module->end) {
+      low = middle + 1;
+    } else {
+      return module;
+    }
+  }
+
+  return nullptr;
+}
+
+Module * find_module(Debugger *dbg, u64 address) {
+  if (dbg->state == Debugger_State::NOT_LOADED)  return nullptr;
+
+  auto list = &dbg->modules;
+  if (list->modules.count < 0)  return nullptr;
+
+  auto module = search_module(list, address);
+
+  // Library could be loaded while the hook was lifted, e.g. during profiling
+  if (!module && list->refresh_stop != dbg->stop_count) {
+    refresh_modules(dbg);
+    module = search_module(list, address);
+  }
+
+  return module;
+}
+
+Array<Module> * get_modules(Debugger *dbg) {
+  if (dbg->state == Debugger_State::NOT_LOADED) {
+    dbg_fail("debugged program isn't loaded");
+    return nullptr;
+  }
+
+  if (dbg->modules.modules.count < 0) {
+    dbg_fail("modules aren't initialized");
+    return nullptr;
+  }
+
+  dbg_success();
+  return &dbg->modules.modules;
+}
+
+void print_modules(Array<Module> *modules) {
+  For_Pointer (*modules) {
+    printf("%016lx-%016lx bias 0x%lx %s%s\n", it->start, it->end, it->load_bias, it->path, it->is_main ? " (main)" : "");
+  }
+}
+
+DBG_NAMESPACE_END
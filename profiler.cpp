@@ -0,0 +1,449 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Sampling profiler
+//
+
+constexpr u32 max_profile_stack_depth = 256;
+
+struct Profile_Samples {
+  Array<u64> addresses; // Stacks of all samples one after another, innermost frame first
+  Array<u32> depths;
+
+  u64 lost_count = 0;
+};
+
+// Returns true if the process was stopped, and false if it exited in the meantime
+bool interrupt_process(Debugger *dbg) {
+  // @Note: PTRACE_INTERRUPT works only for PTRACE_SEIZE'd processes, but debugged
+  //        child is traced with PTRACE_TRACEME and attached one with PTRACE_ATTACH,
+  //        so SIGSTOP is used instead. Tracer sees it as a signal-delivery-stop and
+  //        suppresses it on the next PTRACE_CONT.
+  kill(dbg->debugee_pid, SIGSTOP);
+
+  while (true) {
+    s32 wait_status;
+    if (debugee_waitpid(dbg, &wait_status, 0) == -1)  return false;
+
+    if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status))  return false;
+
+    if (WIFSTOPPED(wait_status)) {
+      auto signal = WSTOPSIG(wait_status);
+      if (signal == SIGSTOP)  return true;
+
+      // Some other signal arrived first, pass it to the process and wait for ours
+      debugee_ptrace(dbg, PTRACE_CONT, nullptr, signal == SIGTRAP ? 0 : signal);
+    }
+  }
+}
+
+inline void take_sample(Debugger *dbg, Profile_Samples *samples) {
+  auto stack_start = samples->addresses.count;
+  unwind_stack(dbg, &samples->addresses, max_profile_stack_depth);
+  samples->depths.add(samples->addresses.count - stack_start);
+}
+
+inline char *get_sample_function_name(Debugger *dbg, u64 address, bool is_caller_frame) {
+  auto lookup_address = offset_load_address(dbg, address) - (is_caller_frame ? 1 : 0);
+  auto function = find_function_range(dbg, lookup_address);
+  if (function)  return function->name;
+
+  auto library_function_name = find_module_function_name(dbg, address - (is_caller_frame ? 1 : 0));
+  return library_function_name ? const_cast <char *>(library_function_name) : (char *)"[unknown]";
+}
+
+s32 get_profile_child(Profile *profile, s32 parent, char *function_name) {
+  auto child = profile->nodes[parent].first_child;
+  while (child != -1) {
+    auto &node = profile->nodes[child];
+    if (node.function_name == function_name || strcmp(node.function_name, function_name) == 0)  return child;
+    child = node.next_sibling;
+  }
+
+  Profile_Node new_node;
+  new_node.function_name = function_name;
+  new_node.parent = parent;
+  new_node.next_sibling = profile->nodes[parent].first_child;
+
+  profile->nodes.add(new_node);
+  profile->nodes[parent].first_child = profile->nodes.count - 1;
+
+  return profile->nodes.count - 1;
+}
+
+void aggregate_samples(Debugger *dbg, Profile_Samples *samples, Profile *profile) {
+  Profile_Node root;
+  root.function_name = (char *)"[root]";
+  profile->nodes.add(root);
+
+  u64 stack_start = 0;
+  For (samples->depths) {
+    auto depth = it;
+    auto stack = samples->addresses.data + stack_start;
+    stack_start += depth;
+
+    if (depth == 0)  continue;
+
+    s32 node = 0;
+    profile->nodes[node].total_samples++;
+
+    // Walking from the outermost frame, so call paths share tree prefixes
+    for (s32 frame = depth - 1; frame >= 0; frame--) {
+      auto function_name = get_sample_function_name(dbg, stack[frame], frame > 0);
+      node = get_profile_child(profile, node, function_name);
+      profile->nodes[node].total_samples++;
+    }
+
+    profile->nodes[node].self_samples++;
+    profile->sample_count++;
+  }
+
+  profile->lost_samples = samples->lost_count;
+}
+
+// Returns false if the process exited during sampling
+bool sample_with_ptrace(Debugger *dbg, u32 frequency, u64 end_time, Profile_Samples *samples) {
+  u64 period = 1000000000 / frequency;
+  u64 next_sample_time = get_monotonic_time_ns();
+
+  end_stop(dbg);
+  debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+
+  while (true) {
+    next_sample_time += period;
+    if (next_sample_time >= end_time)  break;
+
+    timespec wakeup_time = { (time_t)(next_sample_time / 1000000000), (long)(next_sample_time % 1000000000) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup_time, nullptr);
+
+    if (!interrupt_process(dbg))  return false;
+
+    take_sample(dbg, samples);
+
+    debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+  }
+
+  return interrupt_process(dbg);
+}
+
+/////////////////////////////////////
+//
+//  perf_event_open backend
+//
+// Kernel takes samples on software clock events and writes them into the ring
+// buffer shared with us, so the process never stops. Callchains are collected
+// by the kernel with frame pointers, as perf does by default.
+//
+
+constexpr u32 perf_data_page_count = 128; // Should be a power of two
+
+struct Perf_Sampler {
+  s32 fd = -1;
+
+  u8 *base = nullptr;
+  u64 mapped_size;
+
+  u8 *data;
+  u64 data_size;
+};
+
+inline s32 perf_event_open(perf_event_attr *attr, pid_t pid, s32 cpu, s32 group_fd, u64 flags) {
+  return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+bool open_perf_sampler(Debugger *dbg, Perf_Sampler *sampler, u32 frequency, Profiler_Backend backend) {
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = (backend == Profiler_Backend::PERF_TASK_CLOCK) ? PERF_COUNT_SW_TASK_CLOCK : PERF_COUNT_SW_CPU_CLOCK;
+  attr.freq = 1;
+  attr.sample_freq = frequency;
+  attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.exclude_callchain_kernel = 1;
+
+  sampler->fd = perf_event_open(&attr, dbg->debugee_pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+  if (sampler->fd == -1) {
+    if (dbg->verbose)  printf("Error: perf_event_open failed: %s (check /proc/sys/kernel/perf_event_paranoid)\n", strerror(errno));
+    return false;
+  }
+
+  u64 page_size = sysconf(_SC_PAGESIZE);
+  sampler->mapped_size = (perf_data_page_count + 1) * page_size;
+  auto base = mmap(nullptr, sampler->mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, sampler->fd, 0);
+  if (base == MAP_FAILED) {
+    if (dbg->verbose)  printf("Error: couldn't map perf ring buffer: %s\n", strerror(errno));
+    close(sampler->fd);
+    sampler->fd = -1;
+    return false;
+  }
+
+  sampler->base = static_cast <u8 *>(base);
+
+  // First page is the control page, ring buffer follows it
+  auto control = reinterpret_cast <perf_event_mmap_page *>(sampler->base);
+  sampler->data = sampler->base + (control->data_offset ? control->data_offset : page_size);
+  sampler->data_size = control->data_size ? control->data_size : perf_data_page_count * page_size;
+
+  return true;
+}
+
+void close_perf_sampler(Perf_Sampler *sampler) {
+  if (sampler->base)  munmap(sampler->base, sampler->mapped_size);
+  if (sampler->fd != -1)  close(sampler->fd);
+  sampler->base = nullptr;
+  sampler->fd = -1;
+}
+
+inline void copy_from_ring(Perf_Sampler *sampler, u64 position, void *destination, u64 size) {
+  auto offset = position & (sampler->data_size - 1);
+  auto first_part = sampler->data_size - offset;
+
+  if (size <= first_part) {
+    memcpy(destination, sampler->data + offset, size);
+  } else {
+    memcpy(destination, sampler->data + offset, first_part);
+    memcpy(static_cast <u8 *>(destination) + first_part, sampler->data, size - first_part);
+  }
+}
+
+void drain_perf_samples(Perf_Sampler *sampler, Profile_Samples *samples) {
+  auto control = reinterpret_cast <perf_event_mmap_page *>(sampler->base);
+
+  u64 head = __atomic_load_n(&control->data_head, __ATOMIC_ACQUIRE);
+  u64 tail = control->data_tail;
+
+  static u8 record[1 << 16]; // Record size is limited by u16 in its header
+
+  while (tail < head) {
+    perf_event_header header;
+    copy_from_ring(sampler, tail, &header, sizeof(header));
+    if (header.size < sizeof(header))  break;
+
+    copy_from_ring(sampler, tail, record, header.size);
+
+    Data_Cursor cursor;
+    cursor.init(record + sizeof(header), header.size - sizeof(header));
+
+    switch (header.type) {
+    case PERF_RECORD_SAMPLE: {
+      cursor.read_u64(); // ip, duplicated as the first entry of the callchain
+      u64 callchain_length = cursor.read_u64();
+
+      u32 depth = 0;
+      For_Count (callchain_length, i) {
+        u64 address = cursor.read_u64();
+        if (address >= (u64)PERF_CONTEXT_MAX)  continue; // Context markers
+        samples->addresses.add(address);
+        depth++;
+      }
+      samples->depths.add(depth);
+      break;
+    }
+
+    case PERF_RECORD_LOST:
+      cursor.read_u64(); // id
+      samples->lost_count += cursor.read_u64();
+      break;
+    }
+
+    tail += header.size;
+  }
+
+  __atomic_store_n(&control->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+// Returns false if the process exited during sampling
+bool sample_with_perf_events(Perf_Sampler *sampler, Debugger *dbg, u64 end_time, Profile_Samples *samples) {
+  ioctl(sampler->fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(sampler->fd, PERF_EVENT_IOC_ENABLE, 0);
+
+  end_stop(dbg);
+  debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+
+  bool process_alive = true;
+  while (process_alive) {
+    u64 now = get_monotonic_time_ns();
+    if (now >= end_time)  break;
+
+    // Waking up periodically to handle signals arrived to the process, as tracer has to pass them
+    u64 timeout_ms = (end_time - now) / 1000000;
+    pollfd poll_fd = { sampler->fd, POLLIN, 0 };
+    poll(&poll_fd, 1, timeout_ms < 50 ? timeout_ms : 50);
+
+    drain_perf_samples(sampler, samples);
+
+    s32 wait_status;
+    if (debugee_waitpid(dbg, &wait_status, WNOHANG) > 0) {
+      if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+        process_alive = false;
+      } else if (WIFSTOPPED(wait_status)) {
+        auto signal = WSTOPSIG(wait_status);
+        debugee_ptrace(dbg, PTRACE_CONT, nullptr, signal == SIGTRAP ? 0 : signal);
+      }
+    }
+  }
+
+  ioctl(sampler->fd, PERF_EVENT_IOC_DISABLE, 0);
+
+  if (process_alive)  process_alive = interrupt_process(dbg);
+
+  drain_perf_samples(sampler, samples);
+
+  return process_alive;
+}
+
+void profile(Debugger *dbg, u32 frequency, float64 duration, Profile *result, Profiler_Backend backend) {
+  if (!result) {
+    dbg_fail("pointer to output profile is null");
+    return;
+  }
+
+  deinit(result);
+  result->nodes.init();
+
+  if (dbg->state != Debugger_State::RUNNING) {
+    dbg_fail("debugged program isn't running");
+    return;
+  }
+
+  if (frequency == 0 || duration <= 0) {
+    dbg_fail("profiling frequency and duration should be positive");
+    return;
+  }
+
+  Perf_Sampler perf_sampler;
+  defer { close_perf_sampler(&perf_sampler); };
+
+  if (backend != Profiler_Backend::PTRACE) {
+    if (!open_perf_sampler(dbg, &perf_sampler, frequency, backend)) {
+      dbg_fail("couldn't open perf event sampler");
+      return;
+    }
+  }
+
+  // Breakpoints lifted for the profiling time, so the process stops only for sampling
+  Small_Array<Breakpoint *, 16> lifted_breakpoints;
+  lifted_breakpoints.init();
+  defer { lifted_breakpoints.deinit(); };
+
+  lift_breakpoints(dbg, &lifted_breakpoints);
+
+  Profile_Samples samples;
+  samples.addresses.init();
+  samples.depths.init();
+  defer {
+    samples.addresses.deinit();
+    samples.depths.deinit();
+  };
+
+  u64 start_time = get_monotonic_time_ns();
+  u64 end_time = start_time + (u64)(duration * 1000000000.0);
+
+  bool process_exited;
+  if (backend == Profiler_Backend::PTRACE) {
+    process_exited = !sample_with_ptrace(dbg, frequency, end_time, &samples);
+  } else {
+    process_exited = !sample_with_perf_events(&perf_sampler, dbg, end_time, &samples);
+  }
+
+  result->frequency = frequency;
+  result->duration = (get_monotonic_time_ns() - start_time) / 1000000000.0;
+
+  if (process_exited) {
+    printf("Process exited during profiling\n");
+
+    if (dbg->autorestart_enabled) {
+      restart_or_finish_debug(dbg);
+    } else {
+      dbg->state = Debugger_State::LOADED;
+    }
+  }
+
+  restore_lifted_breakpoints(dbg, &lifted_breakpoints);
+  start_new_stop(dbg);
+
+  aggregate_samples(dbg, &samples, result);
+
+  dbg_success();
+}
+
+void deinit(Profile *profile) {
+  profile->nodes.deinit();
+  profile->sample_count = 0;
+  profile->lost_samples = 0;
+  profile->frequency = 0;
+  profile->duration = 0;
+}
+
+void print_profile_node(Profile *profile, s32 node_index, u32 indentation) {
+  auto &node = profile->nodes[node_index];
+  auto percent = 100.0 * node.total_samples / profile->sample_count;
+
+  printf("%*s%s  %.1f%% (total %lu, self %lu)\n", indentation * 2, "", node.function_name, percent, node.total_samples, node.self_samples);
+
+  auto child = node.first_child;
+  while (child != -1) {
+    print_profile_node(profile, child, indentation + 1);
+    child = profile->nodes[child].next_sibling;
+  }
+}
+
+void print_profile(Profile *profile) {
+  printf("Profile: %lu samples in %.3f s (%u Hz), %lu lost\n", profile->sample_count, profile->duration, profile->frequency, profile->lost_samples);
+  if (profile->sample_count == 0)  return;
+
+  auto child = profile->nodes[0].first_child;
+  while (child != -1) {
+    print_profile_node(profile, child, 0);
+    child = profile->nodes[child].next_sibling;
+  }
+}
+
+void write_folded_stacks(FILE *f, Profile *profile, s32 node_index, Array<char *> *path) {
+  auto &node = profile->nodes[node_index];
+  path->add(node.function_name);
+
+  if (node.self_samples > 0) {
+    For_Count (path->count, i) {
+      fprintf(f, i == 0 ? "%s" : ";%s", path->data[i]);
+    }
+    fprintf(f, " %lu\n", node.self_samples);
+  }
+
+  auto child = node.first_child;
+  while (child != -1) {
+    write_folded_stacks(f, profile, child, path);
+    child = profile->nodes[child].next_sibling;
+  }
+
+  path->pop();
+}
+
+// Folded stacks format is understood by flamegraph.pl, speedscope, inferno and others:
+// one line per unique stack, frames separated by ';' and followed by a sample count
+void export_folded_stacks(Profile *profile, const char *file_path) {
+  auto f = fopen(file_path, "w");
+  if (!f) {
+    printf("Error: couldn't open file %s for writing\n", file_path);
+    return;
+  }
+  defer { fclose(f); };
+
+  if (profile->nodes.count <= 0)  return;
+
+  Array<char *> path;
+  path.init();
+  defer { path.deinit(); };
+
+  auto child = profile->nodes[0].first_child;
+  while (child != -1) {
+    write_folded_stacks(f, profile, child, &path);
+    child = profile->nodes[child].next_sibling;
+  }
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,138 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Stats
+//
+// Counters are plain increments on the debugger thread, so they are always on.
+// Commands are timed by time_command, nested commands are counted as a part of the outermost one.
+//
+
+s32 process_waitpid(Debugger *dbg, u32 pid, s32 *wait_status, s32 options) {
+  dbg->stats.waitpid_calls++;
+
+  auto result = waitpid(pid, wait_status, options);
+  if (result > 0 && WIFSTOPPED(*wait_status))  dbg->stats.stops++;
+
+  return result;
+}
+
+s32 debugee_waitpid(Debugger *dbg, s32 *wait_status, s32 options) {
+  return process_waitpid(dbg, dbg->debugee_pid, wait_status, options);
+}
+
+ssize_t debugee_read_memory(Debugger *dbg, iovec *local_buffers, iovec *remote_buffers, u64 buffer_count) {
+  dbg->stats.memory_reads++;
+
+  auto bytes_read = process_vm_readv(dbg->debugee_pid, local_buffers, buffer_count, remote_buffers, buffer_count, 0);
+  if (bytes_read > 0)  dbg->stats.bytes_read += bytes_read;
+
+  return bytes_read;
+}
+
+Command_Timer start_command_timer(Debugger *dbg, Stats_Command command) {
+  dbg->command_depth++;
+  return (Command_Timer){command, get_monotonic_time_ns(), begin_timeline_zone(to_string(command))};
+}
+
+void end_command_timer(Debugger *dbg, Command_Timer *timer) {
+  end_timeline_zone(&timer->zone);
+
+  dbg->command_depth--;
+  if (dbg->command_depth > 0)  return;
+
+  auto time = get_monotonic_time_ns() - timer->start_time;
+
+  auto timing = &dbg->stats.commands[(u32)timer->command];
+  timing->count++;
+  timing->total_time += time;
+  if (time > timing->max_time)  timing->max_time = time;
+}
+
+Debugger_Stats * get_stats(Debugger *dbg) {
+  return &dbg->stats;
+}
+
+void reset_stats(Debugger *dbg) {
+  dbg->stats = Debugger_Stats();
+  dbg->stats.reset_time = get_monotonic_time_ns();
+}
+
+char * to_string(Ptrace_Counter counter) {
+  switch (counter) {
+  case Ptrace_Counter::PEEK:          return (char *)"peek";
+  case Ptrace_Counter::POKE:          return (char *)"poke";
+  case Ptrace_Counter::GET_REGISTERS: return (char *)"get registers";
+  case Ptrace_Counter::SET_REGISTERS: return (char *)"set registers";
+  case Ptrace_Counter::CONTINUE:      return (char *)"continue";
+  case Ptrace_Counter::SINGLE_STEP:   return (char *)"single step";
+  case Ptrace_Counter::SIGNAL_INFO:   return (char *)"signal info";
+  case Ptrace_Counter::OTHER:         return (char *)"other";
+  case Ptrace_Counter::COUNT:         break;
+  }
+  assert(false);
+  return nullptr;
+}
+
+char * to_string(Stats_Cache cache) {
+  switch (cache) {
+  case Stats_Cache::MEMORY:     return (char *)"memory";
+  case Stats_Cache::MEMORY_MAP: return (char *)"memory map";
+  case Stats_Cache::TYPES:      return (char *)"types";
+  case Stats_Cache::LOCALS:     return (char *)"locals";
+  case Stats_Cache::COUNT:      break;
+  }
+  assert(false);
+  return nullptr;
+}
+
+char * to_string(Stats_Command command) {
+  switch (command) {
+  case Stats_Command::DEBUG:             return (char *)"debug";
+  case Stats_Command::ATTACH:            return (char *)"attach";
+  case Stats_Command::CONTINUE:          return (char *)"continue";
+  case Stats_Command::STEP_IN:           return (char *)"step in";
+  case Stats_Command::STEP_OUT:          return (char *)"step out";
+  case Stats_Command::STEP_OVER:         return (char *)"step over";
+  case Stats_Command::STEP_INSTRUCTION:  return (char *)"step instruction";
+  case Stats_Command::SET_BREAKPOINT:    return (char *)"set breakpoint";
+  case Stats_Command::REMOVE_BREAKPOINT: return (char *)"remove breakpoint";
+  case Stats_Command::STACK_TRACE:       return (char *)"stack trace";
+  case Stats_Command::VARIABLES:         return (char *)"variables";
+  case Stats_Command::VARIABLE_CHILDREN: return (char *)"variable children";
+  case Stats_Command::LOOKUP_SYMBOL:     return (char *)"lookup symbol";
+  case Stats_Command::EVALUATE_WATCHES:  return (char *)"evaluate watches";
+  case Stats_Command::COUNT:             break;
+  }
+  assert(false);
+  return nullptr;
+}
+
+void print_stats(Debugger *dbg) {
+  auto stats = &dbg->stats;
+
+  printf("Stats for the last %.2f s:\n", (get_monotonic_time_ns() - stats->reset_time) / 1000000000.0);
+
+  printf("  ptrace:");
+  For_Count ((s32)Ptrace_Counter::COUNT, i) {
+    printf(" %s %lu%s", to_string((Ptrace_Counter)i), stats->ptrace_calls[i], i + 1 < (s32)Ptrace_Counter::COUNT ? "," : "\n");
+  }
+  printf("  waitpid %lu (%lu stops), process_vm_readv %lu\n", stats->waitpid_calls, stats->stops, stats->memory_reads);
+  printf("  bytes read %lu, written %lu\n", stats->bytes_read, stats->bytes_written);
+  printf("  DWARF lookups %lu\n", stats->dwarf_lookups);
+
+  For_Count ((s32)Stats_Cache::COUNT, i) {
+    auto accesses = stats->cache_hits[i] + stats->cache_misses[i];
+    printf("  %-12s cache %8lu hits %8lu misses (%.1f%%)\n", to_string((Stats_Cache)i), stats->cache_hits[i], stats->cache_misses[i],
+           accesses ? 100.0 * stats->cache_hits[i] / accesses : 0.0);
+  }
+
+  For_Count ((s32)Stats_Command::COUNT, i) {
+    auto timing = &stats->commands[i];
+    if (timing->count == 0)  continue;
+    printf("  %-18s %6lu times, mean %9.3f ms, max %9.3f ms\n", to_string((Stats_Command)i), timing->count,
+           timing->total_time / 1000000.0 / timing->count, timing->max_time / 1000000.0);
+  }
+}
+
+DBG_NAMESPACE_END
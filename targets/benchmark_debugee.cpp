@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+
+// Synthetic program for tests/benchmark.cpp: thousands of functions, a hot loop, deep recursion
+// and large structs. Functions marked as breakpoint targets are found by name, keep them in sync with the benchmark.
+
+#define REPEAT_4(F, n)    F(n##0) F(n##1) F(n##2) F(n##3)
+#define REPEAT_16(F, n)   REPEAT_4(F, n##0)   REPEAT_4(F, n##1)   REPEAT_4(F, n##2)   REPEAT_4(F, n##3)
+#define REPEAT_64(F, n)   REPEAT_16(F, n##0)  REPEAT_16(F, n##1)  REPEAT_16(F, n##2)  REPEAT_16(F, n##3)
+#define REPEAT_256(F, n)  REPEAT_64(F, n##0)  REPEAT_64(F, n##1)  REPEAT_64(F, n##2)  REPEAT_64(F, n##3)
+#define REPEAT_1024(F, n) REPEAT_256(F, n##0) REPEAT_256(F, n##1) REPEAT_256(F, n##2) REPEAT_256(F, n##3)
+#define REPEAT_4096(F)    REPEAT_1024(F, 0)   REPEAT_1024(F, 1)   REPEAT_1024(F, 2)   REPEAT_1024(F, 3)
+
+// Names are generated_function_000000 ... generated_function_333333, digits are base 4
+#define GENERATED_FUNCTION(n) \
+  __attribute__((noinline)) int generated_function_##n(int x) { int local = x * 3 + 1; return local ^ (x >> 2); }
+
+REPEAT_4096(GENERATED_FUNCTION)
+
+#define GENERATED_POINTER(n) generated_function_##n,
+
+typedef int (*Generated_Function)(int);
+Generated_Function generated_functions[] = { REPEAT_4096(GENERATED_POINTER) };
+
+
+// Hot loop
+__attribute__((noinline)) int hot_loop_step(int i) {
+  int value = i * 7;
+  value ^= value >> 3;
+  return value;
+}
+
+int hot_loop(int iterations) { // Breakpoint target, stepped over and into
+  int sum = 0;
+  for (int i = 0; i < iterations; i++) {
+    sum += hot_loop_step(i);
+  }
+  return sum;
+}
+
+
+// Deep recursion
+__attribute__((noinline)) void recursion_bottom(int depth) { // Breakpoint target
+  (void)depth;
+}
+
+int recurse(int depth) {
+  int frame_local = depth;
+  if (depth == 0) {
+    recursion_bottom(frame_local);
+    return 0;
+  }
+  return recurse(depth - 1) + frame_local;
+}
+
+
+// Large structs
+struct Vertex {
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+
+struct Mesh {
+  char name[64];
+  Vertex vertices[512];
+  int indices[1536];
+  Mesh *next;
+};
+
+struct Scene {
+  Mesh meshes[4];
+  double transform[16];
+  int mesh_count;
+};
+
+__attribute__((noinline)) void large_structs_ready(Scene *scene) { // Breakpoint target, locals of the caller are read
+  (void)scene;
+}
+
+int inspect_large_structs() {
+  Scene scene;
+  memset(&scene, 0, sizeof(scene));
+  scene.mesh_count = 4;
+
+  for (int i = 0; i < scene.mesh_count; i++) {
+    auto mesh = &scene.meshes[i];
+    snprintf(mesh->name, sizeof(mesh->name), "mesh_%d", i);
+    for (int v = 0; v < 512; v++)  mesh->vertices[v].position[0] = (float)v;
+    for (int index = 0; index < 1536; index++)  mesh->indices[index] = index % 512;
+    mesh->next = (i + 1 < scene.mesh_count) ? &scene.meshes[i + 1] : nullptr;
+  }
+
+  Mesh *first_mesh = &scene.meshes[0];
+  large_structs_ready(&scene);
+
+  return first_mesh->indices[7] + scene.mesh_count;
+}
+
+
+int main() {
+  long sum = 0;
+
+  int function_count = sizeof(generated_functions) / sizeof(generated_functions[0]);
+  for (int i = 0; i < function_count; i++) {
+    sum += generated_functions[i](i);
+  }
+
+  sum += hot_loop(1000000);
+  sum += recurse(200);
+  sum += inspect_large_structs();
+
+  printf("benchmark debugee finished: %ld\n", sum);
+  return 0;
+}
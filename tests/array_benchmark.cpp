@@ -0,0 +1,211 @@
+#include <time.h>
+#include <stdio.h>
+
+#include "../common.h"
+#include "../defer.h"
+#include "../Array.h"
+#include "../Allocator.cpp"
+
+#include "baseline_array.h"
+
+// Compares Array with its previous version on the access patterns of the debugger:
+// long arrays filled one element at a time (symbols, line probes), tiny short-lived arrays
+// (breakpoints of step_over, lifted breakpoints, unit indices), bulk appends
+// and output arrays refilled on every stop (stack traces, variables).
+
+static u64 get_time_ns() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+static u64 sink = 0; // Keeps results from being optimized out
+
+// Same size as dbg::Frame
+struct Benchmark_Frame {
+  char *function_name;
+  char *file_name;
+  char *path;
+  u64 line;
+  u64 address;
+  u64 cfa;
+};
+
+static void print_result(const char *name, s32 count, float64 baseline_ns, float64 new_ns) {
+  printf("%-24s %7d %10.1f %10.1f %7.2fx\n", name, count, baseline_ns, new_ns, baseline_ns / new_ns);
+}
+
+template <typename Array_Type>
+static float64 run_add(s32 count, s32 rounds) {
+  auto start = get_time_ns();
+  For_Count (rounds, round) {
+    Array_Type array;
+    array.init();
+    For_Count (count, i)  array.add((u64)i);
+    sink += array.data[count / 2];
+    array.deinit();
+  }
+  return (float64)(get_time_ns() - start) / ((u64)count * rounds);
+}
+
+// Array created, filled with few elements, walked and freed, as step_over does with its breakpoints
+template <typename Array_Type>
+static float64 run_small(s32 count, s32 rounds) {
+  auto start = get_time_ns();
+  For_Count (rounds, round) {
+    Array_Type array;
+    array.init();
+    For_Count (count, i)  array.add(reinterpret_cast <void *>((u64)(round + i)));
+    For (array)  sink += reinterpret_cast <u64>(it);
+    array.deinit();
+  }
+  return (float64)(get_time_ns() - start) / rounds;
+}
+
+static float64 run_join_baseline(Array<u64> part, s32 parts, s32 rounds) {
+  auto start = get_time_ns();
+  For_Count (rounds, round) {
+    baseline::Array<u64> array;
+    array.init();
+    For_Count (parts, i) {
+      For (part)  array.add(it);
+    }
+    sink += array.count;
+    array.deinit();
+  }
+  return (float64)(get_time_ns() - start) / ((u64)parts * part.count * rounds);
+}
+
+static float64 run_join(Array<u64> part, s32 parts, s32 rounds) {
+  auto start = get_time_ns();
+  For_Count (rounds, round) {
+    Array<u64> array;
+    array.init();
+    For_Count (parts, i)  array.join(part);
+    sink += array.count;
+    array.deinit();
+  }
+  return (float64)(get_time_ns() - start) / ((u64)parts * part.count * rounds);
+}
+
+// Output array of a query refilled on every stop, by the heap with the previous version
+// and by the stop arena, reset on resume, with the new one
+static float64 run_stop_baseline(s32 count, s32 stops) {
+  auto start = get_time_ns();
+  For_Count (stops, stop) {
+    baseline::Array<Benchmark_Frame> frames;
+    frames.init();
+    For_Count (count, i)  frames.add((Benchmark_Frame){nullptr, nullptr, nullptr, (u64)i, (u64)stop, 0});
+    sink += frames.back().line;
+    frames.deinit();
+  }
+  return (float64)(get_time_ns() - start) / stops;
+}
+
+static float64 run_stop(s32 count, s32 stops) {
+  Arena stop_arena;
+  defer { stop_arena.deinit(); };
+
+  auto start = get_time_ns();
+  For_Count (stops, stop) {
+    Array<Benchmark_Frame> frames;
+    frames.allocator = get_allocator(&stop_arena);
+    frames.init();
+    For_Count (count, i)  frames.add((Benchmark_Frame){nullptr, nullptr, nullptr, (u64)i, (u64)stop, 0});
+    sink += frames.back().line;
+    stop_arena.reset();
+  }
+  return (float64)(get_time_ns() - start) / stops;
+}
+
+static bool check_array() {
+  // Whole elements are zeroed, not their first bytes
+  Array<u64> zeroed;
+  zeroed.init(4);
+  defer { zeroed.deinit(); };
+  For (zeroed) {
+    if (it != 0)  return false;
+  }
+
+  Array<s32> numbers;
+  defer { numbers.deinit(); };
+  For_Count (10, i)  numbers.add(i);
+
+  // Order is kept by remove
+  if (numbers.remove(0) != 0 || numbers.remove(4) != 5 || numbers.count != 8)  return false;
+  s32 expected[] = {1, 2, 3, 4, 6, 7, 8, 9};
+  For_Count (numbers.count, i) {
+    if (numbers[i] != expected[i])  return false;
+  }
+
+  // Joining to itself doubles the array
+  numbers.join(numbers);
+  if (numbers.count != 16 || numbers[8] != 1 || numbers.back() != 9)  return false;
+
+  // Taken array owns the data, the source is left uninitialized
+  auto taken = numbers.take();
+  defer { taken.deinit(); };
+  if (numbers.count != -1 || numbers.data || taken.count != 16 || taken[15] != 9)  return false;
+
+  auto copied = taken.copy();
+  defer { copied.deinit(); };
+  copied[0] = 100;
+  if (taken[0] != 1 || copied.count != 16)  return false;
+
+  // Small array spills to the allocator and keeps its contents
+  Small_Array<s32, 4> small;
+  defer { small.deinit(); };
+  For_Count (4, i)  small.add(i);
+  if (small.data != small.inline_storage)  return false;
+  For_Count (6, i)  small.add(4 + i);
+  if (small.data == small.inline_storage || small.count != 10)  return false;
+  For_Count (small.count, i) {
+    if (small[i] != i)  return false;
+  }
+
+  // Small array given away is copied out of the inline storage
+  Small_Array<s32, 4> inline_only;
+  inline_only.add(7);
+  auto moved = inline_only.take();
+  defer { moved.deinit(); };
+  if (moved.data == inline_only.inline_storage || moved[0] != 7 || inline_only.count != -1)  return false;
+
+  return true;
+}
+
+s32 main(s32 argc, char *argv[]) {
+  if (!check_array()) {
+    printf("Array check FAILED\n");
+    return 1;
+  }
+  printf("Array check passed\n\n");
+
+  printf("operation                  count baseline ns    new ns   speedup\n");
+
+  s32 add_sizes[] = {16, 1024, 65536};
+  for (auto count : add_sizes) {
+    s32 rounds = 20000000 / count;
+    print_result("add", count, run_add<baseline::Array<u64>>(count, rounds), run_add<Array<u64>>(count, rounds));
+  }
+
+  s32 small_sizes[] = {2, 8, 16};
+  for (auto count : small_sizes) {
+    s32 rounds = 2000000;
+    print_result("small array", count, run_small<baseline::Array<void *>>(count, rounds), run_small<Small_Array<void *, 16>>(count, rounds));
+  }
+
+  Array<u64> part;
+  part.init();
+  defer { part.deinit(); };
+  For_Count (64, i)  part.add(i);
+
+  print_result("join 64", 64 * 256, run_join_baseline(part, 256, 2000), run_join(part, 256, 2000));
+
+  s32 stop_sizes[] = {8, 32, 128};
+  for (auto count : stop_sizes) {
+    s32 stops = 1000000;
+    print_result("frames per stop", count, run_stop_baseline(count, stops), run_stop(count, stops));
+  }
+
+  return sink == 0xffffffff; // Never true in practice
+}
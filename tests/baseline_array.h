@@ -0,0 +1,183 @@
+#pragma once
+
+// Array as it was before small-buffer storage, ordered remove and join,
+// kept only as the baseline for tests/array_benchmark.cpp
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../Allocator.h"
+
+namespace baseline {
+
+template <typename T>
+struct Array {
+  int count = -1;
+  T * data = nullptr;
+
+  Allocator allocator; // Heap by default, set before the first allocation
+
+  void init(int count = 0);
+  void init(T array[], int count);
+  void deinit(); // @Note: WARNING! Frees only data allocated by Array unrecursively!
+
+  void reset();
+
+  void add(const T & value);
+  Array<T> join(Array<T> array); // @Unimplemented
+
+  inline T & get(int index);
+  inline void set(int index, T value);
+
+  T remove(int index); // @Unimplemented
+  T remove_unordered(int index);
+
+  inline T & operator [](int index) { return get(index); }
+
+  inline T & back()  { return get(count - 1); }
+  inline T & front() { return get(0);         }
+  inline T & pop();
+
+  T * find(const T & value); // TODO: Add custom predicate
+  int find_index(const T & value); // TODO: Add custom predicate
+
+  int get_allocated_size() { return allocated_size; } // Meh...
+
+  int grow_factor = 2;
+  int minimal_size = 8;
+
+private:
+  inline T * allocate(int size);
+  inline T * reallocate(int new_size);
+
+  int allocated_size = -1;
+};
+
+template<typename T>
+void Array<T>::init(int count) {
+  this->data = allocate(count);
+  this->count = count;
+  memset(data, 0, count);
+}
+
+template<typename T>
+void Array<T>::init(T * array, int count) {
+  this->data = allocate(count);
+  this->count = count;
+
+  memcpy(data, array, sizeof(T)*count);
+}
+
+template<typename T>
+void Array<T>::deinit() {
+  if (data) {
+    free_memory(allocator, data);
+    allocated_size = -1;
+    count = -1;
+    data = nullptr;
+  }
+}
+
+template<typename T>
+void Array<T>::reset() {
+  if (data) {
+    memset(data, 0, count);
+    count = 0;
+  } else {
+    this->init();
+  }
+}
+
+template<typename T>
+inline T * Array<T>::allocate(int requested_size) {
+  if (requested_size <= minimal_size)
+    allocated_size = minimal_size;
+  else
+    allocated_size = requested_size;
+
+  return static_cast <T *>(allocate_memory(allocator, sizeof(T)*allocated_size));
+}
+
+template<typename T>
+inline T * Array<T>::reallocate(int new_size) {
+  if (new_size <= allocated_size) return data;
+
+  auto old_size = allocated_size;
+  allocated_size = new_size;
+  return static_cast <T *>(reallocate_memory(allocator, data, sizeof(T)*old_size, sizeof(T)*allocated_size));
+}
+
+template<typename T>
+void Array<T>::add(const T & value) {
+  if(data == nullptr) {
+    init();
+  } else if (count >= allocated_size) {
+    data = reallocate(allocated_size * grow_factor);
+  }
+
+  count += 1;
+  data[count-1] = value;
+}
+
+template<typename T>
+T & Array<T>::pop() {
+  assert(count > 0);
+  count -= 1;
+  return data[count];
+}
+
+template<typename T>
+T Array<T>::remove(int index) {
+  assert(0 && "Unimplemented");
+}
+
+template<typename T>
+T Array<T>::remove_unordered(int index) {
+  T removed_value = data[index];
+  data[index] = data[count - 1];
+  data[count - 1] = removed_value;
+
+  count -= 1;
+
+  return removed_value;
+}
+
+template<typename T>
+Array<T> Array<T>::join(Array<T> array) {
+  assert(0 && "Unimplemented");
+}
+
+template <typename T>
+inline void Array<T>::set(int index, T value) {
+  assert(0 <= index && index < count && "Attempt to index array out of its bounds");
+  data[index] = value;
+}
+
+template <typename T>
+inline T & Array<T>::get(int index) {
+  assert(0 <= index && index < count && "Attempt to index array out of its bounds");
+  return data[index];
+}
+
+template <typename T>
+T * Array<T>::find(const T & value) {
+  for (int i = 0; i < count; i++) {
+    if (data[i] == value) {
+      return &(data[i]);
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+int Array<T>::find_index(const T & value) {
+  for (int i = 0; i < count; i++) {
+    if (data[i] == value) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+} // namespace baseline
@@ -0,0 +1,260 @@
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "../defer.h"
+#include "../common.h"
+
+#include "../debugger.h"
+#include "../debugger.cpp"
+
+
+/////////////////////////////////////
+//
+//  Measurements
+//
+// Every operation is run several times on targets/benchmark_debugee.cpp. Results are printed as a table
+// and written as CSV, one line per operation, with mean counts of the debugger stats per run.
+//
+
+// Stats of the debugger, which are summed up over the runs
+struct Operation_Counts {
+  u64 ptrace_calls[(u32)dbg::Ptrace_Counter::COUNT] = {};
+  u64 waitpid_calls = 0;
+  u64 memory_reads = 0;
+  u64 bytes_read = 0;
+  u64 bytes_written = 0;
+  u64 dwarf_lookups = 0;
+};
+
+struct Operation_Result {
+  const char *name;
+  u32 runs = 0;
+  u32 failures = 0;
+  u64 total_ns = 0;
+  u64 min_ns = ~0ull;
+  u64 max_ns = 0;
+  Operation_Counts counts;
+};
+
+static Array<Operation_Result> results;
+
+static void add_stats_difference(Operation_Counts *total, dbg::Debugger_Stats *before, dbg::Debugger_Stats *after) {
+  For_Count ((s32)dbg::Ptrace_Counter::COUNT, i) {
+    total->ptrace_calls[i] += after->ptrace_calls[i] - before->ptrace_calls[i];
+  }
+  total->waitpid_calls += after->waitpid_calls - before->waitpid_calls;
+  total->memory_reads  += after->memory_reads  - before->memory_reads;
+  total->bytes_read    += after->bytes_read    - before->bytes_read;
+  total->bytes_written += after->bytes_written - before->bytes_written;
+  total->dwarf_lookups += after->dwarf_lookups - before->dwarf_lookups;
+}
+
+template <typename F>
+static void measure(dbg::Debugger *d, const char *name, u32 runs, F operation) {
+  Operation_Result result;
+  result.name = name;
+
+  For_Count (runs, i) {
+    auto stats_before = *dbg::get_stats(d);
+    auto start = dbg::get_monotonic_time_ns();
+
+    operation();
+
+    auto time = dbg::get_monotonic_time_ns() - start;
+    auto stats_after = *dbg::get_stats(d);
+
+    result.runs++;
+    if (d->last_command_status == dbg::Command_Status::FAIL)  result.failures++;
+    result.total_ns += time;
+    if (time < result.min_ns)  result.min_ns = time;
+    if (time > result.max_ns)  result.max_ns = time;
+    add_stats_difference(&result.counts, &stats_before, &stats_after);
+  }
+
+  results.add(result);
+}
+
+static float64 per_run(u64 value, u32 runs) {
+  return runs ? (float64)value / runs : 0.0;
+}
+
+static u64 get_ptrace_count(Operation_Counts *counts) {
+  u64 count = 0;
+  For_Count ((s32)dbg::Ptrace_Counter::COUNT, i)  count += counts->ptrace_calls[i];
+  return count;
+}
+
+static void print_results() {
+  printf("%-28s %6s %10s %10s %10s %8s %8s %8s %10s %8s %6s\n", "operation", "runs", "mean us", "min us", "max us",
+         "ptrace", "waitpid", "readv", "bytes read", "lookups", "failed");
+
+  For_Pointer (results) {
+    printf("%-28s %6u %10.1f %10.1f %10.1f %8.1f %8.1f %8.1f %10.1f %8.1f %6u\n", it->name, it->runs,
+           per_run(it->total_ns, it->runs) / 1000.0, it->min_ns / 1000.0, it->max_ns / 1000.0,
+           per_run(get_ptrace_count(&it->counts), it->runs), per_run(it->counts.waitpid_calls, it->runs),
+           per_run(it->counts.memory_reads, it->runs), per_run(it->counts.bytes_read, it->runs),
+           per_run(it->counts.dwarf_lookups, it->runs), it->failures);
+  }
+}
+
+static void export_results_csv(const char *file_path) {
+  auto f = fopen(file_path, "w");
+  if (!f) {
+    printf("Error: couldn't open file %s for writing\n", file_path);
+    return;
+  }
+  defer { fclose(f); };
+
+  fprintf(f, "operation,runs,failures,mean_us,min_us,max_us");
+  For_Count ((s32)dbg::Ptrace_Counter::COUNT, i) {
+    fprintf(f, ",ptrace_%s", dbg::to_string((dbg::Ptrace_Counter)i));
+  }
+  fprintf(f, ",waitpid,process_vm_readv,bytes_read,bytes_written,dwarf_lookups\n");
+
+  For_Pointer (results) {
+    auto counts = &it->counts;
+    fprintf(f, "%s,%u,%u,%.3f,%.3f,%.3f", it->name, it->runs, it->failures,
+            per_run(it->total_ns, it->runs) / 1000.0, it->min_ns / 1000.0, it->max_ns / 1000.0);
+    For_Count ((s32)dbg::Ptrace_Counter::COUNT, i) {
+      fprintf(f, ",%.2f", per_run(counts->ptrace_calls[i], it->runs));
+    }
+    fprintf(f, ",%.2f,%.2f,%.2f,%.2f,%.2f\n", per_run(counts->waitpid_calls, it->runs), per_run(counts->memory_reads, it->runs),
+            per_run(counts->bytes_read, it->runs), per_run(counts->bytes_written, it->runs), per_run(counts->dwarf_lookups, it->runs));
+  }
+}
+
+// Debugged process is stopped, unload doesn't kill it
+static void kill_debugee(dbg::Debugger *d) {
+  kill(d->debugee_pid, SIGKILL);
+  s32 status;
+  waitpid(d->debugee_pid, &status, 0);
+}
+
+static dbg::Variable * find_variable(Array<dbg::Variable> *variables, const char *name) {
+  For_Pointer (*variables) {
+    if (it->name && strcmp(it->name, name) == 0)  return it;
+  }
+  return nullptr;
+}
+
+s32 main(s32 argc, char *argv[]) {
+  const char *executable_path = argc > 1 ? argv[1] : "benchmark_debugee";
+  const char *csv_path = argc > 2 ? argv[2] : nullptr;
+
+  dbg::Debugger debugger;
+  dbg::Debugger *d = &debugger;
+
+  dbg::init(d);
+  defer { dbg::deinit(d); };
+
+  results.init();
+  defer { results.deinit(); };
+
+  // Startup. The first session writes the debug index, if there is none yet, later ones map it.
+  For_Count (5, i) {
+    measure(d, "debug", 1, [&] { dbg::debug(d, executable_path, nullptr); });
+    if (d->state != dbg::Debugger_State::LOADED) {
+      printf("Error: couldn't start debugging %s\n", executable_path);
+      return 1;
+    }
+    measure(d, "wait_for_indexing", 1, [&] { dbg::wait_for_indexing(d); });
+
+    if (i == 4)  break; // Last session is kept for the rest of the benchmark
+
+    auto pid = d->debugee_pid;
+    dbg::unload(d);
+    d->debugee_pid = pid;
+    kill_debugee(d);
+  }
+
+  // Breakpoints, before the program is started
+  char declaration[64];
+  u32 function_number = 0;
+  measure(d, "set+remove breakpoint name", 200, [&] {
+    // Base 4 digits of the generated function names
+    u32 n = (function_number++ * 2654435761u) % 4096;
+    snprintf(declaration, sizeof(declaration), "generated_function_%d%d%d%d%d%d(int)",
+             (n >> 10) & 3, (n >> 8) & 3, (n >> 6) & 3, (n >> 4) & 3, (n >> 2) & 3, n & 3);
+    auto breakpoint = dbg::set_breakpoint(d, declaration);
+    if (breakpoint)  dbg::remove_breakpoint(d, breakpoint);
+  });
+
+  Array<dbg::Symbol> symbols;
+  symbols.init();
+  defer { dbg::deinit(symbols); };
+
+  measure(d, "lookup_symbol", 200, [&] { dbg::lookup_symbol(d, "generated_function_123123", &symbols); });
+  measure(d, "lookup_symbol miss", 200, [&] { dbg::lookup_symbol(d, "no_such_function", &symbols); });
+
+  u64 hot_loop_step_address = 0;
+  dbg::lookup_symbol(d, "hot_loop_step", &symbols);
+  if (symbols.count > 0)  hot_loop_step_address = symbols[0].address;
+
+  measure(d, "set+remove breakpoint addr", 200, [&] {
+    auto breakpoint = dbg::set_breakpoint(d, hot_loop_step_address);
+    if (breakpoint)  dbg::remove_breakpoint(d, breakpoint);
+  });
+
+  auto hot_loop_breakpoint = dbg::set_breakpoint(d, "hot_loop(int)");
+  dbg::set_breakpoint(d, "recursion_bottom(int)");
+  dbg::set_breakpoint(d, "large_structs_ready(Scene *)");
+
+  // Hot loop
+  measure(d, "start", 1, [&] { dbg::start(d); });
+  if (d->state != dbg::Debugger_State::RUNNING) {
+    printf("Error: program isn't running after the start\n");
+    return 1;
+  }
+  dbg::remove_breakpoint(d, hot_loop_breakpoint);
+
+  measure(d, "step_over", 500, [&] { dbg::step_over(d); });
+  measure(d, "step_in", 500, [&] { dbg::step_in(d); });
+
+  u64 stack_pointer = dbg::read_register(d, dbg::Register::rsp);
+  u8 memory_block[4096];
+  measure(d, "read_memory 8", 1000, [&] { dbg::read_memory(d, stack_pointer); });
+  measure(d, "read_memory 4096", 1000, [&] { dbg::read_memory(d, stack_pointer - sizeof(memory_block), memory_block, sizeof(memory_block)); });
+  measure(d, "read_cached_memory 4096", 1000, [&] {
+    dbg::read_cached_memory(d, stack_pointer - sizeof(memory_block), memory_block, sizeof(memory_block));
+  });
+
+  // Deep recursion
+  measure(d, "continue_execution", 1, [&] { dbg::continue_execution(d); });
+
+  Array<dbg::Frame> frames;
+  frames.init();
+  defer { dbg::deinit(frames); };
+
+  measure(d, "get_stack_trace depth 200", 100, [&] { dbg::get_stack_trace(d, &frames); });
+  measure(d, "get_stack_trace stop arena", 100, [&] { dbg::get_stack_trace(d, &frames, dbg::get_stop_allocator(d)); });
+  frames.deinit();
+
+  // Large structs
+  dbg::continue_execution(d);
+
+  Array<dbg::Variable> variables;
+  variables.init();
+  defer { dbg::deinit(variables); };
+
+  measure(d, "get_variables", 100, [&] { dbg::get_variables(d, 1, &variables); });
+
+  Array<dbg::Variable> children;
+  children.init();
+  defer { dbg::deinit(children); };
+
+  auto scene = find_variable(&variables, "scene");
+  if (scene) {
+    auto child_count = dbg::get_child_count(scene);
+    measure(d, "get_variable_children", 100, [&] { dbg::get_variable_children(d, scene, 0, child_count, &children); });
+  }
+
+  kill_debugee(d);
+
+  printf("\n");
+  print_results();
+  if (csv_path)  export_results_csv(csv_path);
+
+  return 0;
+}
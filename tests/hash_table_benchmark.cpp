@@ -0,0 +1,225 @@
+#include <time.h>
+
+#include "../common.h"
+#include "../defer.h"
+#include "../Hash_Table.h"
+#include "../Hash_Table.cpp"
+#include "../String_Pool.h"
+#include "../String_Pool.cpp"
+
+#include "baseline_hash_table.h"
+
+// Compares Hash_Table with the bucket-chained table it replaced, on the access patterns of the debugger:
+// address keys (breakpoints, types, CIEs), file path keys (sources, coverage)
+// and a small table churned by inserts and removes (temporary breakpoints of step_over).
+// Interned path keys (String_Pool) are compared with the baseline path keys.
+
+static u64 get_time_ns() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+static u64 next_random(u64 *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static u64 sink = 0; // Keeps lookups from being optimized out
+
+struct Benchmark_Keys {
+  s32 count;
+  u64 *addresses;
+  char **paths;
+  Interned_String *interned_paths;
+  String_Pool pool;
+};
+
+static Benchmark_Keys make_keys(s32 count) {
+  Benchmark_Keys keys;
+  keys.count = count;
+  keys.addresses = static_cast <u64 *>(malloc(sizeof(u64) * count));
+  keys.paths = static_cast <char **>(malloc(sizeof(char *) * count));
+  keys.interned_paths = static_cast <Interned_String *>(malloc(sizeof(Interned_String) * count));
+  keys.pool.init();
+
+  // Addresses of code look like this: same high bytes, aligned low bytes. Multiplier is odd, so the keys are unique.
+  For_Count (count, i) {
+    keys.addresses[i] = 0x555555554000 + (((u64)i * 2654435761u) & 0xffffff) * 16;
+
+    char path[128];
+    snprintf(path, sizeof(path), "/home/user/project/src/module_%d/file_%d.cpp", i % 97, i);
+    keys.paths[i] = strdup(path);
+    keys.interned_paths[i] = {keys.pool.intern(path)};
+  }
+
+  return keys;
+}
+
+static void free_keys(Benchmark_Keys *keys) {
+  For_Count (keys->count, i)  free(keys->paths[i]);
+  free(keys->paths);
+  free(keys->interned_paths);
+  free(keys->addresses);
+  keys->pool.deinit();
+}
+
+template <typename Table, typename K>
+static void prepare(Table *table) {
+  table->init();
+}
+
+template <>
+void prepare<baseline::Hash_Table<u64, s32>, u64>(baseline::Hash_Table<u64, s32> *table) {
+  table->verbose = false;
+  table->init();
+}
+
+template <>
+void prepare<baseline::Hash_Table<char *, s32>, char *>(baseline::Hash_Table<char *, s32> *table) {
+  table->verbose = false;
+  table->init();
+}
+
+// Returns nanoseconds per operation for insert, search hit, search miss and remove
+template <typename Table, typename K>
+static void run_table(K *keys, K *missing_keys, s32 count, s32 rounds, float64 results[4]) {
+  u64 times[4] = {};
+
+  For_Count (rounds, round) {
+    Table table;
+    prepare<Table, K>(&table);
+
+    auto start = get_time_ns();
+    For_Count (count, i)  table.insert(keys[i], i);
+    times[0] += get_time_ns() - start;
+
+    start = get_time_ns();
+    For_Count (count, i)  sink += *table.search(keys[i]);
+    times[1] += get_time_ns() - start;
+
+    start = get_time_ns();
+    For_Count (count, i)  sink += table.search(missing_keys[i]) != nullptr;
+    times[2] += get_time_ns() - start;
+
+    start = get_time_ns();
+    For_Count (count, i)  table.remove(keys[i]);
+    times[3] += get_time_ns() - start;
+
+    table.deinit();
+  }
+
+  For_Count (4, i)  results[i] = (float64)times[i] / ((u64)count * rounds);
+}
+
+// Few keys inserted and removed over and over, as step_over does with its temporary breakpoints
+template <typename Table, typename K>
+static float64 run_churn(K *keys, s32 count, s32 live_count, s32 rounds) {
+  Table table;
+  prepare<Table, K>(&table);
+
+  auto start = get_time_ns();
+  For_Count (rounds, round) {
+    For_Count (live_count, i)  table.insert(keys[(round + i) % count], i);
+    For_Count (live_count, i)  sink += table.exists(keys[(round + i) % count]);
+    For_Count (live_count, i)  table.remove(keys[(round + i) % count]);
+  }
+  auto time = get_time_ns() - start;
+
+  table.deinit();
+  return (float64)time / ((u64)rounds * live_count);
+}
+
+template <typename Baseline_Table, typename Table, typename Baseline_K, typename K>
+static void compare(const char *name, Baseline_K *baseline_keys, Baseline_K *baseline_missing_keys, K *keys, K *missing_keys, s32 count, s32 rounds) {
+  float64 baseline_results[4];
+  float64 results[4];
+  run_table<Baseline_Table, Baseline_K>(baseline_keys, baseline_missing_keys, count, rounds, baseline_results);
+  run_table<Table, K>(keys, missing_keys, count, rounds, results);
+
+  const char *operations[] = {"insert", "search", "search miss", "remove"};
+  For_Count (4, i) {
+    printf("%-8s %7d  %-12s %10.1f %10.1f %7.2fx\n", name, count, operations[i],
+           baseline_results[i], results[i], baseline_results[i] / results[i]);
+  }
+}
+
+// Checks the table against a plain array of present flags, with removals interleaved
+static bool check_table() {
+  const s32 key_count = 20000;
+  bool present[key_count] = {};
+
+  Hash_Table<u64, s32> table;
+  table.init();
+  defer { table.deinit(); };
+
+  u64 random_state = 42;
+  s32 expected_count = 0;
+  For_Count (400000, step) {
+    s32 i = next_random(&random_state) % key_count;
+    u64 key = (u64)i << 32; // Keys differ only in high bytes
+
+    if (step % 3 == 0) {
+      if (present[i])  expected_count--;
+      present[i] = false;
+      table.remove(key);
+    } else {
+      if (!present[i])  expected_count++;
+      present[i] = true;
+      table.insert(key, i);
+    }
+
+    if (table.count != expected_count)  return false;
+  }
+
+  For_Count (key_count, i) {
+    auto value = table.search((u64)i << 32);
+    if (present[i] != (value != nullptr))  return false;
+    if (value && *value != i)  return false;
+  }
+
+  // String keys are compared whole, not by prefix
+  Hash_Table<char *, s32> strings;
+  defer { strings.deinit(); };
+
+  strings.insert((char *)"/src/a.cpp", 1);
+  strings.insert((char *)"/src/a.cpp.orig", 2);
+  if (strings.count != 2 || *strings[(char *)"/src/a.cpp"] != 1 || strings.exists((char *)"/src/a"))  return false;
+
+  return true;
+}
+
+s32 main(s32 argc, char *argv[]) {
+  if (!check_table()) {
+    printf("Hash_Table check FAILED\n");
+    return 1;
+  }
+  printf("Hash_Table check passed\n\n");
+
+  s32 sizes[] = {64, 1024, 16384};
+  s32 max_count = 2 * 16384;
+
+  auto keys = make_keys(max_count);
+  defer { free_keys(&keys); };
+
+  printf("keys     count    operation    baseline ns    new ns   speedup\n");
+  for (auto count : sizes) {
+    s32 rounds = 2000000 / count;
+
+    // Second half of the keys is never inserted
+    compare<baseline::Hash_Table<u64, s32>, Hash_Table<u64, s32>>("address", keys.addresses, keys.addresses + count,
+                                                                   keys.addresses, keys.addresses + count, count, rounds);
+    compare<baseline::Hash_Table<char *, s32>, Hash_Table<char *, s32>>("path", keys.paths, keys.paths + count,
+                                                                         keys.paths, keys.paths + count, count, rounds / 4 + 1);
+    compare<baseline::Hash_Table<char *, s32>, Hash_Table<Interned_String, s32>>("interned", keys.paths, keys.paths + count,
+                                                                                  keys.interned_paths, keys.interned_paths + count, count, rounds / 4 + 1);
+  }
+
+  auto baseline_churn = run_churn<baseline::Hash_Table<u64, s32>, u64>(keys.addresses, max_count, 8, 200000);
+  auto churn = run_churn<Hash_Table<u64, s32>, u64>(keys.addresses, max_count, 8, 200000);
+  printf("address        8  churn        %10.1f %10.1f %7.2fx\n", baseline_churn, churn, baseline_churn / churn);
+
+  return sink == 0xffffffff; // Never true in practice
+}
@@ -14,12 +14,17 @@ s32 main(s32 argc, char *argv[]) {
   dbg::init(d);
   defer { dbg::deinit(d); };
 
+  auto load_start_time = dbg::get_monotonic_time_ns();
+
   if (argc > 1) {
     dbg::debug(d, argv[1], nullptr);
   } else {
     dbg::debug(d, "debugee", nullptr);
   }
 
+  printf("Startup took %.2f ms (%s)\n", (dbg::get_monotonic_time_ns() - load_start_time) / 1000000.0,
+         d->debug_index ? "debug index" : "no debug index");
+
   // if (argc < 2)  return 1;
   // attach(d, atoi(argv[1]));
 
@@ -34,6 +39,11 @@ s32 main(s32 argc, char *argv[]) {
 
   dbg::print_breakpoints(d);
 
+  // Breakpoints of units, which weren't indexed yet, are set when indexing is done
+  dbg::wait_for_indexing(d);
+  dbg::print_load_timings(d);
+  dbg::print_breakpoints(d);
+
   printf("\nSource file list:\n");
   auto source_list = dbg::get_updated_sources(d);
   dbg::print_sources(source_list);
@@ -89,6 +99,15 @@ s32 main(s32 argc, char *argv[]) {
 
   print_variables(locals1);
 
+  Array<dbg::Watch> watches;
+  defer { dbg::deinit(watches); };
+
+  For (locals1) {
+    dbg::add_watch(&watches, it.name);
+  }
+  dbg::evaluate_watches(d, &watches);
+  dbg::print_watches(watches);
+
   dbg::step_in(d);
   dbg::print_current_source_location(d);
 
@@ -98,6 +117,13 @@ s32 main(s32 argc, char *argv[]) {
 
   dbg::print_stack_trace(stack_trace2);
 
+  // Taken from the stop arena, valid until the program is resumed
+  Array<dbg::Variable> caller_locals;
+  dbg::get_variables(d, 1, &caller_locals, dbg::get_stop_allocator(d));
+
+  print_variables(caller_locals);
+  dbg::print_allocation_stats(d);
+
   dbg::step_out(d);
   dbg::print_current_source_location(d);
 
@@ -109,6 +135,9 @@ s32 main(s32 argc, char *argv[]) {
   dbg::continue_execution(d);
   dbg::print_current_source_location(d);
 
+  auto modules = dbg::get_modules(d);
+  if (modules)  dbg::print_modules(modules);
+
   Array<dbg::Symbol> matched_names;
   dbg::lookup_symbol(d, "main", &matched_names);
   defer { dbg::deinit(matched_names); };
@@ -0,0 +1,423 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Latency histogram
+//
+
+inline u32 get_latency_bucket_index(u64 value) {
+  // Values below two sub-bucket ranges are recorded exactly
+  if (value < 2 * latency_sub_bucket_count)  return value;
+
+  u32 magnitude = 63 - __builtin_clzll(value);
+  u32 shift = magnitude - latency_sub_bucket_bits;
+  return shift * latency_sub_bucket_count + (value >> shift);
+}
+
+// Highest value which falls into the bucket
+inline u64 get_latency_bucket_limit(u32 index) {
+  if (index < 2 * latency_sub_bucket_count)  return index;
+
+  u32 shift = index / latency_sub_bucket_count - 1;
+  u64 sub_bucket = index % latency_sub_bucket_count + latency_sub_bucket_count;
+  return (sub_bucket << shift) + (((u64)1 << shift) - 1);
+}
+
+void record_latency(Latency_Histogram *histogram, u64 value) {
+  if (!histogram->counts) {
+    histogram->counts = static_cast <u64 *>(calloc(latency_bucket_count, sizeof(u64)));
+  }
+
+  histogram->counts[get_latency_bucket_index(value)]++;
+
+  if (histogram->total_count == 0 || value < histogram->min)  histogram->min = value;
+  if (value > histogram->max)  histogram->max = value;
+
+  histogram->total_count++;
+  histogram->sum += value;
+}
+
+u64 get_latency_percentile(Latency_Histogram *histogram, float64 percentile) {
+  if (histogram->total_count == 0)  return 0;
+
+  u64 target_count = (u64)(percentile / 100.0 * histogram->total_count + 0.5);
+  if (target_count < 1)  target_count = 1;
+  if (target_count > histogram->total_count)  target_count = histogram->total_count;
+
+  u64 count = 0;
+  For_Count (latency_bucket_count, i) {
+    count += histogram->counts[i];
+    if (count >= target_count) {
+      auto value = get_latency_bucket_limit(i);
+      if (value < histogram->min)  return histogram->min;
+      if (value > histogram->max)  return histogram->max;
+      return value;
+    }
+  }
+
+  return histogram->max;
+}
+
+void deinit(Latency_Histogram *histogram) {
+  if (histogram->counts)  free(histogram->counts);
+  *histogram = Latency_Histogram();
+}
+
+
+/////////////////////////////////////
+//
+//  Function tracing
+//
+// Entry breakpoints are planted at traced functions' addresses from the symbol
+// table. On each entry the return address is resolved the same way as for
+// step out, and a return breakpoint is planted there for the time of the call.
+// Return is matched to its call by the stack pointer, which after return equals
+// CFA of the callee, so recursive calls are measured correctly.
+//
+// @Note: Every traced call costs four stops of the process (two breakpoint hits and
+//        two single steps over them), so traced functions should be relatively long.
+//
+
+struct Trace_Point {
+  Breakpoint breakpoint;   // Owned by the tracer, isn't registered in dbg->breakpoints
+  s32 function_index;      // Traced function entered at this address, -1 for return-only points
+  u32 pending_returns;     // Calls waiting to return to this address
+};
+
+struct Pending_Call {
+  u32 function_index;
+  u64 return_address;
+  u64 cfa;
+  u64 entry_time;
+};
+
+struct Tracer {
+  Trace *trace;
+
+  Hash_Table<u64, Trace_Point *> point_map;
+  Array<Trace_Point *> points;
+
+  Array<Pending_Call> call_stack;
+
+  bool stop_requested = false;
+  bool stop_suppressed = false;
+};
+
+constexpr u64 trace_poll_interval_ns = 20000;
+
+Trace_Point *add_trace_point(Tracer *tracer, u64 address, s32 function_index) {
+  auto point = static_cast <Trace_Point *>(calloc(1, sizeof(Trace_Point)));
+  point->breakpoint.address = address;
+  point->function_index = function_index;
+
+  tracer->points.add(point);
+  tracer->point_map.insert(address, point);
+
+  return point;
+}
+
+void acquire_return_point(Debugger *dbg, Tracer *tracer, u64 return_address) {
+  auto existing_point = tracer->point_map[return_address];
+  auto point = existing_point ? *existing_point : add_trace_point(tracer, return_address, -1);
+
+  point->pending_returns++;
+  if (!point->breakpoint.enabled)  enable_breakpoint(dbg, &point->breakpoint);
+}
+
+void release_return_point(Debugger *dbg, Tracer *tracer, u64 return_address) {
+  auto existing_point = tracer->point_map[return_address];
+  if (!existing_point)  return;
+
+  auto point = *existing_point;
+  if (point->pending_returns > 0)  point->pending_returns--;
+
+  // Return-only points are kept disabled for reuse, as the same call sites tend to repeat
+  if (point->pending_returns == 0 && point->function_index == -1 && point->breakpoint.enabled) {
+    disable_breakpoint(dbg, &point->breakpoint);
+  }
+}
+
+void handle_trace_return(Debugger *dbg, Tracer *tracer, u64 address, u64 time) {
+  auto stack_pointer = read_register(dbg, Register::rsp);
+
+  // Calls above the matched one on the stack never returned normally (longjmp, exceptions)
+  for (s32 i = tracer->call_stack.count - 1; i >= 0; i--) {
+    auto call = tracer->call_stack[i];
+    if (call.return_address != address || call.cfa != stack_pointer)  continue;
+
+    auto function = &tracer->trace->functions[call.function_index];
+    record_latency(&function->latency, time - call.entry_time);
+
+    while (tracer->call_stack.count > i) {
+      auto unfinished_call = tracer->call_stack.pop();
+      release_return_point(dbg, tracer, unfinished_call.return_address);
+
+      if (tracer->call_stack.count > i)  tracer->trace->unfinished_calls++;
+    }
+    return;
+  }
+}
+
+void handle_trace_entry(Debugger *dbg, Tracer *tracer, Trace_Point *point, u64 time) {
+  u64 cfa;
+  auto return_address = get_return_address(dbg, &cfa);
+  if (return_address == 0)  return;
+
+  acquire_return_point(dbg, tracer, return_address);
+  tracer->call_stack.add((Pending_Call){(u32)point->function_index, return_address, cfa, time});
+}
+
+// Returns false if the process exited
+bool step_over_trace_point(Debugger *dbg, Tracer *tracer, Trace_Point *point) {
+  disable_breakpoint(dbg, &point->breakpoint);
+
+  debugee_ptrace(dbg, PTRACE_SINGLESTEP, nullptr, nullptr);
+
+  while (true) {
+    s32 wait_status;
+    if (debugee_waitpid(dbg, &wait_status, 0) == -1)  return false;
+    if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status))  return false;
+
+    auto signal = WSTOPSIG(wait_status);
+    if (signal == SIGTRAP)  break;
+
+    // Stopping request shouldn't be lost, it's sent again after the step
+    if (signal == SIGSTOP && tracer->stop_requested)  tracer->stop_suppressed = true;
+
+    debugee_ptrace(dbg, PTRACE_SINGLESTEP, nullptr, signal == SIGSTOP ? 0 : signal);
+  }
+
+  enable_breakpoint(dbg, &point->breakpoint);
+
+  if (tracer->stop_suppressed) {
+    kill(dbg->debugee_pid, SIGSTOP);
+    tracer->stop_suppressed = false;
+  }
+
+  return true;
+}
+
+// Returns false if the process exited
+bool handle_trace_trap(Debugger *dbg, Tracer *tracer, u64 time) {
+  auto address = read_register(dbg, Register::rip) - 1;
+
+  auto existing_point = tracer->point_map[address];
+  if (!existing_point || !(*existing_point)->breakpoint.enabled)  return true; // Not our trap
+
+  write_register(dbg, Register::rip, address);
+
+  auto point = *existing_point;
+
+  // Same address could be a return address of one call and an entry of another function,
+  // when call of noreturn function is the last instruction before the next function
+  if (point->pending_returns > 0)  handle_trace_return(dbg, tracer, address, time);
+  if (point->function_index != -1)  handle_trace_entry(dbg, tracer, point, time);
+
+  if (point->breakpoint.enabled)  return step_over_trace_point(dbg, tracer, point);
+  return true;
+}
+
+s32 compare_traced_functions(const void *a, const void *b) {
+  auto first  = static_cast <const Traced_Function *>(a);
+  auto second = static_cast <const Traced_Function *>(b);
+  if (first->latency.sum > second->latency.sum)  return -1;
+  if (first->latency.sum < second->latency.sum)  return 1;
+  return strcmp(first->name, second->name);
+}
+
+void trace_functions(Debugger *dbg, const char *pattern, float64 duration, Trace *result) {
+  if (!result) {
+    dbg_fail("pointer to output trace is null");
+    return;
+  }
+
+  deinit(result);
+  result->functions.init();
+
+  if (dbg->state != Debugger_State::RUNNING) {
+    dbg_fail("debugged program isn't running");
+    return;
+  }
+
+  if (!pattern || duration <= 0) {
+    dbg_fail("tracing pattern and positive duration should be specified");
+    return;
+  }
+
+  Tracer tracer;
+  tracer.trace = result;
+  tracer.points.init();
+  tracer.call_stack.init();
+  defer {
+    For (tracer.points)  free(it);
+    tracer.points.deinit();
+    tracer.point_map.deinit();
+    tracer.call_stack.deinit();
+  };
+
+  Array<Symbol> symbols;
+  symbols.init();
+  defer { deinit(symbols); };
+
+  lookup_symbol(dbg, "", &symbols);
+
+  tracer.point_map.init(symbols.count);
+
+  For (symbols) {
+    if (it.type != Symbol_Type::FUNCTION || it.address == 0)  continue;
+    if (fnmatch(pattern, it.name, 0) != 0)  continue;
+
+    // Symbol could be present both in .symtab and .dynsym
+    auto address = offset_dwarf_address(dbg, it.address);
+    if (tracer.point_map.exists(address))  continue;
+
+    Traced_Function function;
+    function.name = strdup(it.name);
+    function.address = address;
+    result->functions.add(function);
+
+    add_trace_point(&tracer, address, result->functions.count - 1);
+  }
+
+  if (result->functions.count <= 0) {
+    dbg_fail("no functions match the tracing pattern");
+    return;
+  }
+
+  // User breakpoints lifted for the tracing time, so the process stops only on trace points
+  Small_Array<Breakpoint *, 16> lifted_breakpoints;
+  lifted_breakpoints.init();
+  defer { lifted_breakpoints.deinit(); };
+
+  lift_breakpoints(dbg, &lifted_breakpoints);
+
+  For (tracer.points)  enable_breakpoint(dbg, &it->breakpoint);
+
+  u64 start_time = get_monotonic_time_ns();
+  u64 end_time = start_time + (u64)(duration * 1000000000.0);
+
+  bool process_exited = false;
+
+  end_stop(dbg);
+  debugee_ptrace(dbg, PTRACE_CONT, nullptr, nullptr);
+
+  while (true) {
+    s32 wait_status;
+    auto wait_result = debugee_waitpid(dbg, &wait_status, tracer.stop_requested ? 0 : WNOHANG);
+
+    if (wait_result == 0) {
+      if (get_monotonic_time_ns() >= end_time) {
+        // Stopping with a signal instead of interrupt_process, as trace traps could arrive first
+        kill(dbg->debugee_pid, SIGSTOP);
+        tracer.stop_requested = true;
+      } else {
+        // @Speed: Polling adds up to the interval to the time of every stop
+        timespec poll_interval = { 0, trace_poll_interval_ns };
+        nanosleep(&poll_interval, nullptr);
+      }
+      continue;
+    }
+
+    if (wait_result == -1 || WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+      process_exited = true;
+      break;
+    }
+
+    if (!WIFSTOPPED(wait_status))  continue;
+
+    auto signal = WSTOPSIG(wait_status);
+    if (signal == SIGSTOP && tracer.stop_requested)  break;
+
+    if (signal == SIGTRAP) {
+      if (!handle_trace_trap(dbg, &tracer, get_monotonic_time_ns())) {
+        process_exited = true;
+        break;
+      }
+      signal = 0;
+    }
+
+    debugee_ptrace(dbg, PTRACE_CONT, nullptr, signal == SIGSTOP ? 0 : signal);
+  }
+
+  result->duration = (get_monotonic_time_ns() - start_time) / 1000000000.0;
+  result->unfinished_calls += tracer.call_stack.count;
+
+  if (process_exited) {
+    printf("Process exited during tracing\n");
+
+    if (dbg->autorestart_enabled) {
+      restart_or_finish_debug(dbg);
+    } else {
+      dbg->state = Debugger_State::LOADED;
+    }
+  } else {
+    For (tracer.points) {
+      if (it->breakpoint.enabled)  disable_breakpoint(dbg, &it->breakpoint);
+    }
+  }
+
+  restore_lifted_breakpoints(dbg, &lifted_breakpoints);
+  start_new_stop(dbg);
+
+  qsort(result->functions.data, result->functions.count, sizeof(Traced_Function), compare_traced_functions);
+
+  dbg_success();
+}
+
+void deinit(Trace *trace) {
+  For_Pointer (trace->functions) {
+    if (it->name)  free(it->name);
+    deinit(&it->latency);
+  }
+  trace->functions.deinit();
+
+  trace->duration = 0;
+  trace->unfinished_calls = 0;
+}
+
+void print_trace(Trace *trace) {
+  printf("Trace: %d functions in %.3f s, %lu unfinished calls\n", trace->functions.count, trace->duration, trace->unfinished_calls);
+  printf("%10s %12s %12s %12s %12s %12s  %s\n", "calls", "mean, us", "p50, us", "p90, us", "p99, us", "max, us", "function");
+
+  For_Pointer (trace->functions) {
+    auto latency = &it->latency;
+    if (latency->total_count == 0)  continue;
+
+    printf("%10lu %12.1f %12.1f %12.1f %12.1f %12.1f  %s\n", latency->total_count,
+           latency->sum / 1000.0 / latency->total_count,
+           get_latency_percentile(latency, 50) / 1000.0,
+           get_latency_percentile(latency, 90) / 1000.0,
+           get_latency_percentile(latency, 99) / 1000.0,
+           latency->max / 1000.0, it->name);
+  }
+}
+
+void export_trace_csv(Trace *trace, const char *file_path) {
+  auto f = fopen(file_path, "w");
+  if (!f) {
+    printf("Error: couldn't open file %s for writing\n", file_path);
+    return;
+  }
+  defer { fclose(f); };
+
+  fprintf(f, "function,address,calls,total_ns,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+
+  For_Pointer (trace->functions) {
+    auto latency = &it->latency;
+
+    // Demangled names contain commas, so they're quoted
+    fputc('"', f);
+    for (auto c = it->name; *c; c++) {
+      if (*c == '"')  fputc('"', f);
+      fputc(*c, f);
+    }
+    fputc('"', f);
+
+    fprintf(f, ",0x%lx,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", it->address, latency->total_count, latency->sum,
+            latency->total_count ? latency->sum / latency->total_count : 0, latency->min,
+            get_latency_percentile(latency, 50), get_latency_percentile(latency, 90),
+            get_latency_percentile(latency, 99), get_latency_percentile(latency, 99.9), latency->max);
+  }
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,334 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Type model
+//
+// Types are parsed from DWARF on the first use and cached by offset of their DIE,
+// so every variable of the same type shares one Type. Types and their members are
+// allocated by the session arena, names are interned.
+//
+
+// Name of a pointer, array or qualified type, which waits for its target to be named
+struct Pending_Type_Name {
+  Type *type;
+  Type *target;
+  const char *prefix; // Interned or literal
+  const char *suffix;
+};
+
+struct Type_Table {
+  Hash_Table<u64, Type *> type_map;
+  Array<Pending_Type_Name> pending_names;
+  Arena *arena;
+};
+
+Type_Table * get_type_table(Debugger *dbg) {
+  if (!dbg->type_table) {
+    dbg->type_table = static_cast <Type_Table *>(dbg->session_arena.allocate(sizeof(Type_Table)));
+    *dbg->type_table = Type_Table();
+    dbg->type_table->type_map.init();
+    dbg->type_table->pending_names.init();
+    dbg->type_table->arena = &dbg->session_arena;
+  }
+
+  return dbg->type_table;
+}
+
+// Memory of the types is released with the session arena
+void free_type_table(Debugger *dbg) {
+  auto table = dbg->type_table;
+  if (!table)  return;
+
+  table->type_map.deinit();
+  table->pending_names.deinit();
+  dbg->type_table = nullptr;
+}
+
+Type * add_type(Type_Table *table, Type_Kind kind) {
+  auto type = static_cast <Type *>(table->arena->allocate(sizeof(Type)));
+  *type = Type();
+  type->kind = kind;
+  type->members.allocator = get_allocator(table->arena);
+  type->enumerators.allocator = get_allocator(table->arena);
+
+  return type;
+}
+
+inline char * get_die_name(Debugger *dbg, const dwarf::die &die, const char *default_name) {
+  if (die.has(dwarf::DW_AT::name))  return dbg->strings.intern(die[dwarf::DW_AT::name].as_cstr());
+  return dbg->strings.intern(default_name);
+}
+
+inline u64 get_die_byte_size(const dwarf::die &die) {
+  if (die.has(dwarf::DW_AT::byte_size))  return die[dwarf::DW_AT::byte_size].as_uconstant();
+  return 0;
+}
+
+char * concat_type_name(Debugger *dbg, const char *prefix, Type *type, const char *suffix) {
+  auto name = type ? type->name : (char *)"void";
+  auto length = strlen(prefix) + strlen(name) + strlen(suffix) + 1;
+
+  char buffer[256];
+  auto result = length <= sizeof(buffer) ? buffer : static_cast <char *>(malloc(length));
+  defer { if (result != buffer)  free(result); };
+
+  snprintf(result, length, "%s%s%s", prefix, name, suffix);
+  return dbg->strings.intern(result, length - 1);
+}
+
+// Target without a name is a type still being parsed, reached again through its own members
+// (struct Node { Node *children[2]; } reached through Node *), so the name is made once it's named
+void set_derived_type_name(Debugger *dbg, Type *type, const char *prefix, Type *target, const char *suffix) {
+  if (target && !target->name) {
+    get_type_table(dbg)->pending_names.add((Pending_Type_Name){type, target, prefix, suffix});
+    return;
+  }
+
+  type->name = concat_type_name(dbg, prefix, target, suffix);
+}
+
+// Names types waiting for the just named one, and then the ones waiting for them
+void resolve_pending_type_names(Debugger *dbg, Type *named_type) {
+  auto pending_names = &get_type_table(dbg)->pending_names;
+
+  s32 i = 0;
+  while (i < pending_names->count) {
+    if ((*pending_names)[i].target != named_type) {
+      i++;
+      continue;
+    }
+
+    auto pending = pending_names->remove_unordered(i);
+    pending.type->name = concat_type_name(dbg, pending.prefix, pending.target, pending.suffix);
+    resolve_pending_type_names(dbg, pending.type);
+    i = 0; // Entries could be removed by the recursion
+  }
+}
+
+Base_Type_Encoding to_base_type_encoding(u64 encoding) {
+  switch ((dwarf::DW_ATE)encoding) {
+  case dwarf::DW_ATE::boolean:       return Base_Type_Encoding::BOOLEAN;
+  case dwarf::DW_ATE::float_:        return Base_Type_Encoding::FLOAT;
+  case dwarf::DW_ATE::signed_char:   return Base_Type_Encoding::SIGNED_CHAR;
+  case dwarf::DW_ATE::unsigned_char: return Base_Type_Encoding::UNSIGNED_CHAR;
+  case dwarf::DW_ATE::address:
+  case dwarf::DW_ATE::unsigned_:
+  case dwarf::DW_ATE::UTF:           return Base_Type_Encoding::UNSIGNED;
+  default:                           return Base_Type_Encoding::SIGNED;
+  }
+}
+
+Type * get_type(Debugger *dbg, const dwarf::die &type_die);
+
+inline Type * get_target_type(Debugger *dbg, const dwarf::die &die) {
+  if (!die.has(dwarf::DW_AT::type))  return nullptr;
+  return get_type(dbg, dwarf::at_type(die));
+}
+
+void parse_struct_members(Debugger *dbg, const dwarf::die &die, Type *type) {
+  for (const auto &child : die) {
+    if (child.tag != dwarf::DW_TAG::member && child.tag != dwarf::DW_TAG::inheritance)  continue;
+
+    Type_Member member;
+    member.type = get_target_type(dbg, child);
+    member.offset = 0;
+
+    // @Note: Location as an expression is produced only by old DWARF versions, not supported
+    if (child.has(dwarf::DW_AT::data_member_location)) {
+      auto location = child[dwarf::DW_AT::data_member_location];
+      auto location_type = location.get_type();
+      if (location_type == dwarf::value::type::constant || location_type == dwarf::value::type::uconstant) {
+        member.offset = location.as_uconstant();
+      }
+    }
+
+    // DWARF 4 bit offset is counted from the start of the struct, the older one from the most significant
+    // bit of the storage unit at data_member_location
+    if (child.has(dwarf::DW_AT::bit_size)) {
+      member.bit_size = child[dwarf::DW_AT::bit_size].as_uconstant();
+
+      u64 bit_offset = 0;
+      if (child.has(dwarf::DW_AT::data_bit_offset)) {
+        bit_offset = child[dwarf::DW_AT::data_bit_offset].as_uconstant();
+        member.offset = 0;
+      } else if (child.has(dwarf::DW_AT::bit_offset)) {
+        u64 storage_size = child.has(dwarf::DW_AT::byte_size) ? get_die_byte_size(child) : (member.type ? member.type->size : 0);
+        bit_offset = storage_size * 8 - child[dwarf::DW_AT::bit_offset].as_uconstant() - member.bit_size;
+      }
+
+      member.offset += bit_offset / 8;
+      member.bit_offset = bit_offset % 8;
+    }
+
+    if (child.tag == dwarf::DW_TAG::inheritance) {
+      member.name = dbg->strings.intern(member.type ? member.type->name : "<base>");
+    } else {
+      member.name = get_die_name(dbg, child, "<anonymous>");
+    }
+
+    type->members.add(member);
+  }
+}
+
+void parse_array_dimensions(Debugger *dbg, const dwarf::die &die, Type *type) {
+  Array<u64> dimensions;
+  dimensions.init();
+  defer { dimensions.deinit(); };
+
+  for (const auto &child : die) {
+    if (child.tag != dwarf::DW_TAG::subrange_type)  continue;
+
+    u64 count = 0;
+    if (child.has(dwarf::DW_AT::count)) {
+      count = child[dwarf::DW_AT::count].as_uconstant();
+    } else if (child.has(dwarf::DW_AT::upper_bound)) {
+      u64 lower_bound = child.has(dwarf::DW_AT::lower_bound) ? child[dwarf::DW_AT::lower_bound].as_uconstant() : 0;
+      count = child[dwarf::DW_AT::upper_bound].as_uconstant() - lower_bound + 1;
+    }
+
+    dimensions.add(count); // Zero for flexible array members
+  }
+
+  if (dimensions.count <= 0)  dimensions.add(0);
+
+  auto table = get_type_table(dbg);
+
+  // Building from the innermost dimension, the outermost one is the cached type
+  auto element = get_target_type(dbg, die);
+  for (s32 i = dimensions.count - 1; i >= 0; i--) {
+    auto array = (i == 0) ? type : add_type(table, Type_Kind::ARRAY);
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "[%lu]", dimensions[i]);
+
+    array->target = element;
+    array->element_count = dimensions[i];
+    array->size = element ? element->size * dimensions[i] : 0;
+    set_derived_type_name(dbg, array, "", element, dbg->strings.intern(suffix));
+
+    element = array;
+  }
+}
+
+void parse_enumerators(Debugger *dbg, const dwarf::die &die, Type *type) {
+  for (const auto &child : die) {
+    if (child.tag != dwarf::DW_TAG::enumerator)  continue;
+
+    Enumerator enumerator;
+    enumerator.name = get_die_name(dbg, child, "?");
+
+    auto value = child[dwarf::DW_AT::const_value];
+    if (value.get_type() == dwarf::value::type::sconstant) {
+      enumerator.value = value.as_sconstant();
+    } else {
+      enumerator.value = (s64)value.as_uconstant();
+    }
+
+    type->enumerators.add(enumerator);
+  }
+}
+
+Type * get_type(Debugger *dbg, const dwarf::die &type_die) {
+  if (!type_die.valid())  return nullptr;
+
+  auto table = get_type_table(dbg);
+
+  auto offset = type_die.get_section_offset();
+  auto cached_type = table->type_map[offset];
+  count_cache_access(dbg, Stats_Cache::TYPES, cached_type != nullptr);
+  if (cached_type)  return *cached_type;
+
+  auto type = add_type(table, Type_Kind::UNKNOWN);
+
+  // Cached before parsing of the children, as types could reference themselves
+  table->type_map.insert(offset, type);
+
+  switch (type_die.tag) {
+  case dwarf::DW_TAG::base_type:
+    type->kind = Type_Kind::BASE;
+    type->name = get_die_name(dbg, type_die, "?");
+    type->size = get_die_byte_size(type_die);
+    if (type_die.has(dwarf::DW_AT::encoding)) {
+      type->encoding = to_base_type_encoding(type_die[dwarf::DW_AT::encoding].as_uconstant());
+    }
+    break;
+
+  case dwarf::DW_TAG::pointer_type:
+  case dwarf::DW_TAG::reference_type:
+  case dwarf::DW_TAG::rvalue_reference_type:
+    type->kind = Type_Kind::POINTER;
+    type->size = get_die_byte_size(type_die);
+    if (type->size == 0)  type->size = sizeof(u64);
+    type->target = get_target_type(dbg, type_die);
+    set_derived_type_name(dbg, type, "", type->target, type_die.tag == dwarf::DW_TAG::pointer_type ? " *" : " &");
+    break;
+
+  case dwarf::DW_TAG::structure_type:
+  case dwarf::DW_TAG::class_type:
+  case dwarf::DW_TAG::union_type:
+    type->kind = (type_die.tag == dwarf::DW_TAG::union_type) ? Type_Kind::UNION : Type_Kind::STRUCT;
+    type->name = get_die_name(dbg, type_die, "<anonymous>");
+    type->size = get_die_byte_size(type_die);
+    type->members.init();
+    parse_struct_members(dbg, type_die, type);
+    break;
+
+  case dwarf::DW_TAG::array_type:
+    type->kind = Type_Kind::ARRAY;
+    parse_array_dimensions(dbg, type_die, type);
+    break;
+
+  case dwarf::DW_TAG::enumeration_type:
+    type->kind = Type_Kind::ENUM;
+    type->name = get_die_name(dbg, type_die, "<anonymous>");
+    type->size = get_die_byte_size(type_die);
+    type->target = get_target_type(dbg, type_die);
+    if (type->target)  type->encoding = resolve_typedefs(type->target)->encoding;
+    type->enumerators.init();
+    parse_enumerators(dbg, type_die, type);
+    break;
+
+  case dwarf::DW_TAG::typedef_:
+    type->kind = Type_Kind::TYPEDEF;
+    type->name = get_die_name(dbg, type_die, "?");
+    type->target = get_target_type(dbg, type_die);
+    type->size = type->target ? type->target->size : 0;
+    break;
+
+  case dwarf::DW_TAG::const_type:
+  case dwarf::DW_TAG::volatile_type:
+  case dwarf::DW_TAG::restrict_type: {
+    auto prefix = "const ";
+    if (type_die.tag == dwarf::DW_TAG::volatile_type)  prefix = "volatile ";
+    if (type_die.tag == dwarf::DW_TAG::restrict_type)  prefix = "restrict ";
+
+    type->kind = Type_Kind::TYPEDEF;
+    type->target = get_target_type(dbg, type_die);
+    set_derived_type_name(dbg, type, prefix, type->target, "");
+    type->size = type->target ? type->target->size : 0;
+    break;
+  }
+
+  case dwarf::DW_TAG::subroutine_type:
+    type->kind = Type_Kind::FUNCTION;
+    type->name = dbg->strings.intern("function");
+    break;
+
+  default:
+    type->name = get_die_name(dbg, type_die, "?");
+    type->size = get_die_byte_size(type_die);
+    break;
+  }
+
+  if (type->name)  resolve_pending_type_names(dbg, type);
+
+  return type;
+}
+
+Type * resolve_typedefs(Type *type) {
+  while (type && type->kind == Type_Kind::TYPEDEF)  type = type->target;
+  return type;
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,489 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Call frame information
+//
+// Stack unwinding by CFI from .eh_frame section. Frame pointer chain is used
+// only as a fallback for code without frame description entries.
+//
+
+enum Pointer_Encoding : u8 {
+  PE_ABSPTR  = 0x00,
+  PE_ULEB128 = 0x01,
+  PE_UDATA2  = 0x02,
+  PE_UDATA4  = 0x03,
+  PE_UDATA8  = 0x04,
+  PE_SLEB128 = 0x09,
+  PE_SDATA2  = 0x0a,
+  PE_SDATA4  = 0x0b,
+  PE_SDATA8  = 0x0c,
+
+  PE_PCREL   = 0x10,
+  PE_DATAREL = 0x30,
+
+  PE_OMIT    = 0xff,
+};
+
+struct Frame_Common_Info {
+  u64 offset; // Offset in the section, referenced by FDEs
+
+  u64 code_alignment;
+  s64 data_alignment;
+  u64 return_address_register;
+
+  u8 pointer_encoding = PE_ABSPTR;
+  bool has_augmentation_data = false;
+
+  const u8 *instructions;
+  const u8 *instructions_end;
+};
+
+struct Frame_Description {
+  u64 low_pc;
+  u64 high_pc;
+
+  s32 cie_index;
+
+  const u8 *instructions;
+  const u8 *instructions_end;
+};
+
+struct Unwind_Table {
+  Array<Frame_Common_Info> cies;
+  Array<Frame_Description> fdes; // Sorted by low_pc
+};
+
+u64 read_encoded_pointer(Data_Cursor *cursor, u8 encoding, u64 section_address) {
+  if (encoding == PE_OMIT)  return 0;
+
+  u64 field_address = section_address + cursor->offset();
+
+  u64 value = 0;
+  switch (encoding & 0x0f) {
+  case PE_ABSPTR:  value = cursor->read_u64();     break;
+  case PE_ULEB128: value = cursor->read_uleb128(); break;
+  case PE_UDATA2:  value = cursor->read_u16();     break;
+  case PE_UDATA4:  value = cursor->read_u32();     break;
+  case PE_UDATA8:  value = cursor->read_u64();     break;
+  case PE_SLEB128: value = cursor->read_sleb128(); break;
+  case PE_SDATA2:  value = cursor->read_s16();     break;
+  case PE_SDATA4:  value = cursor->read_s32();     break;
+  case PE_SDATA8:  value = cursor->read_s64();     break;
+  default:
+    cursor->pointer = cursor->end; // Unknown format, can't continue parsing
+    return 0;
+  }
+
+  if ((encoding & 0x70) == PE_PCREL)  value += field_address;
+
+  return value;
+}
+
+s32 compare_frame_descriptions(const void *a, const void *b) {
+  auto first  = static_cast <const Frame_Description *>(a);
+  auto second = static_cast <const Frame_Description *>(b);
+  if (first->low_pc < second->low_pc)  return -1;
+  if (first->low_pc > second->low_pc)  return 1;
+  return 0;
+}
+
+Unwind_Table * build_unwind_table(Debugger *dbg, const elf::elf &elf) {
+  auto &section = elf.get_section(".eh_frame");
+  if (!section.valid()) {
+    if (dbg->verbose)  printf("Warning: no .eh_frame section, falling back to frame pointer unwinding\n");
+    return nullptr;
+  }
+
+  auto table = static_cast <Unwind_Table *>(calloc(1, sizeof(Unwind_Table)));
+  table->cies.init();
+  table->fdes.init();
+
+  auto section_address = section.get_hdr().addr;
+
+  Hash_Table<u64, s32> cie_index_by_offset;
+  cie_index_by_offset.init();
+  defer { cie_index_by_offset.deinit(); };
+
+  Data_Cursor cursor;
+  cursor.init(section.data(), section.size());
+
+  while (!cursor.at_end()) {
+    u64 entry_offset = cursor.offset();
+
+    u64 length = cursor.read_u32();
+    if (length == 0)  break; // Terminator
+    bool is_64bit = (length == 0xffffffff);
+    if (is_64bit)  length = cursor.read_u64();
+
+    u64 id_offset = cursor.offset();
+    u64 entry_end = id_offset + length;
+    u64 id = is_64bit ? cursor.read_u64() : cursor.read_u32();
+
+    if (id == 0) {
+      // Common information entry
+      Frame_Common_Info cie = {};
+      cie.offset = entry_offset;
+
+      u8 version = cursor.read_u8();
+      auto augmentation = cursor.read_cstring();
+
+      if (strstr(augmentation, "eh"))  cursor.skip(8);
+
+      cie.code_alignment = cursor.read_uleb128();
+      cie.data_alignment = cursor.read_sleb128();
+      cie.return_address_register = (version == 1) ? cursor.read_u8() : cursor.read_uleb128();
+      cie.pointer_encoding = PE_ABSPTR;
+
+      if (augmentation[0] == 'z') {
+        cie.has_augmentation_data = true;
+        u64 augmentation_length = cursor.read_uleb128();
+        u64 augmentation_end = cursor.offset() + augmentation_length;
+
+        for (auto c = augmentation + 1; *c; c++) {
+          switch (*c) {
+          case 'R': cie.pointer_encoding = cursor.read_u8(); break;
+          case 'L': cursor.read_u8(); break;
+          case 'P': {
+            u8 personality_encoding = cursor.read_u8();
+            read_encoded_pointer(&cursor, personality_encoding, section_address);
+            break;
+          }
+          default: break; // 'S' and 'B' have no data
+          }
+        }
+
+        cursor.seek(augmentation_end);
+      }
+
+      cie.instructions = cursor.pointer;
+      cursor.seek(entry_end);
+      cie.instructions_end = cursor.pointer;
+
+      cie_index_by_offset.insert(cie.offset, table->cies.count);
+      table->cies.add(cie);
+    } else {
+      // Frame description entry. CIE pointer is relative to the id field itself
+      auto cie_index = cie_index_by_offset[id_offset - id];
+      if (!cie_index) {
+        cursor.seek(entry_end);
+        continue;
+      }
+
+      auto &cie = table->cies[*cie_index];
+
+      Frame_Description fde = {};
+      fde.cie_index = *cie_index;
+      fde.low_pc = read_encoded_pointer(&cursor, cie.pointer_encoding, section_address);
+      fde.high_pc = fde.low_pc + read_encoded_pointer(&cursor, cie.pointer_encoding & 0x0f, section_address);
+
+      if (cie.has_augmentation_data) {
+        u64 augmentation_length = cursor.read_uleb128();
+        cursor.skip(augmentation_length);
+      }
+
+      fde.instructions = cursor.pointer;
+      cursor.seek(entry_end);
+      fde.instructions_end = cursor.pointer;
+
+      if (fde.low_pc != fde.high_pc)  table->fdes.add(fde);
+    }
+  }
+
+  qsort(table->fdes.data, table->fdes.count, sizeof(Frame_Description), compare_frame_descriptions);
+
+  return table;
+}
+
+Unwind_Table * get_unwind_table(Debugger *dbg) {
+  if (!dbg->unwind_table) {
+    dbg->unwind_table = dbg->debug_index ? load_unwind_table_from_index(dbg) : build_unwind_table(dbg, dbg->elf);
+  }
+  return dbg->unwind_table;
+}
+
+void free_unwind_table(Debugger *dbg) {
+  if (dbg->unwind_table) {
+    dbg->unwind_table->cies.deinit();
+    dbg->unwind_table->fdes.deinit();
+    free(dbg->unwind_table);
+    dbg->unwind_table = nullptr;
+  }
+}
+
+Frame_Description * find_frame_description(Unwind_Table *table, u64 pc) {
+  s32 low = 0;
+  s32 high = table->fdes.count - 1;
+
+  while (low <= high) {
+    s32 middle = low + (high - low) / 2;
+    auto fde = &table->fdes.data[middle];
+
+    if (pc < fde->low_pc)        high = middle - 1;
+    else if (pc >= fde->high_pc) low = middle + 1;
+    else                         return fde;
+  }
+
+  return nullptr;
+}
+
+/////////////////////////////////////
+//
+//  CFA program execution
+//
+
+enum class Register_Rule_Type : u8 {
+  UNDEFINED,
+  SAME_VALUE,
+  OFFSET,     // Saved at CFA + value
+  VAL_OFFSET, // Value is CFA + value
+  REGISTER,   // Saved in other register
+};
+
+struct Register_Rule {
+  Register_Rule_Type type;
+  s64 value;
+};
+
+struct Frame_Row {
+  u64 cfa_register;
+  s64 cfa_offset;
+  bool cfa_is_expression;
+
+  Register_Rule rules[unwind_registers_count];
+};
+
+constexpr u32 max_remembered_rows = 8;
+
+bool execute_cfa_program(Frame_Common_Info *cie, const u8 *instructions, const u8 *instructions_end,
+                         u64 location, u64 target_pc, Frame_Row *row, Frame_Row *initial_row) {
+  Frame_Row remembered_rows[max_remembered_rows];
+  u32 remembered_count = 0;
+
+  Data_Cursor cursor;
+  cursor.init(instructions, instructions_end - instructions);
+
+  auto set_rule = [&](u64 reg, Register_Rule_Type type, s64 value) {
+    if (reg < unwind_registers_count)  row->rules[reg] = (Register_Rule){type, value};
+  };
+
+  while (!cursor.at_end() && location <= target_pc) {
+    u8 opcode = cursor.read_u8();
+    u8 operand = opcode & 0x3f;
+
+    switch (opcode & 0xc0) {
+    case 0x40: // DW_CFA_advance_loc
+      location += operand * cie->code_alignment;
+      continue;
+    case 0x80: // DW_CFA_offset
+      set_rule(operand, Register_Rule_Type::OFFSET, cursor.read_uleb128() * cie->data_alignment);
+      continue;
+    case 0xc0: // DW_CFA_restore
+      if (initial_row && operand < unwind_registers_count)  row->rules[operand] = initial_row->rules[operand];
+      continue;
+    }
+
+    switch (opcode) {
+    case 0x00: break; // DW_CFA_nop
+    case 0x01: location = read_encoded_pointer(&cursor, cie->pointer_encoding, 0); break; // DW_CFA_set_loc
+    case 0x02: location += cursor.read_u8()  * cie->code_alignment; break; // DW_CFA_advance_loc1
+    case 0x03: location += cursor.read_u16() * cie->code_alignment; break; // DW_CFA_advance_loc2
+    case 0x04: location += cursor.read_u32() * cie->code_alignment; break; // DW_CFA_advance_loc4
+
+    case 0x05: { // DW_CFA_offset_extended
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::OFFSET, cursor.read_uleb128() * cie->data_alignment);
+      break;
+    }
+    case 0x06: { // DW_CFA_restore_extended
+      auto reg = cursor.read_uleb128();
+      if (initial_row && reg < unwind_registers_count)  row->rules[reg] = initial_row->rules[reg];
+      break;
+    }
+    case 0x07: set_rule(cursor.read_uleb128(), Register_Rule_Type::UNDEFINED, 0);  break; // DW_CFA_undefined
+    case 0x08: set_rule(cursor.read_uleb128(), Register_Rule_Type::SAME_VALUE, 0); break; // DW_CFA_same_value
+    case 0x09: { // DW_CFA_register
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::REGISTER, cursor.read_uleb128());
+      break;
+    }
+    case 0x0a: // DW_CFA_remember_state
+      if (remembered_count < max_remembered_rows)  remembered_rows[remembered_count++] = *row;
+      break;
+    case 0x0b: // DW_CFA_restore_state
+      if (remembered_count > 0)  *row = remembered_rows[--remembered_count];
+      break;
+    case 0x0c: // DW_CFA_def_cfa
+      row->cfa_register = cursor.read_uleb128();
+      row->cfa_offset = cursor.read_uleb128();
+      row->cfa_is_expression = false;
+      break;
+    case 0x0d: // DW_CFA_def_cfa_register
+      row->cfa_register = cursor.read_uleb128();
+      row->cfa_is_expression = false;
+      break;
+    case 0x0e: // DW_CFA_def_cfa_offset
+      row->cfa_offset = cursor.read_uleb128();
+      break;
+    case 0x0f: // DW_CFA_def_cfa_expression
+      cursor.skip(cursor.read_uleb128());
+      row->cfa_is_expression = true;
+      break;
+    case 0x10: { // DW_CFA_expression
+      auto reg = cursor.read_uleb128();
+      cursor.skip(cursor.read_uleb128());
+      set_rule(reg, Register_Rule_Type::UNDEFINED, 0); // @Incomplete: register expressions aren't evaluated
+      break;
+    }
+    case 0x11: { // DW_CFA_offset_extended_sf
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::OFFSET, cursor.read_sleb128() * cie->data_alignment);
+      break;
+    }
+    case 0x12: // DW_CFA_def_cfa_sf
+      row->cfa_register = cursor.read_uleb128();
+      row->cfa_offset = cursor.read_sleb128() * cie->data_alignment;
+      row->cfa_is_expression = false;
+      break;
+    case 0x13: // DW_CFA_def_cfa_offset_sf
+      row->cfa_offset = cursor.read_sleb128() * cie->data_alignment;
+      break;
+    case 0x14: { // DW_CFA_val_offset
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::VAL_OFFSET, cursor.read_uleb128() * cie->data_alignment);
+      break;
+    }
+    case 0x15: { // DW_CFA_val_offset_sf
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::VAL_OFFSET, cursor.read_sleb128() * cie->data_alignment);
+      break;
+    }
+    case 0x16: { // DW_CFA_val_expression
+      auto reg = cursor.read_uleb128();
+      cursor.skip(cursor.read_uleb128());
+      set_rule(reg, Register_Rule_Type::UNDEFINED, 0);
+      break;
+    }
+    case 0x2e: cursor.read_uleb128(); break; // DW_CFA_GNU_args_size
+    case 0x2f: { // DW_CFA_GNU_negative_offset_extended
+      auto reg = cursor.read_uleb128();
+      set_rule(reg, Register_Rule_Type::OFFSET, -(s64)(cursor.read_uleb128() * cie->data_alignment));
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/////////////////////////////////////
+//
+//  Unwinding
+//
+
+bool unwind_with_frame_pointer(Debugger *dbg, Unwind_Registers *registers, u64 *cfa) {
+  auto frame_pointer = registers->values[unwind_frame_pointer_register];
+  if (frame_pointer == 0 || !(registers->valid_mask & (1 << unwind_frame_pointer_register)))  return false;
+
+  *cfa = frame_pointer + 16;
+  registers->values[unwind_return_address_register] = read_memory(dbg, frame_pointer + 8);
+  registers->values[unwind_frame_pointer_register] = read_memory(dbg, frame_pointer);
+  registers->values[unwind_stack_pointer_register] = *cfa;
+
+  return true;
+}
+
+bool unwind_frame(Debugger *dbg, Unwind_Registers *registers, bool is_caller_frame, u64 *cfa_output) {
+  u64 cfa = 0;
+  defer { if (cfa_output)  *cfa_output = cfa; };
+
+  auto pc = registers->values[unwind_return_address_register];
+
+  // Return address points past the call instruction, which could be out of the
+  // caller's FDE range when the call is the last instruction of the function.
+  auto lookup_pc = offset_load_address(dbg, pc) - (is_caller_frame ? 1 : 0);
+  auto table = get_unwind_table(dbg);
+
+  // Code of shared libraries is described by their own CFI
+  auto module = find_module(dbg, pc);
+  if (module && !module->is_main) {
+    lookup_pc = pc - module->load_bias - (is_caller_frame ? 1 : 0);
+    table = get_module_unwind_table(dbg, module);
+  }
+  auto fde = table ? find_frame_description(table, lookup_pc) : nullptr;
+  if (!fde)  return unwind_with_frame_pointer(dbg, registers, &cfa);
+
+  auto cie = &table->cies[fde->cie_index];
+
+  Frame_Row row = {};
+  For_Count (unwind_registers_count, i)  row.rules[i].type = Register_Rule_Type::SAME_VALUE;
+
+  if (!execute_cfa_program(cie, cie->instructions, cie->instructions_end, 0, (u64)-1, &row, nullptr))  return false;
+
+  Frame_Row initial_row = row;
+  if (!execute_cfa_program(cie, fde->instructions, fde->instructions_end, fde->low_pc, lookup_pc, &row, &initial_row))  return false;
+
+  if (row.cfa_is_expression || row.cfa_register >= unwind_registers_count)  return false;
+  if (!(registers->valid_mask & (1 << row.cfa_register)))  return false;
+
+  cfa = registers->values[row.cfa_register] + row.cfa_offset;
+
+  Unwind_Registers caller = *registers;
+  For_Count (unwind_registers_count, reg) {
+    auto rule = row.rules[reg];
+    switch (rule.type) {
+    case Register_Rule_Type::UNDEFINED:
+      caller.valid_mask &= ~(1 << reg);
+      break;
+    case Register_Rule_Type::SAME_VALUE:
+      break;
+    case Register_Rule_Type::OFFSET:
+      caller.values[reg] = read_memory(dbg, cfa + rule.value);
+      caller.valid_mask |= (1 << reg);
+      break;
+    case Register_Rule_Type::VAL_OFFSET:
+      caller.values[reg] = cfa + rule.value;
+      caller.valid_mask |= (1 << reg);
+      break;
+    case Register_Rule_Type::REGISTER:
+      if (rule.value < unwind_registers_count && (registers->valid_mask & (1 << rule.value))) {
+        caller.values[reg] = registers->values[rule.value];
+      } else {
+        caller.valid_mask &= ~(1 << reg);
+      }
+      break;
+    }
+  }
+
+  // By definition, stack pointer of the caller is the CFA
+  caller.values[unwind_stack_pointer_register] = cfa;
+  caller.valid_mask |= (1 << unwind_stack_pointer_register);
+
+  if (!(caller.valid_mask & (1 << unwind_return_address_register)))  return false;
+  if (caller.values[unwind_return_address_register] == 0)  return false;
+
+  *registers = caller;
+  return true;
+}
+
+void unwind_stack(Debugger *dbg, Array<u64> *addresses, u32 max_depth) {
+  Unwind_Registers registers;
+  get_unwind_registers(dbg, &registers);
+
+  addresses->add(registers.values[unwind_return_address_register]);
+
+  For_Range (1, max_depth, depth) {
+    auto stack_pointer = registers.values[unwind_stack_pointer_register];
+
+    if (!unwind_frame(dbg, &registers, depth > 1, nullptr))  break;
+
+    // Stack grows down, so caller frames should always be above
+    if (registers.values[unwind_stack_pointer_register] <= stack_pointer)  break;
+
+    addresses->add(registers.values[unwind_return_address_register]);
+  }
+}
+
+DBG_NAMESPACE_END
@@ -0,0 +1,345 @@
+DBG_NAMESPACE_BEGIN
+
+/////////////////////////////////////
+//
+//  Watches
+//
+// Expressions are parsed once into a variable name and a chain of accesses
+// (buf->len, table[3].key, *p), and evaluated on every stop. Only the bytes of
+// the final value and of the pointers on the way are read, through the page cache.
+//
+
+inline const char * skip_spaces(const char *c) {
+  while (*c == ' ' || *c == '\t')  c++;
+  return c;
+}
+
+inline bool is_identifier_char(char c, bool is_first) {
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')  return true;
+  return !is_first && c >= '0' && c <= '9';
+}
+
+const char * parse_identifier(const char *c, char **result) {
+  auto start = c;
+  while (is_identifier_char(*c, c == start))  c++;
+
+  if (c == start)  return nullptr;
+
+  *result = strndup(start, c - start);
+  return c;
+}
+
+bool parse_watch_expression(Watch *watch) {
+  auto c = skip_spaces(watch->expression);
+
+  u32 dereference_count = 0;
+  while (*c == '*') {
+    dereference_count++;
+    c = skip_spaces(c + 1);
+  }
+
+  c = parse_identifier(c, &watch->variable_name);
+  if (!c)  return false;
+
+  while (true) {
+    c = skip_spaces(c);
+    if (*c == '\0')  break;
+
+    Watch_Step step;
+
+    if (*c == '.' || (c[0] == '-' && c[1] == '>')) {
+      step.type = (*c == '.') ? Watch_Step_Type::MEMBER : Watch_Step_Type::POINTER_MEMBER;
+      c = skip_spaces(c + (*c == '.' ? 1 : 2));
+      c = parse_identifier(c, &step.member_name);
+      if (!c)  return false;
+    } else if (*c == '[') {
+      auto index_start = skip_spaces(c + 1);
+      char *index_end;
+      step.type = Watch_Step_Type::INDEX;
+      step.index = strtoll(index_start, &index_end, 0);
+      if (index_end == index_start)  return false;
+
+      c = skip_spaces(index_end);
+      if (*c != ']')  return false;
+      c++;
+    } else {
+      return false;
+    }
+
+    watch->steps.add(step);
+  }
+
+  // Prefix dereference binds weaker than postfix accesses
+  For_Count (dereference_count, i) {
+    Watch_Step step;
+    step.type = Watch_Step_Type::DEREFERENCE;
+    watch->steps.add(step);
+  }
+
+  return true;
+}
+
+void add_watch(Array<Watch> *watches, const char *expression) {
+  Watch watch;
+  watch.expression = strdup(expression);
+  watch.steps.init();
+
+  // Name is parsed before the rest of the expression, without it the watch is never evaluated
+  if (!parse_watch_expression(&watch)) {
+    watch.error = "couldn't parse expression";
+    if (watch.variable_name)  free(watch.variable_name);
+    watch.variable_name = nullptr;
+  }
+
+  watches->add(watch);
+}
+
+void free_watch(Watch *watch) {
+  if (watch->expression)  free(watch->expression);
+  if (watch->variable_name)  free(watch->variable_name);
+
+  For_Pointer (watch->steps) {
+    if (it->member_name)  free(it->member_name);
+  }
+  watch->steps.deinit();
+
+  if (watch->result.data)  free(watch->result.data);
+  if (watch->previous_data)  free(watch->previous_data);
+}
+
+void remove_watch(Array<Watch> *watches, s32 index) {
+  if (index < 0 || index >= watches->count)  return;
+
+  free_watch(&(*watches)[index]);
+
+  // Order is kept, as watches are shown in the order they were added
+  watches->remove(index);
+}
+
+void deinit(Array<Watch> watches) {
+  For_Pointer (watches)  free_watch(it);
+  watches.deinit();
+}
+
+Local_Variable_Info * find_variable(Function_Locals *locals, const char *name, u64 pc) {
+  if (!locals)  return nullptr;
+
+  // Variables of inner blocks follow the outer ones, so the last visible match shadows others
+  Local_Variable_Info *result = nullptr;
+  For_Pointer (locals->variables) {
+    if (strcmp(it->name, name) == 0 && is_variable_in_scope(locals, it, pc))  result = it;
+  }
+  return result;
+}
+
+const char * apply_watch_step(Debugger *dbg, Watch_Step *step, Variable *value) {
+  auto type = resolve_typedefs(value->type);
+  if (!type)  return "unknown type";
+
+  // Pointers are followed by their value, everything else has to be in memory
+  auto dereference = [&]() -> const char * {
+    if (type->kind != Type_Kind::POINTER)  return "not a pointer";
+
+    u64 pointer = value->value;
+    if (value->location == Variable_Location::MEMORY && !read_cached_memory(dbg, value->address, &pointer, sizeof(u64))) {
+      return "couldn't read pointer";
+    }
+
+    value->location = Variable_Location::MEMORY;
+    value->address = pointer;
+    value->type = type->target;
+    type = resolve_typedefs(value->type);
+    return nullptr;
+  };
+
+  switch (step->type) {
+  case Watch_Step_Type::DEREFERENCE:
+    return dereference();
+
+  case Watch_Step_Type::POINTER_MEMBER:
+  case Watch_Step_Type::MEMBER: {
+    if (step->type == Watch_Step_Type::POINTER_MEMBER) {
+      auto error = dereference();
+      if (error)  return error;
+      if (!type)  return "unknown type";
+    }
+
+    if (type->kind != Type_Kind::STRUCT && type->kind != Type_Kind::UNION)  return "not a struct";
+    if (value->location != Variable_Location::MEMORY)  return "struct isn't in memory";
+
+    For_Pointer (type->members) {
+      if (strcmp(it->name, step->member_name) == 0) {
+        value->address += it->offset;
+        value->type = it->type;
+        value->bit_offset = it->bit_offset;
+        value->bit_size = it->bit_size;
+        return nullptr;
+      }
+    }
+    return "no such member";
+  }
+
+  case Watch_Step_Type::INDEX: {
+    if (type->kind == Type_Kind::POINTER) {
+      auto error = dereference();
+      if (error)  return error;
+    } else if (type->kind == Type_Kind::ARRAY) {
+      if (value->location != Variable_Location::MEMORY)  return "array isn't in memory";
+      value->type = type->target;
+    } else {
+      return "not an array or pointer";
+    }
+
+    auto element_type = value->type;
+    value->address += step->index * (element_type ? element_type->size : 0);
+    return nullptr;
+  }
+  }
+
+  return nullptr;
+}
+
+void evaluate_watch(Debugger *dbg, Expression_Context *context, Function_Locals *locals, u64 pc, Watch *watch) {
+  watch->is_valid = false;
+
+  auto info = find_variable(locals, watch->variable_name, pc);
+  if (!info)  info = find_variable(get_global_variables(dbg), watch->variable_name, pc);
+  if (!info) {
+    watch->error = "no such variable";
+    return;
+  }
+
+  auto &result = watch->result;
+  result.name = watch->expression;
+  result.type = info->type;
+  result.size = info->type ? info->type->size : sizeof(u64);
+
+  set_variable_location(dbg, context, get_variable_location(context, info, pc), &result);
+  if (result.location == Variable_Location::OPTIMIZED_OUT) {
+    watch->error = "optimized out";
+    return;
+  }
+
+  if (watch->steps.count > 0) {
+    if (result.data)  free(result.data);
+    result.data = nullptr;
+    result.data_size = 0;
+
+    For_Pointer (watch->steps) {
+      auto error = apply_watch_step(dbg, it, &result);
+      if (error) {
+        watch->error = error;
+        return;
+      }
+    }
+
+    result.size = result.type ? result.type->size : 0;
+    if (result.bit_size)  result.size = get_bitfield_data_size(result.bit_offset, result.bit_size);
+  }
+
+  if (result.location == Variable_Location::MEMORY) {
+    result.data_size = result.size < max_variable_read_size ? result.size : max_variable_read_size;
+    result.data = static_cast <u8 *>(calloc(result.data_size ? result.data_size : 1, 1));
+
+    if (!read_cached_memory(dbg, result.address, result.data, result.data_size)) {
+      watch->error = "couldn't read memory";
+      return;
+    }
+
+    set_variable_value(&result);
+  }
+
+  watch->error = nullptr;
+  watch->is_valid = true;
+}
+
+void evaluate_watches(Debugger *dbg, Array<Watch> *watches) {
+  time_command(Stats_Command::EVALUATE_WATCHES);
+
+  if (!watches) {
+    dbg_fail("pointer to watches is null");
+    return;
+  }
+
+  bool is_running = (dbg->state == Debugger_State::RUNNING);
+
+  // Scope is resolved once for all the watches
+  Unwind_Registers registers;
+  Function_Locals *locals = nullptr;
+  u64 pc = 0;
+
+  if (is_running) {
+    get_unwind_registers(dbg, &registers);
+    pc = offset_load_address(dbg, registers.values[unwind_return_address_register]);
+
+    auto func = get_function_from_pc(dbg, pc);
+    if (dbg->last_command_status == Command_Status::SUCCESS)  locals = get_function_locals(dbg, func);
+  }
+
+  Expression_Context context = {};
+  context.dbg = dbg;
+  context.registers = &registers;
+  context.is_caller_frame = false;
+  if (locals)  context.frame_base_expression = locals->frame_base;
+
+  For_Pointer (*watches) {
+    auto &result = it->result;
+
+    // Values of the previous stop are kept for diffing, reevaluation during the same stop keeps them
+    bool is_new_stop = (it->evaluated_stop != dbg->stop_count);
+    if (is_new_stop) {
+      if (it->previous_data)  free(it->previous_data);
+      it->previous_data = result.data;
+      it->previous_data_size = result.data_size;
+      it->was_valid = it->is_valid;
+      it->has_previous = (it->evaluated_stop != 0);
+    } else if (result.data) {
+      free(result.data);
+    }
+
+    it->evaluated_stop = dbg->stop_count;
+
+    result = Variable();
+    result.location = Variable_Location::OPTIMIZED_OUT;
+
+    if (!it->variable_name)  continue; // Not parsed
+
+    if (!is_running) {
+      it->is_valid = false;
+      it->error = "program isn't running";
+      continue;
+    }
+
+    evaluate_watch(dbg, &context, locals, pc, it);
+
+    it->has_changed = it->has_previous && it->is_valid != it->was_valid;
+    if (!it->has_previous || !it->is_valid || !it->was_valid)  continue;
+
+    it->has_changed = (result.data_size != it->previous_data_size || memcmp(result.data, it->previous_data, result.data_size) != 0);
+
+    // Bytes of a bitfield are shared with its neighbours, only its own bits are compared
+    if (result.bit_size && result.data_size == it->previous_data_size) {
+      auto previous = result;
+      previous.data = it->previous_data;
+      set_variable_value(&previous);
+      it->has_changed = (previous.value != result.value);
+    }
+  }
+
+  dbg_success();
+}
+
+void print_watches(Array<Watch> watches) {
+  For_Pointer (watches) {
+    if (!it->is_valid) {
+      printf("%s = <%s>\n", it->expression, it->error ? it->error : "not evaluated");
+      continue;
+    }
+
+    char value[128];
+    format_variable_value(&it->result, value, sizeof(value));
+    printf("%s = %s%s\n", it->expression, value, it->has_changed ? "\t(changed)" : "");
+  }
+}
+
+DBG_NAMESPACE_END